@@ -9,6 +9,9 @@ void Adren::Editor::start(ImGuiContext* ctx, Camera& camera, Renderer& renderer)
     //ImGui::ShowDemoWindow(&yep);
 
     if (showCameraInfo) cameraInfo(&showCameraInfo, camera);
+    if (showCullingInfo) cullingInfo(&showCullingInfo, renderer.culling);
+    if (showStreamingInfo) streamingInfo(&showStreamingInfo, renderer.streaming);
+    if (showLoadingInfo) loadingInfo(&showLoadingInfo, renderer.loader);
 
     leftPanel();
     rightPanel();
@@ -38,6 +41,9 @@ void Adren::Editor::start(ImGuiContext* ctx, Camera& camera, Renderer& renderer)
 
         if (ImGui::BeginMenu("Debug")) {
             ImGui::MenuItem("Camera Properties", " ", &showCameraInfo);
+            ImGui::MenuItem("Culling", " ", &showCullingInfo);
+            ImGui::MenuItem("Streaming", " ", &showStreamingInfo);
+            ImGui::MenuItem("Loading", " ", &showLoadingInfo);
             ImGui::EndMenu();
         }
 
@@ -82,6 +88,96 @@ void Adren::Editor::cameraInfo(bool* open, Camera& camera) {
     ImGui::End();
 }
 
+void Adren::Editor::cullingInfo(bool* open, Culling& culling) {
+    ImGui::Begin("Culling", open);
+    if (ImGui::BeginTabBar("CullingTabBar")) {
+        if (ImGui::BeginTabItem("Stats")) {
+            const CullStats& stats = culling.stats;
+            ImGui::Text("Clusters: %u \n", culling.clusterCount);
+            ImGui::Text("Visible: %u \n", stats.visible);
+            ImGui::Text("Frustum Culled: %u \n", stats.frustum);
+            ImGui::Text("Occlusion Culled: %u \n", stats.occlusion);
+            ImGui::Text("Backface Culled: %u \n", stats.cone);
+            ImGui::Text("Triangles: %u / %u \n", stats.triangles, culling.triangleCount);
+            ImGui::EndTabItem();
+        }
+
+        if (ImGui::BeginTabItem("LOD")) {
+            const Culling::LodStats& lodStats = culling.lodStats;
+            ImGui::Text("Triangles Saved: %u \n", lodStats.trianglesSaved);
+            ImGui::Text("Contribution Culled: %u (%u triangles) \n", lodStats.contributionCulled, lodStats.contributionTriangles);
+            for (size_t level = 0; level < lodStats.levels.size(); level++) {
+                ImGui::Text("Level %zu: %u \n", level, lodStats.levels[level]);
+            }
+
+            ImGui::Separator();
+            ImGui::Checkbox("LOD Selection", &culling.lodSelection);
+            ImGui::Checkbox("Contribution Culling", &culling.contributionCulling);
+            ImGui::SliderFloat("Error (pixels)", &culling.lodThreshold, 0.1f, 16.0f, "%.2f");
+            ImGui::SliderFloat("LOD Bias", &culling.lodBias, -4.0f, 4.0f, "%.2f");
+            ImGui::SliderFloat("Hysteresis", &culling.lodHysteresis, 0.0f, 0.9f, "%.2f");
+            ImGui::SliderFloat("Contribution (pixels)", &culling.contributionPixels, 0.0f, 16.0f, "%.2f");
+            ImGui::EndTabItem();
+        }
+
+        if (ImGui::BeginTabItem("Settings")) {
+            ImGui::Checkbox("Cluster Culling", &culling.enabled);
+            ImGui::Checkbox("Frustum", &culling.frustumCulling);
+            ImGui::Checkbox("Occlusion", &culling.occlusionCulling);
+            ImGui::Checkbox("Backface Cones", &culling.coneCulling);
+            ImGui::EndTabItem();
+        }
+
+        ImGui::EndTabBar();
+    }
+
+    ImGui::End();
+}
+
+void Adren::Editor::streamingInfo(bool* open, Streaming& streaming) {
+    ImGui::Begin("Streaming", open);
+    const Streaming::Stats& stats = streaming.stats;
+    ImGui::Text("Textures: %u \n", stats.textures);
+    ImGui::Text("Resident: %.1f / %.1f MB \n", stats.residentBytes / 1048576.0, streaming.budget / 1048576.0);
+    ImGui::Text("Wanted: %.1f MB \n", stats.wantedBytes / 1048576.0);
+    ImGui::Text("Pending: %u \n", stats.pending);
+    ImGui::Text("Streamed In: %u \n", stats.streamedIn);
+    ImGui::Text("Evicted: %u \n", stats.evicted);
+    ImGui::Text("Failed: %u \n", stats.failed);
+
+    ImGui::Separator();
+    int budget = static_cast<int>(streaming.budget >> 20);
+    ImGui::Checkbox("Streaming", &streaming.enabled);
+    if (ImGui::SliderInt("Budget (MB)", &budget, 16, 4096)) streaming.budget = static_cast<VkDeviceSize>(budget) << 20;
+    ImGui::SliderFloat("Mip Bias", &streaming.mipBias, -2.0f, 4.0f, "%.2f");
+    ImGui::End();
+}
+
+void Adren::Editor::loadingInfo(bool* open, Loader& loader) {
+    ImGui::Begin("Loading", open);
+    const Loader::Stats& stats = loader.stats;
+    ImGui::Text("Loaded: %u / %u \n", stats.finished, stats.queued);
+    ImGui::Text("Cooked: %u \n", stats.cooked);
+    ImGui::Text("Decoded: %u \n", stats.decoded);
+    ImGui::Text("Failed: %u \n", stats.failed);
+    ImGui::Text("Shared: %u (%.1f MB saved) \n", stats.shared, stats.savedBytes / 1048576.0);
+    ImGui::Text("First Texture: %.1f ms \n", stats.firstMs);
+    ImGui::Text("Last Texture: %.1f ms \n", stats.lastMs);
+    const uint32_t minUploads = 1, maxUploads = 32;
+    ImGui::SliderScalar("Uploads Per Frame", ImGuiDataType_U32, &loader.uploadsPerFrame, &minUploads, &maxUploads);
+
+    ImGui::Separator();
+    std::vector<Loader::Pending> pending = loader.pending();
+    if (pending.empty()) ImGui::Text("Nothing pending \n");
+
+    const char* states[] = { "Queued", "Preparing", "Uploading" };
+    for (const Loader::Pending& load : pending) {
+        ImGui::Text("%s: %s \n", states[static_cast<int>(load.state)], load.name.c_str());
+    }
+
+    ImGui::End();
+}
+
 void Adren::Editor::leftPanel() {
     ImGui::Begin("Left Panel");
     ImGui::Text("LEFT PANEL");
@@ -10,12 +10,18 @@ class Editor {
 public:
     void start(ImGuiContext* ctx, Camera& camera, Renderer& renderer);
     void cameraInfo(bool* open, Camera& camera);
+    void cullingInfo(bool* open, Culling& culling);
+    void streamingInfo(bool* open, Streaming& streaming);
+    void loadingInfo(bool* open, Loader& loader);
     void leftPanel();
     void rightPanel();
     void bottomPanel();
     void topPanel();
 private:
     bool showCameraInfo = false;
+    bool showCullingInfo = false;
+    bool showStreamingInfo = false;
+    bool showLoadingInfo = false;
 };
 }
 
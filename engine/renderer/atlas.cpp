@@ -0,0 +1,136 @@
+/*
+    atlas.cpp
+    Adrenaline Engine
+
+    Definitions for atlas packing.
+*/
+
+#include "atlas.h"
+#include "bcn.h"
+#include <algorithm>
+
+// ImGui builds its copy of the packer static, this file gets its own.
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include <imstb_rectpack.h>
+
+namespace {
+// Repeats every texel so a side that divides the grid fills a whole cell.
+bool fitGrid(Adren::Atlas::Tile& tile, uint32_t grid) {
+    uint32_t repeatX = 1, repeatY = 1;
+    if (tile.width % grid != 0) {
+        if (grid % tile.width != 0) return false;
+        repeatX = grid / tile.width;
+    }
+
+    if (tile.height % grid != 0) {
+        if (grid % tile.height != 0) return false;
+        repeatY = grid / tile.height;
+    }
+
+    if (repeatX == 1 && repeatY == 1) return true;
+
+    uint32_t width = tile.width * repeatX, height = tile.height * repeatY;
+    std::vector<uint8_t> rgba(static_cast<size_t>(width) * height * 4);
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            const uint8_t* source = &tile.rgba[(static_cast<size_t>(y / repeatY) * tile.width + x / repeatX) * 4];
+            std::copy(source, source + 4, &rgba[(static_cast<size_t>(y) * width + x) * 4]);
+        }
+    }
+
+    tile.rgba = std::move(rgba);
+    tile.width = width;
+    tile.height = height;
+    return true;
+}
+}
+
+std::vector<Adren::Atlas::Page> Adren::Atlas::pack(std::vector<Tile>& tiles, uint32_t pageSize, uint32_t levelCount, bool srgb) {
+    std::vector<Page> pages;
+    levelCount = std::max(levelCount, 1u);
+    uint32_t grid = 1u << (levelCount - 1);
+    if (pageSize < grid * 3) return pages;
+
+    int units = static_cast<int>(pageSize / grid);
+    std::vector<size_t> remaining;
+    for (size_t i = 0; i < tiles.size(); i++) {
+        tiles[i].page = -1;
+        if (tiles[i].width == 0 || tiles[i].height == 0 || tiles[i].rgba.size() != static_cast<size_t>(tiles[i].width) * tiles[i].height * 4) continue;
+        if (fitGrid(tiles[i], grid) && tiles[i].width / grid + 2 <= static_cast<uint32_t>(units) && tiles[i].height / grid + 2 <= static_cast<uint32_t>(units)) {
+            remaining.push_back(i);
+        }
+    }
+
+    while (!remaining.empty()) {
+        std::vector<stbrp_node> nodes(units);
+        std::vector<stbrp_rect> rects(remaining.size());
+        for (size_t i = 0; i < remaining.size(); i++) {
+            rects[i].id = static_cast<int>(remaining[i]);
+            rects[i].w = static_cast<stbrp_coord>(tiles[remaining[i]].width / grid + 2);
+            rects[i].h = static_cast<stbrp_coord>(tiles[remaining[i]].height / grid + 2);
+        }
+
+        stbrp_context context;
+        stbrp_init_target(&context, units, units, nodes.data(), units);
+        stbrp_pack_rects(&context, rects.data(), static_cast<int>(rects.size()));
+
+        Page page{};
+        page.size = pageSize;
+        VkDeviceSize offset = 0;
+        for (uint32_t level = 0; level < levelCount; level++) {
+            uint32_t size = pageSize >> level;
+            page.levels.push_back(offset);
+            offset += static_cast<VkDeviceSize>(size) * size * 4;
+        }
+
+        page.pixels.assign(offset, 0);
+        remaining.clear();
+        bool placed = false;
+
+        for (stbrp_rect& rect : rects) {
+            Tile& tile = tiles[rect.id];
+            if (!rect.was_packed) {
+                remaining.push_back(static_cast<size_t>(rect.id));
+                continue;
+            }
+
+            placed = true;
+            tile.page = static_cast<int32_t>(pages.size());
+
+            uint32_t originX = (rect.x + 1) * grid, originY = (rect.y + 1) * grid;
+            tile.transform = glm::vec4(originX, originY, tile.width, tile.height) / static_cast<float>(pageSize);
+
+            // Each level comes from the level above of the tile alone, then its edges are stretched over the gutter.
+            std::vector<uint8_t> level = tile.rgba;
+            uint32_t width = tile.width, height = tile.height;
+            for (uint32_t l = 0; l < levelCount; l++) {
+                if (l > 0) {
+                    level = Bcn::downsample(level, width, height, srgb);
+                    width = std::max(width / 2, 1u);
+                    height = std::max(height / 2, 1u);
+                }
+
+                int32_t gutter = static_cast<int32_t>(grid >> l);
+                int32_t x0 = static_cast<int32_t>(originX >> l), y0 = static_cast<int32_t>(originY >> l);
+                uint32_t size = pageSize >> l;
+                uint8_t* destination = page.pixels.data() + page.levels[l];
+
+                for (int32_t y = -gutter; y < static_cast<int32_t>(height) + gutter; y++) {
+                    int32_t sourceY = std::clamp(y, 0, static_cast<int32_t>(height) - 1);
+                    for (int32_t x = -gutter; x < static_cast<int32_t>(width) + gutter; x++) {
+                        int32_t sourceX = std::clamp(x, 0, static_cast<int32_t>(width) - 1);
+                        const uint8_t* texel = &level[(static_cast<size_t>(sourceY) * width + sourceX) * 4];
+                        std::copy(texel, texel + 4, destination + (static_cast<size_t>(y0 + y) * size + (x0 + x)) * 4);
+                    }
+                }
+            }
+        }
+
+        // Tiles that don't fit an empty page never will.
+        if (!placed) break;
+        pages.push_back(std::move(page));
+    }
+
+    return pages;
+}
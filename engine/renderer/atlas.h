@@ -0,0 +1,33 @@
+/*
+	atlas.h
+	Adrenaline Engine
+
+	This packs small RGBA8 images into square atlas pages with imstb_rectpack.
+	Every tile is surrounded by a gutter that is rebuilt on each mip level, so filtering never reads a neighbour.
+*/
+
+#pragma once
+#include "types.h"
+#include <vector>
+
+namespace Adren::Atlas {
+	struct Tile {
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<uint8_t> rgba;
+
+		// Filled in by pack. The transform maps texture coordinates of the tile into the page, xy is the offset and zw the scale.
+		int32_t page = -1; // -1 when the tile didn't fit.
+		glm::vec4 transform = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+	};
+
+	struct Page {
+		uint32_t size = 0;
+		std::vector<uint8_t> pixels;
+		std::vector<VkDeviceSize> levels; // Offset of every mip level in pixels, largest first.
+	};
+
+	// Tiles sit on a grid of 2^(levelCount - 1) texels with one cell of gutter on each side, so they stay on whole texels
+	// on every level. Tiles whose sides don't fit the grid are repeated up to a cell when they divide it and skipped otherwise.
+	std::vector<Page> pack(std::vector<Tile>& tiles, uint32_t pageSize, uint32_t levelCount, bool srgb);
+}
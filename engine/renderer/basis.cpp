@@ -0,0 +1,522 @@
+/*
+    basis.cpp
+    Adrenaline Engine
+
+    Definitions for the ETC1S transcoder.
+    The bitstream follows the BasisLZ global data and ETC1S slice layout of the KTX File Format Specification 2.0,
+    the decoding matches the Basis Universal reference transcoder.
+*/
+
+#include "basis.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+// Bits are read from the least significant bit of every byte on. Reads past the end return zeros and mark the reader.
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t size) : data(data), size(size) {}
+
+    uint32_t bits(uint32_t count) {
+        if (count == 0) return 0;
+
+        while (available < count) {
+            buffer |= static_cast<uint64_t>(position < size ? data[position] : 0) << available;
+            position++;
+            available += 8;
+        }
+
+        uint32_t value = static_cast<uint32_t>(buffer & ((uint64_t(1) << count) - 1));
+        buffer >>= count;
+        available -= count;
+        consumed += count;
+        return value;
+    }
+
+    // Chunks of chunkBits with a continuation bit above each of them, lowest chunk first.
+    uint32_t vlc(uint32_t chunkBits) {
+        uint32_t value = 0;
+        for (uint32_t shift = 0; shift < 32; shift += chunkBits) {
+            uint32_t chunk = bits(chunkBits + 1);
+            value |= (chunk & ((1u << chunkBits) - 1)) << shift;
+            if ((chunk & (1u << chunkBits)) == 0) break;
+        }
+        return value;
+    }
+
+    bool overrun() const { return consumed > static_cast<uint64_t>(size) * 8; }
+
+private:
+    const uint8_t* data;
+    size_t size;
+    size_t position = 0;
+    uint64_t buffer = 0;
+    uint32_t available = 0;
+    uint64_t consumed = 0;
+};
+
+// Canonical codes up to 16 bits, assigned in symbol order within each length. The first bit read is the most
+// significant bit of the code.
+struct Huffman {
+    uint16_t counts[17] = {};
+    std::vector<uint16_t> symbols;
+
+    bool build(const std::vector<uint8_t>& lengths) {
+        std::fill(std::begin(counts), std::end(counts), 0);
+        for (uint8_t length : lengths) {
+            if (length > 16) return false;
+            counts[length]++;
+        }
+
+        int32_t left = 1;
+        for (uint32_t length = 1; length <= 16; length++) {
+            left = (left << 1) - counts[length];
+            if (left < 0) return false;
+        }
+
+        uint16_t offsets[17] = {};
+        for (uint32_t length = 1; length < 16; length++) offsets[length + 1] = offsets[length] + counts[length];
+
+        symbols.assign(lengths.size() - counts[0], 0);
+        for (size_t symbol = 0; symbol < lengths.size(); symbol++) {
+            if (lengths[symbol] != 0) symbols[offsets[lengths[symbol]]++] = static_cast<uint16_t>(symbol);
+        }
+
+        return true;
+    }
+
+    // -1 for codes the table doesn't have.
+    int32_t decode(BitReader& reader) const {
+        int32_t code = 0, first = 0, index = 0;
+        for (uint32_t length = 1; length <= 16; length++) {
+            code |= static_cast<int32_t>(reader.bits(1));
+            int32_t count = counts[length];
+            if (code - first < count) return symbols[index + code - first];
+
+            index += count;
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+
+        return -1;
+    }
+};
+
+// The code lengths of a table are Huffman coded themselves, with codes 17 to 20 for runs of zeros and repeats.
+const uint32_t smallZeroRun = 17, bigZeroRun = 18, smallRepeat = 19, bigRepeat = 20;
+const uint8_t codeLengthOrder[21] = { smallZeroRun, bigZeroRun, smallRepeat, bigRepeat, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15, 16 };
+
+bool readHuffman(BitReader& reader, Huffman& table) {
+    uint32_t symbolCount = reader.bits(14);
+    if (symbolCount == 0) {
+        table = Huffman{};
+        return true;
+    }
+
+    uint32_t codeLengthCount = reader.bits(5);
+    if (codeLengthCount < 1 || codeLengthCount > 21) return false;
+
+    std::vector<uint8_t> codeLengthSizes(21, 0);
+    for (uint32_t i = 0; i < codeLengthCount; i++) codeLengthSizes[codeLengthOrder[i]] = static_cast<uint8_t>(reader.bits(3));
+
+    Huffman codeLengths;
+    if (!codeLengths.build(codeLengthSizes)) return false;
+
+    std::vector<uint8_t> lengths(symbolCount, 0);
+    uint32_t current = 0;
+    while (current < symbolCount) {
+        int32_t code = codeLengths.decode(reader);
+        if (code < 0 || reader.overrun()) return false;
+
+        if (code <= 16) {
+            lengths[current++] = static_cast<uint8_t>(code);
+        } else if (code == smallZeroRun) {
+            current += reader.bits(3) + 3;
+        } else if (code == bigZeroRun) {
+            current += reader.bits(7) + 11;
+        } else {
+            if (current == 0 || lengths[current - 1] == 0) return false;
+
+            uint32_t run = code == smallRepeat ? reader.bits(2) + 3 : reader.bits(7) + 7;
+            if (current + run > symbolCount) return false;
+            std::fill(lengths.begin() + current, lengths.begin() + current + run, lengths[current - 1]);
+            current += run;
+        }
+    }
+
+    return current == symbolCount && table.build(lengths);
+}
+
+struct Endpoint {
+    uint8_t color[3]; // 5 bits each.
+    uint8_t inten;    // Row of the ETC1 modifier table.
+};
+
+// 2 bits per pixel, one byte per row with the leftmost pixel in the lowest bits.
+struct Selector {
+    uint8_t rows[4];
+};
+
+const int32_t modifiers[8][4] = {
+    { -8, -2, 2, 8 }, { -17, -5, 5, 17 }, { -29, -9, 9, 29 }, { -42, -13, 13, 42 },
+    { -60, -18, 18, 60 }, { -80, -24, 24, 80 }, { -106, -33, 33, 106 }, { -183, -47, 47, 183 },
+};
+
+struct GlobalHeader {
+    uint16_t endpointCount;
+    uint16_t selectorCount;
+    uint32_t endpointsByteLength;
+    uint32_t selectorsByteLength;
+    uint32_t tablesByteLength;
+    uint32_t extendedByteLength;
+};
+
+struct ImageDesc {
+    uint32_t imageFlags;
+    uint32_t rgbSliceByteOffset;
+    uint32_t rgbSliceByteLength;
+    uint32_t alphaSliceByteOffset;
+    uint32_t alphaSliceByteLength;
+};
+
+const uint32_t isPFrame = 0x02;
+
+struct Codebook {
+    std::vector<Endpoint> endpoints;
+    std::vector<Selector> selectors;
+
+    Huffman endpointPred;
+    Huffman deltaEndpoint;
+    Huffman selector;
+    Huffman selectorHistoryRle;
+    uint32_t selectorHistorySize = 0;
+};
+
+bool readEndpoints(const uint8_t* data, size_t size, uint32_t count, Codebook& codebook) {
+    BitReader reader(data, size);
+
+    // Each channel is coded as a delta to the one before, with the table picked by how large that was.
+    Huffman colorDelta[3], intenDelta;
+    for (Huffman& table : colorDelta) {
+        if (!readHuffman(reader, table)) return false;
+    }
+    if (!readHuffman(reader, intenDelta)) return false;
+
+    bool grayscale = reader.bits(1) != 0;
+    uint8_t previous[3] = { 16, 16, 16 };
+    uint32_t previousInten = 0;
+
+    codebook.endpoints.resize(count);
+    for (Endpoint& endpoint : codebook.endpoints) {
+        int32_t inten = intenDelta.decode(reader);
+        if (inten < 0) return false;
+        endpoint.inten = static_cast<uint8_t>((inten + previousInten) & 7);
+        previousInten = endpoint.inten;
+
+        for (uint32_t c = 0; c < (grayscale ? 1u : 3u); c++) {
+            const Huffman& table = previous[c] <= 9 ? colorDelta[0] : previous[c] <= 21 ? colorDelta[1] : colorDelta[2];
+            int32_t delta = table.decode(reader);
+            if (delta < 0) return false;
+
+            previous[c] = static_cast<uint8_t>((previous[c] + delta) & 31);
+            endpoint.color[c] = previous[c];
+        }
+
+        if (grayscale) endpoint.color[1] = endpoint.color[2] = endpoint.color[0];
+    }
+
+    return !reader.overrun();
+}
+
+bool readSelectors(const uint8_t* data, size_t size, uint32_t count, Codebook& codebook, std::string& error) {
+    BitReader reader(data, size);
+
+    // Global and hybrid codebooks were dropped from the format before KTX2 adopted it.
+    if (reader.bits(1) != 0 || reader.bits(1) != 0) {
+        error = "ETC1S global selector codebooks are not supported";
+        return false;
+    }
+
+    codebook.selectors.resize(count);
+    bool raw = reader.bits(1) != 0;
+
+    if (raw) {
+        for (Selector& selector : codebook.selectors) {
+            for (uint8_t& row : selector.rows) row = static_cast<uint8_t>(reader.bits(8));
+        }
+    } else {
+        // The first selector is raw, every row after it is XORed with the same row of the one before.
+        Huffman delta;
+        if (!readHuffman(reader, delta)) return false;
+
+        for (uint32_t i = 0; i < count; i++) {
+            for (uint32_t row = 0; row < 4; row++) {
+                if (i == 0) {
+                    codebook.selectors[i].rows[row] = static_cast<uint8_t>(reader.bits(8));
+                    continue;
+                }
+
+                int32_t bits = delta.decode(reader);
+                if (bits < 0) return false;
+                codebook.selectors[i].rows[row] = static_cast<uint8_t>(bits ^ codebook.selectors[i - 1].rows[row]);
+            }
+        }
+    }
+
+    if (reader.overrun()) {
+        error = "truncated ETC1S selectors";
+        return false;
+    }
+
+    return true;
+}
+
+bool readTables(const uint8_t* data, size_t size, Codebook& codebook) {
+    BitReader reader(data, size);
+    if (!readHuffman(reader, codebook.endpointPred) || codebook.endpointPred.symbols.empty()) return false;
+    if (!readHuffman(reader, codebook.deltaEndpoint)) return false;
+    if (!readHuffman(reader, codebook.selector)) return false;
+    if (!readHuffman(reader, codebook.selectorHistoryRle)) return false;
+
+    codebook.selectorHistorySize = reader.bits(13);
+    return !reader.overrun();
+}
+
+// Recently used selectors, a hit swaps the entry halfway towards the front and new ones go in at a rover that
+// stays in the back half.
+class SelectorHistory {
+public:
+    SelectorHistory(uint32_t size) : values(size, 0), rover(size / 2) {}
+
+    uint32_t size() const { return static_cast<uint32_t>(values.size()); }
+    uint32_t operator[](uint32_t index) const { return values[index]; }
+
+    void add(uint32_t value) {
+        values[rover++] = value;
+        if (rover == values.size()) rover = static_cast<uint32_t>(values.size()) / 2;
+    }
+
+    void use(uint32_t index) {
+        if (index != 0) std::swap(values[index / 2], values[index]);
+    }
+
+private:
+    std::vector<uint32_t> values;
+    uint32_t rover;
+};
+
+// Endpoint indices come from the left, upper or upper left block or as a delta, one symbol picks them for a 2x2
+// group of blocks and can repeat the symbol before. Selectors come from the codebook, the history or a run of
+// the last one. Every block is written into the channels of rgba picked by alpha.
+bool decodeSlice(const uint8_t* data, size_t size, const Codebook& codebook, uint32_t width, uint32_t height, bool alpha,
+    std::vector<uint8_t>& rgba, std::string& error) {
+    const uint32_t repeatLastPred = 256;
+    const uint32_t predRepeatMin = 3;
+    const uint32_t predRepeatBits = 4;
+    const uint32_t rleThreshold = 3;
+    const uint32_t rleCountTotal = 64;
+
+    BitReader reader(data, size);
+
+    uint32_t blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    uint32_t endpointCount = static_cast<uint32_t>(codebook.endpoints.size());
+    uint32_t selectorCount = static_cast<uint32_t>(codebook.selectors.size());
+    uint32_t historyFirst = selectorCount;
+    uint32_t historyRle = selectorCount + codebook.selectorHistorySize;
+
+    struct Pred {
+        uint16_t endpoint = 0;
+        uint8_t bits = 0;
+    };
+
+    // Two rows, the current one and the one above, indexed by the parity of the row.
+    std::vector<Pred> preds[2] = { std::vector<Pred>(blocksX), std::vector<Pred>(blocksX) };
+    SelectorHistory history(codebook.selectorHistorySize);
+
+    uint32_t predBits = 0, lastPredSymbol = 0, predRepeat = 0;
+    uint32_t previousEndpoint = 0;
+    uint32_t selectorRun = 0;
+
+    auto fail = [&](const char* reason) {
+        error = reason;
+        return false;
+    };
+
+    for (uint32_t by = 0; by < blocksY; by++) {
+        uint32_t row = by & 1;
+
+        for (uint32_t bx = 0; bx < blocksX; bx++) {
+            if ((bx & 1) == 0) {
+                if (row == 0) {
+                    if (predRepeat > 0) {
+                        predRepeat--;
+                        predBits = lastPredSymbol;
+                    } else {
+                        int32_t symbol = codebook.endpointPred.decode(reader);
+                        if (symbol < 0) return fail("corrupt ETC1S endpoint predictions");
+
+                        if (static_cast<uint32_t>(symbol) == repeatLastPred) {
+                            predRepeat = reader.vlc(predRepeatBits) + predRepeatMin - 1;
+                            predBits = lastPredSymbol;
+                        } else {
+                            predBits = static_cast<uint32_t>(symbol);
+                            lastPredSymbol = predBits;
+                        }
+                    }
+
+                    // The upper half of the symbol belongs to the two blocks below these.
+                    preds[row ^ 1][bx].bits = static_cast<uint8_t>(predBits >> 4);
+                } else {
+                    predBits = preds[row][bx].bits;
+                }
+            }
+
+            uint32_t endpoint;
+            uint32_t pred = predBits & 3;
+            predBits >>= 2;
+
+            if (pred == 0) {
+                if (bx == 0) return fail("corrupt ETC1S endpoint predictions");
+                endpoint = previousEndpoint;
+            } else if (pred == 1) {
+                if (by == 0) return fail("corrupt ETC1S endpoint predictions");
+                endpoint = preds[row ^ 1][bx].endpoint;
+            } else if (pred == 2) {
+                if (bx == 0 || by == 0) return fail("corrupt ETC1S endpoint predictions");
+                endpoint = preds[row ^ 1][bx - 1].endpoint;
+            } else {
+                int32_t delta = codebook.deltaEndpoint.decode(reader);
+                if (delta < 0) return fail("corrupt ETC1S endpoint deltas");
+
+                endpoint = static_cast<uint32_t>(delta) + previousEndpoint;
+                if (endpoint >= endpointCount) endpoint -= endpointCount;
+            }
+
+            if (endpoint >= endpointCount) return fail("ETC1S endpoint out of range");
+            preds[row][bx].endpoint = static_cast<uint16_t>(endpoint);
+            previousEndpoint = endpoint;
+
+            uint32_t symbol;
+            if (selectorRun > 0) {
+                selectorRun--;
+                symbol = historyFirst;
+            } else {
+                int32_t decoded = codebook.selector.decode(reader);
+                if (decoded < 0) return fail("corrupt ETC1S selectors");
+                symbol = static_cast<uint32_t>(decoded);
+
+                if (symbol == historyRle) {
+                    int32_t run = codebook.selectorHistoryRle.decode(reader);
+                    if (run < 0) return fail("corrupt ETC1S selector runs");
+
+                    selectorRun = static_cast<uint32_t>(run) == rleCountTotal - 1 ? reader.vlc(7) + rleThreshold : run + rleThreshold;
+                    if (selectorRun > blocksX * blocksY) return fail("ETC1S selector run out of range");
+
+                    symbol = historyFirst;
+                    selectorRun--;
+                }
+            }
+
+            uint32_t selector;
+            if (symbol >= historyFirst) {
+                uint32_t index = symbol - historyFirst;
+                if (index >= history.size()) return fail("ETC1S selector history out of range");
+
+                selector = history[index];
+                history.use(index);
+            } else {
+                selector = symbol;
+                if (history.size() > 0) history.add(selector);
+            }
+
+            if (selector >= selectorCount) return fail("ETC1S selector out of range");
+
+            // Both halves of an ETC1S block share the base color and modifier table.
+            const Endpoint& e = codebook.endpoints[endpoint];
+            const Selector& s = codebook.selectors[selector];
+            int32_t base[3];
+            for (int c = 0; c < 3; c++) base[c] = (e.color[c] << 3) | (e.color[c] >> 2);
+
+            for (uint32_t y = 0; y < 4 && by * 4 + y < height; y++) {
+                for (uint32_t x = 0; x < 4 && bx * 4 + x < width; x++) {
+                    int32_t modifier = modifiers[e.inten][(s.rows[y] >> (x * 2)) & 3];
+                    uint8_t* pixel = rgba.data() + (static_cast<size_t>(by * 4 + y) * width + bx * 4 + x) * 4;
+
+                    if (alpha) {
+                        pixel[3] = static_cast<uint8_t>(std::clamp(base[1] + modifier, 0, 255));
+                        continue;
+                    }
+
+                    for (int c = 0; c < 3; c++) pixel[c] = static_cast<uint8_t>(std::clamp(base[c] + modifier, 0, 255));
+                }
+            }
+        }
+    }
+
+    if (reader.overrun()) return fail("truncated ETC1S slice");
+    return true;
+}
+}
+
+bool Adren::Basis::transcodeEtc1s(const uint8_t* global, size_t globalSize, uint32_t imageCount, uint32_t image, const uint8_t* level,
+    size_t levelSize, uint32_t width, uint32_t height, std::vector<uint8_t>& rgba, std::string& error) {
+    GlobalHeader header;
+    size_t descOffset = sizeof(GlobalHeader);
+    size_t dataOffset = descOffset + static_cast<size_t>(imageCount) * sizeof(ImageDesc);
+
+    if (globalSize < dataOffset || image >= imageCount) {
+        error = "truncated BasisLZ global data";
+        return false;
+    }
+
+    memcpy(&header, global, sizeof(GlobalHeader));
+    if (dataOffset + header.endpointsByteLength + header.selectorsByteLength + header.tablesByteLength > globalSize) {
+        error = "truncated BasisLZ global data";
+        return false;
+    }
+
+    if (header.endpointCount == 0 || header.selectorCount == 0) {
+        error = "BasisLZ global data without codebooks";
+        return false;
+    }
+
+    ImageDesc desc;
+    memcpy(&desc, global + descOffset + static_cast<size_t>(image) * sizeof(ImageDesc), sizeof(ImageDesc));
+
+    if (desc.imageFlags & isPFrame) {
+        error = "ETC1S video frames are not supported";
+        return false;
+    }
+
+    if (static_cast<uint64_t>(desc.rgbSliceByteOffset) + desc.rgbSliceByteLength > levelSize ||
+        static_cast<uint64_t>(desc.alphaSliceByteOffset) + desc.alphaSliceByteLength > levelSize) {
+        error = "ETC1S slice is out of bounds";
+        return false;
+    }
+
+    const uint8_t* endpoints = global + dataOffset;
+    const uint8_t* selectors = endpoints + header.endpointsByteLength;
+    const uint8_t* tables = selectors + header.selectorsByteLength;
+
+    Codebook codebook;
+    if (!readEndpoints(endpoints, header.endpointsByteLength, header.endpointCount, codebook)) {
+        error = "corrupt ETC1S endpoint codebook";
+        return false;
+    }
+
+    if (!readSelectors(selectors, header.selectorsByteLength, header.selectorCount, codebook, error)) {
+        if (error.empty()) error = "corrupt ETC1S selector codebook";
+        return false;
+    }
+
+    if (!readTables(tables, header.tablesByteLength, codebook)) {
+        error = "corrupt ETC1S Huffman tables";
+        return false;
+    }
+
+    rgba.assign(static_cast<size_t>(width) * height * 4, 255);
+
+    if (!decodeSlice(level + desc.rgbSliceByteOffset, desc.rgbSliceByteLength, codebook, width, height, false, rgba, error)) return false;
+    if (desc.alphaSliceByteLength == 0) return true;
+    return decodeSlice(level + desc.alphaSliceByteOffset, desc.alphaSliceByteLength, codebook, width, height, true, rgba, error);
+}
@@ -0,0 +1,20 @@
+/*
+	basis.h
+	Adrenaline Engine
+
+	This transcodes the ETC1S images of BasisLZ supercompressed KTX2 files (KHR_texture_basisu) to RGBA8.
+	The block compressor then turns them into the BCn format of their role, like any other decoded image.
+*/
+
+#pragma once
+#include "types.h"
+#include <vector>
+#include <string>
+
+namespace Adren::Basis {
+	// global is the supercompression global data of the file, with one image description for each of its
+	// imageCount images. level holds the bytes of the mip level the image belongs to, its slices are offsets
+	// into it. The alpha slice goes into the alpha channel, images without one are opaque.
+	bool transcodeEtc1s(const uint8_t* global, size_t globalSize, uint32_t imageCount, uint32_t image, const uint8_t* level,
+		size_t levelSize, uint32_t width, uint32_t height, std::vector<uint8_t>& rgba, std::string& error);
+}
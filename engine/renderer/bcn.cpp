@@ -0,0 +1,713 @@
+/*
+    bcn.cpp
+    Adrenaline Engine
+
+    Definitions for the block compression encoders.
+    Block layouts follow the Khronos Data Format Specification, BC7 blocks are always written in mode 6.
+*/
+
+#include "bcn.h"
+#include "tools.h"
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ADREN_BCN_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+using Format = Adren::Bcn::Format;
+using Quality = Adren::Bcn::Quality;
+
+// A 4x4 block with one array per channel, the index search reads four pixels of a channel at once.
+struct Block {
+    alignas(16) int32_t c[4][16];
+};
+
+// The colors a block can reproduce, laid out like the block.
+struct Palette {
+    alignas(16) int32_t c[4][16];
+    uint32_t count = 0;
+};
+
+const float bc1Weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+const float bc4Weights[8] = { 0.0f, 1.0f, 1.0f / 7.0f, 2.0f / 7.0f, 3.0f / 7.0f, 4.0f / 7.0f, 5.0f / 7.0f, 6.0f / 7.0f };
+const int32_t bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+size_t blockBytes(Format format) {
+    return format == Format::BC1 || format == Format::BC4 ? 8 : 16;
+}
+
+int channelCount(Format format) {
+    switch (format) {
+    case Format::BC1: return 3;
+    case Format::BC4: return 1;
+    case Format::BC5: return 2;
+    default: return 4;
+    }
+}
+
+// Picks the nearest palette entry of every pixel over channels [first, first + channels) and returns the summed squared error.
+uint32_t fitIndices(const Block& block, const Palette& palette, int first, int channels, uint8_t indices[16]) {
+    uint32_t total = 0;
+
+#ifdef ADREN_BCN_SSE2
+    for (int i = 0; i < 16; i += 4) {
+        __m128i pixels[4];
+        for (int c = 0; c < channels; c++) {
+            pixels[c] = _mm_load_si128(reinterpret_cast<const __m128i*>(&block.c[first + c][i]));
+        }
+
+        __m128i best = _mm_set1_epi32(std::numeric_limits<int32_t>::max());
+        __m128i bestIndex = _mm_setzero_si128();
+
+        for (uint32_t e = 0; e < palette.count; e++) {
+            __m128i error = _mm_setzero_si128();
+            for (int c = 0; c < channels; c++) {
+                // Absolute differences fit in the low 16 bits, so madd squares them without SSE4.1.
+                __m128i d = _mm_sub_epi32(pixels[c], _mm_set1_epi32(palette.c[first + c][e]));
+                __m128i sign = _mm_srai_epi32(d, 31);
+                d = _mm_sub_epi32(_mm_xor_si128(d, sign), sign);
+                error = _mm_add_epi32(error, _mm_madd_epi16(d, d));
+            }
+
+            __m128i less = _mm_cmplt_epi32(error, best);
+            best = _mm_or_si128(_mm_and_si128(less, error), _mm_andnot_si128(less, best));
+            bestIndex = _mm_or_si128(_mm_and_si128(less, _mm_set1_epi32(static_cast<int32_t>(e))), _mm_andnot_si128(less, bestIndex));
+        }
+
+        alignas(16) int32_t errors[4];
+        alignas(16) int32_t chosen[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(errors), best);
+        _mm_store_si128(reinterpret_cast<__m128i*>(chosen), bestIndex);
+
+        for (int k = 0; k < 4; k++) {
+            indices[i + k] = static_cast<uint8_t>(chosen[k]);
+            total += static_cast<uint32_t>(errors[k]);
+        }
+    }
+#else
+    for (int i = 0; i < 16; i++) {
+        int32_t best = std::numeric_limits<int32_t>::max();
+        for (uint32_t e = 0; e < palette.count; e++) {
+            int32_t error = 0;
+            for (int c = first; c < first + channels; c++) {
+                int32_t d = block.c[c][i] - palette.c[c][e];
+                error += d * d;
+            }
+
+            if (error < best) {
+                best = error;
+                indices[i] = static_cast<uint8_t>(e);
+            }
+        }
+
+        total += static_cast<uint32_t>(best);
+    }
+#endif
+
+    return total;
+}
+
+// The extremes of a block along its principal axis, or along the diagonal of its bounding box when fast.
+void fitEndpoints(const Block& block, int first, int channels, bool fast, float e0[4], float e1[4]) {
+    float mean[4] = {};
+    for (int c = first; c < first + channels; c++) {
+        for (int i = 0; i < 16; i++) mean[c] += block.c[c][i] / 16.0f;
+    }
+
+    float axis[4] = {};
+    if (fast) {
+        int widest = first;
+        for (int c = first; c < first + channels; c++) {
+            auto [lo, hi] = std::minmax_element(block.c[c], block.c[c] + 16);
+            axis[c] = static_cast<float>(*hi - *lo);
+            if (axis[c] > axis[widest]) widest = c;
+        }
+
+        // Channels that fall while the widest one rises run along the other diagonal.
+        for (int c = first; c < first + channels; c++) {
+            float covariance = 0.0f;
+            for (int i = 0; i < 16; i++) covariance += (block.c[c][i] - mean[c]) * (block.c[widest][i] - mean[widest]);
+            if (covariance < 0.0f) axis[c] = -axis[c];
+        }
+    } else {
+        float covariance[4][4] = {};
+        for (int i = 0; i < 16; i++) {
+            for (int a = first; a < first + channels; a++) {
+                for (int b = first; b < first + channels; b++) {
+                    covariance[a][b] += (block.c[a][i] - mean[a]) * (block.c[b][i] - mean[b]);
+                }
+            }
+        }
+
+        // Power iteration from the row of the channel with the largest variance.
+        int widest = first;
+        for (int c = first; c < first + channels; c++) {
+            if (covariance[c][c] > covariance[widest][widest]) widest = c;
+        }
+
+        for (int c = first; c < first + channels; c++) axis[c] = covariance[widest][c];
+
+        for (int iteration = 0; iteration < 8; iteration++) {
+            float next[4] = {};
+            float largest = 0.0f;
+            for (int a = first; a < first + channels; a++) {
+                for (int b = first; b < first + channels; b++) next[a] += covariance[a][b] * axis[b];
+                largest = std::max(largest, std::abs(next[a]));
+            }
+
+            if (largest == 0.0f) break;
+            for (int c = first; c < first + channels; c++) axis[c] = next[c] / largest;
+        }
+    }
+
+    float length = 0.0f;
+    for (int c = first; c < first + channels; c++) length += axis[c] * axis[c];
+    length = std::sqrt(length);
+
+    float lo = 0.0f, hi = 0.0f;
+    if (length > 0.0f) {
+        for (int c = first; c < first + channels; c++) axis[c] /= length;
+
+        lo = FLT_MAX;
+        hi = -FLT_MAX;
+        for (int i = 0; i < 16; i++) {
+            float projection = 0.0f;
+            for (int c = first; c < first + channels; c++) projection += (block.c[c][i] - mean[c]) * axis[c];
+            lo = std::min(lo, projection);
+            hi = std::max(hi, projection);
+        }
+    }
+
+    for (int c = first; c < first + channels; c++) {
+        e0[c] = std::clamp(mean[c] + axis[c] * hi, 0.0f, 255.0f);
+        e1[c] = std::clamp(mean[c] + axis[c] * lo, 0.0f, 255.0f);
+    }
+}
+
+// The endpoints that minimize the squared error of every pixel reproduced as mix(e0, e1, weights[index]).
+bool leastSquares(const Block& block, const uint8_t indices[16], const float* weights, int first, int channels, float e0[4], float e1[4]) {
+    float a = 0.0f, b = 0.0f, c = 0.0f;
+    float x0[4] = {}, x1[4] = {};
+
+    for (int i = 0; i < 16; i++) {
+        float t = weights[indices[i]];
+        float s = 1.0f - t;
+        a += s * s;
+        b += s * t;
+        c += t * t;
+
+        for (int k = first; k < first + channels; k++) {
+            x0[k] += s * block.c[k][i];
+            x1[k] += t * block.c[k][i];
+        }
+    }
+
+    float determinant = a * c - b * b;
+    if (std::abs(determinant) < 1e-6f) return false;
+
+    for (int k = first; k < first + channels; k++) {
+        e0[k] = std::clamp((c * x0[k] - b * x1[k]) / determinant, 0.0f, 255.0f);
+        e1[k] = std::clamp((a * x1[k] - b * x0[k]) / determinant, 0.0f, 255.0f);
+    }
+
+    return true;
+}
+
+int refinements(Quality quality) {
+    return quality == Quality::Fast ? 0 : quality == Quality::Normal ? 1 : 3;
+}
+
+uint16_t pack565(const float color[4]) {
+    uint16_t r = static_cast<uint16_t>(std::lround(color[0] * 31.0f / 255.0f));
+    uint16_t g = static_cast<uint16_t>(std::lround(color[1] * 63.0f / 255.0f));
+    uint16_t b = static_cast<uint16_t>(std::lround(color[2] * 31.0f / 255.0f));
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+void unpack565(uint16_t color, int32_t rgb[3]) {
+    int32_t r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+// The four color palette, the only one the encoder writes.
+void bc1Palette(uint16_t c0, uint16_t c1, Palette& palette) {
+    int32_t a[3], b[3];
+    unpack565(c0, a);
+    unpack565(c1, b);
+
+    palette.count = 4;
+    for (int c = 0; c < 3; c++) {
+        palette.c[c][0] = a[c];
+        palette.c[c][1] = b[c];
+        palette.c[c][2] = (2 * a[c] + b[c]) / 3;
+        palette.c[c][3] = (a[c] + 2 * b[c]) / 3;
+    }
+}
+
+void encodeBC1(const Block& block, Quality quality, uint8_t* out) {
+    float e0[4], e1[4];
+    fitEndpoints(block, 0, 3, quality == Quality::Fast, e0, e1);
+
+    uint16_t c0 = pack565(e0), c1 = pack565(e1);
+    Palette palette;
+    uint8_t indices[16];
+    bc1Palette(c0, c1, palette);
+    uint32_t error = fitIndices(block, palette, 0, 3, indices);
+
+    for (int iteration = 0; iteration < refinements(quality) && error > 0; iteration++) {
+        if (!leastSquares(block, indices, bc1Weights, 0, 3, e0, e1)) break;
+
+        uint16_t n0 = pack565(e0), n1 = pack565(e1);
+        uint8_t candidate[16];
+        bc1Palette(n0, n1, palette);
+        uint32_t candidateError = fitIndices(block, palette, 0, 3, candidate);
+        if (candidateError >= error) break;
+
+        c0 = n0;
+        c1 = n1;
+        error = candidateError;
+        memcpy(indices, candidate, sizeof(indices));
+    }
+
+    // The four color mode needs c0 > c1, swapping the endpoints swaps indices 0 with 1 and 2 with 3.
+    if (c0 < c1) {
+        std::swap(c0, c1);
+        for (uint8_t& index : indices) index ^= 1;
+    } else if (c0 == c1) {
+        memset(indices, 0, sizeof(indices));
+    }
+
+    uint32_t bits = 0;
+    for (int i = 0; i < 16; i++) bits |= static_cast<uint32_t>(indices[i]) << (2 * i);
+
+    out[0] = static_cast<uint8_t>(c0);
+    out[1] = static_cast<uint8_t>(c0 >> 8);
+    out[2] = static_cast<uint8_t>(c1);
+    out[3] = static_cast<uint8_t>(c1 >> 8);
+    for (int i = 0; i < 4; i++) out[4 + i] = static_cast<uint8_t>(bits >> (8 * i));
+}
+
+// The eight value palette, the only one the encoder writes.
+void bc4Palette(int32_t e0, int32_t e1, int channel, Palette& palette) {
+    palette.count = 8;
+    palette.c[channel][0] = e0;
+    palette.c[channel][1] = e1;
+    for (int i = 2; i < 8; i++) palette.c[channel][i] = ((8 - i) * e0 + (i - 1) * e1 + 3) / 7;
+}
+
+void encodeBC4(const Block& block, int channel, Quality quality, uint8_t* out) {
+    auto [lo, hi] = std::minmax_element(block.c[channel], block.c[channel] + 16);
+    int32_t e0 = *hi, e1 = *lo;
+
+    Palette palette;
+    uint8_t indices[16];
+    bc4Palette(e0, e1, channel, palette);
+    uint32_t error = fitIndices(block, palette, channel, 1, indices);
+
+    auto attempt = [&](int32_t n0, int32_t n1) {
+        n0 = std::clamp(n0, 0, 255);
+        n1 = std::clamp(n1, 0, 255);
+        if (n0 < n1) std::swap(n0, n1);
+
+        uint8_t candidate[16];
+        bc4Palette(n0, n1, channel, palette);
+        uint32_t candidateError = fitIndices(block, palette, channel, 1, candidate);
+        if (candidateError >= error) return false;
+
+        e0 = n0;
+        e1 = n1;
+        error = candidateError;
+        memcpy(indices, candidate, sizeof(indices));
+        return true;
+    };
+
+    for (int iteration = 0; iteration < refinements(quality) && error > 0; iteration++) {
+        float f0[4], f1[4];
+        if (!leastSquares(block, indices, bc4Weights, channel, 1, f0, f1)) break;
+        if (!attempt(std::lround(f0[channel]), std::lround(f1[channel]))) break;
+    }
+
+    if (quality == Quality::High && error > 0) {
+        int32_t b0 = e0, b1 = e1;
+        for (int32_t d0 = -2; d0 <= 2; d0++) {
+            for (int32_t d1 = -2; d1 <= 2; d1++) attempt(b0 + d0, b1 + d1);
+        }
+    }
+
+    // Equal endpoints select the six value palette, where index 0 still decodes to e0.
+    if (e0 == e1) memset(indices, 0, sizeof(indices));
+
+    uint64_t bits = 0;
+    for (int i = 0; i < 16; i++) bits |= static_cast<uint64_t>(indices[i]) << (3 * i);
+
+    out[0] = static_cast<uint8_t>(e0);
+    out[1] = static_cast<uint8_t>(e1);
+    for (int i = 0; i < 6; i++) out[2 + i] = static_cast<uint8_t>(bits >> (8 * i));
+}
+
+// Mode 6 endpoints have 7 bits per channel and one shared lowest bit.
+void quantizeBc7(const float endpoint[4], uint8_t q[4], uint8_t& p) {
+    float bestError = FLT_MAX;
+    for (uint8_t bit = 0; bit < 2; bit++) {
+        uint8_t candidate[4];
+        float error = 0.0f;
+        for (int c = 0; c < 4; c++) {
+            candidate[c] = static_cast<uint8_t>(std::clamp<long>(std::lround((endpoint[c] - bit) / 2.0f), 0, 127));
+            float d = static_cast<float>((candidate[c] << 1) | bit) - endpoint[c];
+            error += d * d;
+        }
+
+        if (error < bestError) {
+            bestError = error;
+            memcpy(q, candidate, 4);
+            p = bit;
+        }
+    }
+}
+
+void bc7Palette(const uint8_t q0[4], uint8_t p0, const uint8_t q1[4], uint8_t p1, Palette& palette) {
+    palette.count = 16;
+    for (int c = 0; c < 4; c++) {
+        int32_t a = (q0[c] << 1) | p0, b = (q1[c] << 1) | p1;
+        for (int i = 0; i < 16; i++) palette.c[c][i] = ((64 - bc7Weights[i]) * a + bc7Weights[i] * b + 32) >> 6;
+    }
+}
+
+struct Bits {
+    uint64_t words[2] = {};
+    uint32_t position = 0;
+
+    void write(uint32_t value, uint32_t count) {
+        for (uint32_t i = 0; i < count; i++, position++) {
+            if ((value >> i) & 1) words[position >> 6] |= uint64_t(1) << (position & 63);
+        }
+    }
+
+    uint32_t read(uint32_t count) {
+        uint32_t value = 0;
+        for (uint32_t i = 0; i < count; i++, position++) {
+            value |= static_cast<uint32_t>((words[position >> 6] >> (position & 63)) & 1) << i;
+        }
+        return value;
+    }
+};
+
+void encodeBC7(const Block& block, Quality quality, uint8_t* out) {
+    struct Candidate {
+        uint8_t q0[4], q1[4];
+        uint8_t p0 = 0, p1 = 0;
+        uint8_t indices[16];
+        uint32_t error = std::numeric_limits<uint32_t>::max();
+    } best;
+
+    Palette palette;
+    auto attempt = [&](const float e0[4], const float e1[4]) {
+        Candidate candidate;
+        quantizeBc7(e0, candidate.q0, candidate.p0);
+        quantizeBc7(e1, candidate.q1, candidate.p1);
+        bc7Palette(candidate.q0, candidate.p0, candidate.q1, candidate.p1, palette);
+        candidate.error = fitIndices(block, palette, 0, 4, candidate.indices);
+        if (candidate.error >= best.error) return false;
+
+        best = candidate;
+        return true;
+    };
+
+    float e0[4], e1[4];
+    fitEndpoints(block, 0, 4, quality == Quality::Fast, e0, e1);
+    attempt(e0, e1);
+
+    float weights[16];
+    for (int i = 0; i < 16; i++) weights[i] = bc7Weights[i] / 64.0f;
+
+    for (int iteration = 0; iteration < refinements(quality) && best.error > 0; iteration++) {
+        if (!leastSquares(block, best.indices, weights, 0, 4, e0, e1)) break;
+        if (!attempt(e0, e1)) break;
+    }
+
+    // The first index is stored without its top bit, so it has to be below 8.
+    if (best.indices[0] >= 8) {
+        std::swap(best.q0, best.q1);
+        std::swap(best.p0, best.p1);
+        for (uint8_t& index : best.indices) index = 15 - index;
+    }
+
+    Bits bits;
+    bits.write(1 << 6, 7);
+    for (int c = 0; c < 4; c++) {
+        bits.write(best.q0[c], 7);
+        bits.write(best.q1[c], 7);
+    }
+
+    bits.write(best.p0, 1);
+    bits.write(best.p1, 1);
+    bits.write(best.indices[0], 3);
+    for (int i = 1; i < 16; i++) bits.write(best.indices[i], 4);
+
+    for (int i = 0; i < 16; i++) out[i] = static_cast<uint8_t>(bits.words[i / 8] >> (8 * (i % 8)));
+}
+
+void encodeBlock(const Block& block, Format format, Quality quality, uint8_t* out) {
+    switch (format) {
+    case Format::BC1: encodeBC1(block, quality, out); break;
+    case Format::BC3: encodeBC4(block, 3, quality, out); encodeBC1(block, quality, out + 8); break;
+    case Format::BC4: encodeBC4(block, 0, quality, out); break;
+    case Format::BC5: encodeBC4(block, 0, quality, out); encodeBC4(block, 1, quality, out + 8); break;
+    case Format::BC7: encodeBC7(block, quality, out); break;
+    }
+}
+
+// The decoders only exist to measure what the encoders lost.
+void decodeBC1(const uint8_t* in, bool fourColors, uint8_t out[16][4]) {
+    uint16_t c0 = static_cast<uint16_t>(in[0] | (in[1] << 8));
+    uint16_t c1 = static_cast<uint16_t>(in[2] | (in[3] << 8));
+    int32_t a[3], b[3];
+    unpack565(c0, a);
+    unpack565(c1, b);
+
+    int32_t palette[4][4];
+    for (int c = 0; c < 3; c++) {
+        palette[0][c] = a[c];
+        palette[1][c] = b[c];
+        if (fourColors || c0 > c1) {
+            palette[2][c] = (2 * a[c] + b[c]) / 3;
+            palette[3][c] = (a[c] + 2 * b[c]) / 3;
+        } else {
+            palette[2][c] = (a[c] + b[c]) / 2;
+            palette[3][c] = 0;
+        }
+    }
+
+    for (int e = 0; e < 4; e++) palette[e][3] = 255;
+    if (!fourColors && c0 <= c1) palette[3][3] = 0;
+
+    uint32_t bits = in[4] | (in[5] << 8) | (in[6] << 16) | (static_cast<uint32_t>(in[7]) << 24);
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 4; c++) out[i][c] = static_cast<uint8_t>(palette[(bits >> (2 * i)) & 3][c]);
+    }
+}
+
+void decodeBC4(const uint8_t* in, int channel, uint8_t out[16][4]) {
+    int32_t e0 = in[0], e1 = in[1];
+    int32_t palette[8] = { e0, e1 };
+    if (e0 > e1) {
+        for (int i = 2; i < 8; i++) palette[i] = ((8 - i) * e0 + (i - 1) * e1 + 3) / 7;
+    } else {
+        for (int i = 2; i < 6; i++) palette[i] = ((6 - i) * e0 + (i - 1) * e1 + 2) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+
+    uint64_t bits = 0;
+    for (int i = 0; i < 6; i++) bits |= static_cast<uint64_t>(in[2 + i]) << (8 * i);
+    for (int i = 0; i < 16; i++) out[i][channel] = static_cast<uint8_t>(palette[(bits >> (3 * i)) & 7]);
+}
+
+void decodeBC7(const uint8_t* in, uint8_t out[16][4]) {
+    Bits bits;
+    for (int i = 0; i < 16; i++) bits.words[i / 8] |= static_cast<uint64_t>(in[i]) << (8 * (i % 8));
+
+    if (bits.read(7) != (1 << 6)) {
+        memset(out, 0, 64);
+        return;
+    }
+
+    uint8_t q0[4], q1[4];
+    for (int c = 0; c < 4; c++) {
+        q0[c] = static_cast<uint8_t>(bits.read(7));
+        q1[c] = static_cast<uint8_t>(bits.read(7));
+    }
+
+    uint8_t p0 = static_cast<uint8_t>(bits.read(1));
+    uint8_t p1 = static_cast<uint8_t>(bits.read(1));
+
+    Palette palette;
+    bc7Palette(q0, p0, q1, p1, palette);
+
+    for (int i = 0; i < 16; i++) {
+        uint32_t index = bits.read(i == 0 ? 3 : 4);
+        for (int c = 0; c < 4; c++) out[i][c] = static_cast<uint8_t>(palette.c[c][index]);
+    }
+}
+
+void decodeBlock(const uint8_t* in, Format format, uint8_t out[16][4]) {
+    memset(out, 0, 64);
+    switch (format) {
+    case Format::BC1: decodeBC1(in, false, out); break;
+    case Format::BC3: decodeBC1(in + 8, true, out); decodeBC4(in, 3, out); break;
+    case Format::BC4: decodeBC4(in, 0, out); break;
+    case Format::BC5: decodeBC4(in, 0, out); decodeBC4(in + 8, 1, out); break;
+    case Format::BC7: decodeBC7(in, out); break;
+    }
+}
+
+// Pixels past the edge of the image repeat the last row and column.
+void loadBlock(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t bx, uint32_t by, Block& block) {
+    for (uint32_t y = 0; y < 4; y++) {
+        for (uint32_t x = 0; x < 4; x++) {
+            uint32_t px = std::min(bx * 4 + x, width - 1);
+            uint32_t py = std::min(by * 4 + y, height - 1);
+            const uint8_t* pixel = pixels + (static_cast<size_t>(py) * width + px) * 4;
+            for (int c = 0; c < 4; c++) block.c[c][y * 4 + x] = pixel[c];
+        }
+    }
+}
+
+const std::array<float, 256>& srgbToLinear() {
+    static const std::array<float, 256> table = []() {
+        std::array<float, 256> values{};
+        for (int i = 0; i < 256; i++) {
+            float v = i / 255.0f;
+            values[i] = v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+        }
+        return values;
+    }();
+
+    return table;
+}
+
+uint8_t linearToSrgb(float v) {
+    v = std::clamp(v, 0.0f, 1.0f);
+    float s = v <= 0.0031308f ? v * 12.92f : 1.055f * std::pow(v, 1.0f / 2.4f) - 0.055f;
+    return static_cast<uint8_t>(s * 255.0f + 0.5f);
+}
+
+}
+
+std::vector<uint8_t> Adren::Bcn::downsample(const std::vector<uint8_t>& source, uint32_t width, uint32_t height, bool srgb) {
+    uint32_t nextWidth = std::max(width / 2, 1u), nextHeight = std::max(height / 2, 1u);
+    std::vector<uint8_t> result(static_cast<size_t>(nextWidth) * nextHeight * 4);
+    const std::array<float, 256>& toLinear = srgbToLinear();
+
+    for (uint32_t y = 0; y < nextHeight; y++) {
+        for (uint32_t x = 0; x < nextWidth; x++) {
+            uint32_t x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+            uint32_t y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+            const uint8_t* p[4] = {
+                &source[(static_cast<size_t>(y0) * width + x0) * 4], &source[(static_cast<size_t>(y0) * width + x1) * 4],
+                &source[(static_cast<size_t>(y1) * width + x0) * 4], &source[(static_cast<size_t>(y1) * width + x1) * 4],
+            };
+
+            uint8_t* out = &result[(static_cast<size_t>(y) * nextWidth + x) * 4];
+            for (int c = 0; c < 4; c++) {
+                if (srgb && c < 3) {
+                    out[c] = linearToSrgb((toLinear[p[0][c]] + toLinear[p[1][c]] + toLinear[p[2][c]] + toLinear[p[3][c]]) * 0.25f);
+                } else {
+                    out[c] = static_cast<uint8_t>((p[0][c] + p[1][c] + p[2][c] + p[3][c] + 2) / 4);
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+VkFormat Adren::Bcn::vkFormat(Format format, bool srgb) {
+    switch (format) {
+    case Format::BC1: return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    case Format::BC3: return srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+    case Format::BC4: return VK_FORMAT_BC4_UNORM_BLOCK;
+    case Format::BC5: return VK_FORMAT_BC5_UNORM_BLOCK;
+    case Format::BC7: return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+    }
+
+    return VK_FORMAT_UNDEFINED;
+}
+
+const char* Adren::Bcn::name(Format format) {
+    switch (format) {
+    case Format::BC1: return "BC1";
+    case Format::BC3: return "BC3";
+    case Format::BC4: return "BC4";
+    case Format::BC5: return "BC5";
+    case Format::BC7: return "BC7";
+    }
+
+    return "Unknown";
+}
+
+Adren::Bcn::Result Adren::Bcn::compress(const uint8_t* rgba, uint32_t width, uint32_t height, Format format, bool srgb, Quality quality) {
+    srgb = srgb && format != Format::BC4 && format != Format::BC5;
+
+    std::vector<std::vector<uint8_t>> mips;
+    std::vector<glm::uvec2> sizes = { { width, height } };
+    mips.emplace_back(rgba, rgba + static_cast<size_t>(width) * height * 4);
+
+    while (sizes.back().x > 1 || sizes.back().y > 1) {
+        glm::uvec2 size = sizes.back();
+        mips.push_back(downsample(mips.back(), size.x, size.y, srgb));
+        sizes.push_back({ std::max(size.x / 2, 1u), std::max(size.y / 2, 1u) });
+    }
+
+    struct Row {
+        uint32_t level;
+        uint32_t y;
+    };
+
+    Result result;
+    std::vector<Row> rows;
+    size_t size = 0;
+    size_t bytes = blockBytes(format);
+
+    for (uint32_t level = 0; level < sizes.size(); level++) {
+        uint32_t blocksX = (sizes[level].x + 3) / 4, blocksY = (sizes[level].y + 3) / 4;
+        result.levels.push_back(size);
+        for (uint32_t y = 0; y < blocksY; y++) rows.push_back({ level, y });
+        size += static_cast<size_t>(blocksX) * blocksY * bytes;
+    }
+
+    result.data.resize(size);
+
+    Adren::Tools::parallelFor(rows.size(), [&](size_t r) {
+        const Row& row = rows[r];
+        glm::uvec2 extent = sizes[row.level];
+        uint32_t blocksX = (extent.x + 3) / 4;
+        uint8_t* out = result.data.data() + result.levels[row.level] + static_cast<size_t>(row.y) * blocksX * bytes;
+
+        Block block;
+        for (uint32_t x = 0; x < blocksX; x++) {
+            loadBlock(mips[row.level].data(), extent.x, extent.y, x, row.y, block);
+            encodeBlock(block, format, quality, out + x * bytes);
+        }
+    });
+
+    // The error is measured on the top level against the channels the format keeps.
+    uint32_t blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    int channels = channelCount(format);
+    std::vector<uint64_t> rowErrors(blocksY, 0);
+
+    Adren::Tools::parallelFor(blocksY, [&](size_t by) {
+        uint8_t decoded[16][4];
+        for (uint32_t bx = 0; bx < blocksX; bx++) {
+            decodeBlock(result.data.data() + (by * blocksX + bx) * bytes, format, decoded);
+
+            for (uint32_t i = 0; i < 16; i++) {
+                uint32_t px = bx * 4 + i % 4, py = static_cast<uint32_t>(by) * 4 + i / 4;
+                if (px >= width || py >= height) continue;
+
+                const uint8_t* pixel = rgba + (static_cast<size_t>(py) * width + px) * 4;
+                for (int c = 0; c < channels; c++) {
+                    int32_t d = static_cast<int32_t>(decoded[i][c]) - pixel[c];
+                    rowErrors[by] += static_cast<uint64_t>(d * d);
+                }
+            }
+        }
+    });
+
+    uint64_t error = 0;
+    for (uint64_t rowError : rowErrors) error += rowError;
+
+    double mse = static_cast<double>(error) / (static_cast<double>(width) * height * channels);
+    result.psnr = mse > 0.0 ? static_cast<float>(10.0 * std::log10(255.0 * 255.0 / mse)) : std::numeric_limits<float>::infinity();
+
+    return result;
+}
@@ -0,0 +1,35 @@
+/*
+	bcn.h
+	Adrenaline Engine
+
+	This block compresses RGBA8 images to BC1, BC3, BC4, BC5 and BC7 with their mip chains.
+*/
+
+#pragma once
+#include "types.h"
+#include <vector>
+
+namespace Adren::Bcn {
+	enum class Format { BC1, BC3, BC4, BC5, BC7 };
+
+	// Fast fits endpoints to the bounding box of a block, Normal to its principal axis with one least squares pass,
+	// High refines three times and searches around the BC4 endpoints.
+	enum class Quality { Fast, Normal, High };
+
+	struct Result {
+		std::vector<uint8_t> data;
+		std::vector<VkDeviceSize> levels; // Offset of every mip level in data, largest first.
+		float psnr = 0.0f;                // Of the top level over the channels the format keeps, in dB.
+	};
+
+	// BC4 and BC5 have no sRGB variant, srgb is ignored for them.
+	VkFormat vkFormat(Format format, bool srgb);
+	const char* name(Format format);
+
+	// The next mip level of an RGBA8 image with a 2x2 box filter, in linear space for sRGB. Odd sizes drop their last row or column.
+	std::vector<uint8_t> downsample(const std::vector<uint8_t>& rgba, uint32_t width, uint32_t height, bool srgb);
+
+	// Builds the mip chain of an RGBA8 image and compresses every level, rows of blocks are spread across the
+	// hardware threads. sRGB images are filtered in linear space. BC4 keeps red, BC5 red and green, BC1 has no alpha.
+	Result compress(const uint8_t* rgba, uint32_t width, uint32_t height, Format format, bool srgb, Quality quality);
+}
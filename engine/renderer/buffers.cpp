@@ -13,10 +13,46 @@
 
 void Adren::Buffers::createModelBuffers(std::vector<Model*>& models, VkCommandPool& commandPool) {
     std::vector<Vertex> vertices;
-    std::vector<uint32_t> indices;
+    std::vector<uint32_t> indices32;
+    std::vector<uint16_t> indices16;
+    size_t indexCount = 0;
 
     for (Model* model : models) {
-        indices.insert(indices.end(), model->indices.begin(), model->indices.end());
+        int32_t vertexBase = static_cast<int32_t>(vertices.size());
+
+        for (Model::Mesh& mesh : model->meshes) {
+            for (Model::Primitive& primitive : mesh.primitives) {
+                if (primitive.indexCount == 0) continue;
+
+                primitive.vertexOffset = vertexBase + static_cast<int32_t>(primitive.firstVertex);
+
+                // Indices are relative to the primitive, so anything addressing at most 65536 vertices fits in 16 bits.
+                // The LOD levels index the same vertices, so they go in the same region.
+                primitive.indexType = primitive.vertexCount <= 65536 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+
+                auto pack = [&](uint32_t firstIndex, uint32_t count) {
+                    auto first = model->indices.begin() + firstIndex;
+                    auto last = first + count;
+                    indexCount += count;
+
+                    if (primitive.indexType == VK_INDEX_TYPE_UINT16) {
+                        uint32_t offset = static_cast<uint32_t>(indices16.size());
+                        for (auto it = first; it != last; ++it) indices16.push_back(static_cast<uint16_t>(*it));
+                        return offset;
+                    }
+
+                    uint32_t offset = static_cast<uint32_t>(indices32.size());
+                    indices32.insert(indices32.end(), first, last);
+                    return offset;
+                };
+
+                primitive.indexOffset = pack(primitive.firstIndex, primitive.indexCount);
+                for (Model::Lod& lod : primitive.lods) {
+                    lod.indexOffset = pack(lod.firstIndex, lod.indexCount);
+                }
+            }
+        }
+
         vertices.insert(vertices.end(), model->vertices.begin(), model->vertices.end());
     }
 
@@ -32,27 +68,33 @@ void Adren::Buffers::createModelBuffers(std::vector<Model*>& models, VkCommandPo
     createBuffer(allocator, vertex.size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertex, VMA_MEMORY_USAGE_AUTO);
 
-    copyBuffer(vStaging.buffer, vertex.buffer, vertex.size, commandPool);
-
-    vmaDestroyBuffer(allocator, vStaging.buffer, vStaging.memory);
+    copyBuffer(vStaging, vertex.buffer, vertex.size, commandPool);
 
-    index.size = sizeof(indices[0]) * indices.size();
+    // The index arena holds the 32-bit region first, followed by the 16-bit region aligned to 4 bytes.
+    VkDeviceSize size32 = sizeof(uint32_t) * indices32.size();
+    index16Offset = (size32 + 3) & ~VkDeviceSize(3);
+    index.size = index16Offset + sizeof(uint16_t) * indices16.size();
+    index32Count = indices32.size();
+    index16Count = indices16.size();
 
     Buffer iStaging;
     createBuffer(allocator, index.size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, iStaging, VMA_MEMORY_USAGE_AUTO);
 
     vmaMapMemory(allocator, iStaging.memory, &iStaging.mapped);
-    memcpy(iStaging.mapped, indices.data(), (size_t)index.size);
+    memcpy(iStaging.mapped, indices32.data(), (size_t)size32);
+    memcpy((uint8_t*)iStaging.mapped + index16Offset, indices16.data(), sizeof(uint16_t) * indices16.size());
     vmaUnmapMemory(allocator, iStaging.memory);
 
     createBuffer(allocator, index.size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, index, VMA_MEMORY_USAGE_AUTO);
-    copyBuffer(iStaging.buffer, index.buffer, index.size, commandPool);
-
-    vmaDestroyBuffer(allocator, iStaging.buffer, iStaging.memory);
+    copyBuffer(iStaging, index.buffer, index.size, commandPool);
 
 #ifdef ADREN_DEBUG
+    VkDeviceSize fullSize = sizeof(uint32_t) * indexCount;
+    std::cerr << "-> Index Buffer: " << index.size << " bytes (" << index16Count << " 16-bit, " << index32Count 
+              << " 32-bit indices), saved " << fullSize - index.size << " of " << fullSize << " bytes" << std::endl;
+
     Adren::Debugger::label(instance, device, VK_OBJECT_TYPE_BUFFER, 
                           (uint64_t)vertex.buffer, "VERTEX BUFFER");
     Adren::Debugger::label(instance, device, VK_OBJECT_TYPE_BUFFER, 
@@ -60,14 +102,157 @@ void Adren::Buffers::createModelBuffers(std::vector<Model*>& models, VkCommandPo
 #endif
 }
 
-void Adren::Buffers::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkCommandPool& commandPool) {
+void Adren::Buffers::createMeshletBuffers(std::vector<Model*>& models, VkCommandPool& commandPool) {
+    std::vector<Meshlet> allMeshlets;
+    std::vector<uint32_t> allVertices;
+    std::vector<uint32_t> allTriangles;
+
+    for (Model* model : models) {
+        uint32_t meshletBase = static_cast<uint32_t>(allMeshlets.size());
+
+        for (Meshlet meshlet : model->meshlets) {
+            meshlet.vertexOffset += static_cast<uint32_t>(allVertices.size());
+            meshlet.triangleOffset += static_cast<uint32_t>(allTriangles.size());
+            allMeshlets.push_back(meshlet);
+        }
+
+        for (Model::Mesh& mesh : model->meshes) {
+            for (Model::Primitive& primitive : mesh.primitives) {
+                primitive.meshletOffset = meshletBase + primitive.firstMeshlet;
+                for (Model::Lod& lod : primitive.lods) {
+                    lod.meshletOffset = meshletBase + lod.firstMeshlet;
+                }
+            }
+        }
+
+        allVertices.insert(allVertices.end(), model->meshletVertices.begin(), model->meshletVertices.end());
+        allTriangles.insert(allTriangles.end(), model->meshletTriangles.begin(), model->meshletTriangles.end());
+    }
+
+    // Empty storage buffers are not allowed, so every list gets at least one element.
+    if (allMeshlets.empty()) allMeshlets.push_back(Meshlet{});
+    if (allVertices.empty()) allVertices.push_back(0);
+    if (allTriangles.empty()) allTriangles.push_back(0);
+
+    uploadBuffer(allMeshlets.data(), sizeof(Meshlet) * allMeshlets.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, meshlets, commandPool);
+    uploadBuffer(allVertices.data(), sizeof(uint32_t) * allVertices.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, meshletVertices, commandPool);
+    uploadBuffer(allTriangles.data(), sizeof(uint32_t) * allTriangles.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, meshletTriangles, commandPool);
+
+#ifdef ADREN_DEBUG
+    std::cerr << "-> Meshlet Buffers: " << allMeshlets.size() << " meshlets, " << allTriangles.size() << " triangles" << std::endl;
+
+    Adren::Debugger::label(instance, device, VK_OBJECT_TYPE_BUFFER, (uint64_t)meshlets.buffer, "MESHLET BUFFER");
+    Adren::Debugger::label(instance, device, VK_OBJECT_TYPE_BUFFER, (uint64_t)meshletVertices.buffer, "MESHLET VERTEX BUFFER");
+    Adren::Debugger::label(instance, device, VK_OBJECT_TYPE_BUFFER, (uint64_t)meshletTriangles.buffer, "MESHLET TRIANGLE BUFFER");
+#endif
+}
+
+void Adren::Buffers::destroyMeshletBuffers() {
+    vmaDestroyBuffer(allocator, meshlets.buffer, meshlets.memory);
+    vmaDestroyBuffer(allocator, meshletVertices.buffer, meshletVertices.memory);
+    vmaDestroyBuffer(allocator, meshletTriangles.buffer, meshletTriangles.memory);
+}
+
+void Adren::Buffers::retireSceneBuffers(uint32_t frameCount) {
+    std::vector<Buffer> old = { vertex, index, meshlets, meshletVertices, meshletTriangles, materials };
+
+    deletion.push(frameCount, [allocator = allocator, old, uniform = dynamicUniform]() {
+        for (const Buffer& buffer : old) {
+            vmaDestroyBuffer(allocator, buffer.buffer, buffer.memory);
+        }
+
+        vmaUnmapMemory(allocator, uniform.memory);
+        vmaDestroyBuffer(allocator, uniform.buffer, uniform.memory);
+    });
+
+    // The CPU copy of the matrices isn't read by the GPU, it can go right away.
+    if (uboData.model) Adren::Tools::alignedFree(uboData.model);
+    uboData.model = nullptr;
+}
+
+void Adren::Buffers::createMaterialBuffer(std::vector<Model*>& models, VkCommandPool& commandPool) {
+    std::vector<MaterialData> allMaterials(1);
+
+    for (Model* model : models) {
+        model->materialBase = static_cast<uint32_t>(allMaterials.size());
+
+        auto resolve = [&](int32_t textureIndex, int32_t& slot, int32_t& sampler) {
+            if (textureIndex < 0 || textureIndex >= static_cast<int32_t>(model->textures.size())) return;
+
+            Model::Texture& texture = model->textures[textureIndex];
+            if (texture.index < 0 || texture.index >= static_cast<int32_t>(model->images.size()) || model->textureBase == UINT32_MAX) return;
+
+            slot = static_cast<int32_t>(model->textureBase) + texture.index;
+            sampler = static_cast<int32_t>(texture.samplerIndex);
+        };
+
+        for (Model::Material& material : model->materials) {
+            MaterialData data{};
+            data.baseColorFactor = material.baseColorFactor;
+            data.emissiveFactor = glm::vec4(material.emissiveFactor, 0.0f);
+            data.metallicFactor = material.metallicFactor;
+            data.roughnessFactor = material.roughnessFactor;
+            data.normalScale = material.normalScale;
+            data.occlusionStrength = material.occlusionStrength;
+            data.alphaMode = static_cast<uint32_t>(material.alphaMode);
+            data.alphaCutoff = material.alphaCutoff;
+
+            resolve(material.baseColorTextureIndex, data.textures.x, data.samplers.x);
+            resolve(material.metallicRoughnessTextureIndex, data.textures.y, data.samplers.y);
+            resolve(material.normalTextureIndex, data.textures.z, data.samplers.z);
+            resolve(material.occlusionTextureIndex, data.textures.w, data.samplers.w);
+            resolve(material.emissiveTextureIndex, data.emissiveTexture, data.emissiveSampler);
+            allMaterials.push_back(data);
+        }
+    }
+
+    materialCount = static_cast<uint32_t>(allMaterials.size());
+    uploadBuffer(allMaterials.data(), sizeof(MaterialData) * allMaterials.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, materials, commandPool);
+
+#ifdef ADREN_DEBUG
+    std::cerr << "-> Material Buffer: " << allMaterials.size() << " materials" << std::endl;
+
+    Adren::Debugger::label(instance, device, VK_OBJECT_TYPE_BUFFER, (uint64_t)materials.buffer, "MATERIAL BUFFER");
+#endif
+}
+
+void Adren::Buffers::uploadBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage, Buffer& buffer, VkCommandPool& commandPool) {
+    buffer.size = size;
+
+    Buffer staging;
+    createBuffer(allocator, buffer.size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging, VMA_MEMORY_USAGE_AUTO);
+
+    vmaMapMemory(allocator, staging.memory, &staging.mapped);
+    memcpy(staging.mapped, data, (size_t)size);
+    vmaUnmapMemory(allocator, staging.memory);
+
+    createBuffer(allocator, buffer.size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
+        buffer, VMA_MEMORY_USAGE_AUTO);
+    copyBuffer(staging, buffer.buffer, buffer.size, commandPool);
+}
+
+void Adren::Buffers::copyBuffer(Buffer& staging, VkBuffer dstBuffer, VkDeviceSize size, VkCommandPool& commandPool) {
     VkCommandBuffer commandBuffer = Adren::Tools::beginSingleTimeCommands(device, commandPool);
 
     VkBufferCopy copyRegion{};
     copyRegion.size = size;
-    vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-    Adren::Tools::endSingleTimeCommands(commandBuffer, device, graphicsQueue, commandPool);
+    vkCmdCopyBuffer(commandBuffer, staging.buffer, dstBuffer, 1, &copyRegion);
+
+    // Nothing waits for the copy, the barrier makes the data visible to whatever is submitted after it.
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+        VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+        VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    Adren::Tools::endSingleTimeCommands(commandBuffer, device, graphicsQueue, commandPool, deletion, [allocator = allocator, staging]() {
+        vmaDestroyBuffer(allocator, staging.buffer, staging.memory);
+    });
 }
 
 void Adren::Buffers::createBuffer(VmaAllocator& allocator, VkDeviceSize& size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, Buffer& buffer, VmaMemoryUsage vmaUsage) {
@@ -137,9 +322,12 @@ void Adren::Buffers::updateDynamicUniformBuffer(std::vector<Model*>& models) {
     std::cerr << "-> Model Matrices: " << matrices.size() << std::endl;
 #endif
 
-    VkDeviceSize alignment = dynamicUniform.align * matrices.size();
-    memcpy(dynamicUniform.mapped, matrices.data(), alignment);
-    vmaFlushAllocation(allocator, dynamicUniform.memory, alignment, sizeof(glm::mat4));
+    // Each matrix sits at its own aligned dynamic offset.
+    for (size_t i = 0; i < matrices.size(); i++) {
+        memcpy(static_cast<char*>(dynamicUniform.mapped) + i * dynamicUniform.align, &matrices[i], sizeof(glm::mat4));
+    }
+
+    vmaFlushAllocation(allocator, dynamicUniform.memory, 0, VK_WHOLE_SIZE);
 }
 
 void Adren::Buffers::cleanup() {
@@ -147,6 +335,8 @@ void Adren::Buffers::cleanup() {
 
     vmaDestroyBuffer(allocator, vertex.buffer, vertex.memory);
     vmaDestroyBuffer(allocator, index.buffer, index.memory);
+    destroyMeshletBuffers();
+    vmaDestroyBuffer(allocator, materials.buffer, materials.memory);
 
     vmaUnmapMemory(allocator, dynamicUniform.memory);
     vmaDestroyBuffer(allocator, dynamicUniform.buffer, dynamicUniform.memory);
@@ -10,29 +10,54 @@
 #include "devices.h"
 #include "model.h"
 #include "tools.h"
+#include "deletion.h"
 
 namespace Adren {
 class Buffers {
 public:
-	Buffers(VkInstance& instance, Devices* devices) : device(devices->getDevice()), allocator(devices->getAllocator()),
-		gpu(devices->getGPU()), graphicsQueue(devices->getGraphicsQ()), instance(instance) {}
+	Buffers(VkInstance& instance, Devices* devices, DeletionQueue& deletion) : device(devices->getDevice()), allocator(devices->getAllocator()),
+		gpu(devices->getGPU()), graphicsQueue(devices->getGraphicsQ()), instance(instance), deletion(deletion) {}
 
 	void createModelBuffers(std::vector<Model*>& models, VkCommandPool& commandPool);
+	void createMeshletBuffers(std::vector<Model*>& models, VkCommandPool& commandPool);
+	void destroyMeshletBuffers();
+
+	// Hands the model, meshlet, material and dynamic uniform buffers to deletion for frameCount frames, so a reload can
+	// create new ones while frames in flight still draw with these.
+	void retireSceneBuffers(uint32_t frameCount);
+
+	// Needs the texture slots and sampler indices of models, see Descriptor::allocateTextures and Samplers::assign.
+	void createMaterialBuffer(std::vector<Model*>& models, VkCommandPool& commandPool);
 	void createUniformBuffers(std::vector<VkImage>& images, std::vector<Model*>& models);
 	void updateDynamicUniformBuffer(std::vector<Model*>& models);
 	void createBuffer(VmaAllocator& allocator, VkDeviceSize& size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, Buffer& buffer, VmaMemoryUsage vmaUsage);
+	void uploadBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage, Buffer& buffer, VkCommandPool& commandPool);
 	void cleanup();
 
 	Buffer vertex;
 	Buffer index;
+	VkDeviceSize index16Offset = 0;
+	size_t index32Count = 0;
+	size_t index16Count = 0;
+
+	// Storage buffers with the meshlets of every model, see Model::meshlets.
+	Buffer meshlets;
+	Buffer meshletVertices;
+	Buffer meshletTriangles;
+
+	// The materials of every model after a default one, see MaterialData.
+	Buffer materials;
+	uint32_t materialCount = 0;
 	Buffer dynamicUniform;
 	UboData uboData;
 private:
-	void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkCommandPool& commandPool);
+	// Staging is destroyed once the copy has finished, the caller doesn't wait for it.
+	void copyBuffer(Buffer& staging, VkBuffer dstBuffer, VkDeviceSize size, VkCommandPool& commandPool);
 	VmaAllocator& allocator;
 	VkDevice& device;
 	VkPhysicalDevice& gpu;
 	VkQueue& graphicsQueue;
 	VkInstance& instance;
+	DeletionQueue& deletion;
 };
 }
\ No newline at end of file
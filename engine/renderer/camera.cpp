@@ -60,6 +60,7 @@ void Adren::Camera::create(GLFWwindow* window, Buffers& buffers, VmaAllocator& a
         cam, VMA_MEMORY_USAGE_AUTO);
     vmaMapMemory(allocator, cam.memory, &cam.mapped);
     memcpy(cam.mapped, &camera, cam.size);
+    update();
 }
 
 void Adren::Camera::update() {
@@ -68,9 +69,10 @@ void Adren::Camera::update() {
 
     float screen = (float)width / (float)height;
     uint32_t distance = drawDistance * 1000;
-    camera.proj = glm::perspective(glm::radians((float)fov), screen, 0.0001f, (float)distance);
+    camera.proj = glm::perspective(glm::radians((float)fov), screen, nearPlane, (float)distance);
     camera.proj[1][1] *= -1;
     memcpy(cam.mapped, &camera, sizeof(camera));
+    data = camera;
 }
 
 void Adren::Camera::move(Direction direction) {
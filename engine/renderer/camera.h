@@ -26,6 +26,10 @@ public:
     float speed = 0.5f;
     int fov = 90;
     int drawDistance = 10;
+    float nearPlane = 0.0001f;
+
+    // The matrices last written to the camera buffer.
+    CameraObject data{};
 	static void callback(GLFWwindow* window, double xpos, double ypos);
 
     // This puts default position of the mouse at the center of the window
@@ -0,0 +1,192 @@
+/*
+    cook.cpp
+    Adrenaline Engine
+
+    Definitions for cooked textures.
+*/
+
+#include "cook.h"
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+const uint32_t magic = 0x58544441; // "ADTX"
+const uint32_t maxLevels = 16;
+const uint64_t dataAlignment = 16;
+
+struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levelCount;
+    uint64_t dataOffset;
+    uint64_t dataSize;
+    float psnr;
+    uint32_t padding;
+};
+
+static_assert(sizeof(Header) == 56, "Cooked texture headers are read straight from the file.");
+}
+
+uint64_t Adren::Cook::hash(const void* data, size_t size, uint64_t seed) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t result = seed;
+    for (size_t i = 0; i < size; i++) {
+        result ^= bytes[i];
+        result *= 1099511628211ull;
+    }
+
+    return result;
+}
+
+Adren::Cook::File::~File() {
+    close();
+}
+
+void Adren::Cook::File::close() {
+    if (bytes == nullptr) return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(bytes);
+#else
+    munmap(const_cast<uint8_t*>(bytes), length);
+#endif
+
+    bytes = nullptr;
+    length = 0;
+}
+
+bool Adren::Cook::File::open(const std::filesystem::path& path) {
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize{};
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    // The view keeps the file open after both handles are closed.
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr) return false;
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (view == nullptr) return false;
+
+    bytes = static_cast<const uint8_t*>(view);
+    length = static_cast<size_t>(fileSize.QuadPart);
+#else
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) return false;
+
+    struct stat info{};
+    if (fstat(file, &info) != 0 || info.st_size == 0) {
+        ::close(file);
+        return false;
+    }
+
+    void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+    ::close(file);
+    if (view == MAP_FAILED) return false;
+
+    bytes = static_cast<const uint8_t*>(view);
+    length = static_cast<size_t>(info.st_size);
+#endif
+
+    return true;
+}
+
+bool Adren::Cook::read(const File& file, uint64_t key, Texture& texture) {
+    if (file.data() == nullptr || file.size() < sizeof(Header)) return false;
+
+    Header header;
+    memcpy(&header, file.data(), sizeof(Header));
+
+    if (header.magic != magic || header.version != version || header.key != key) return false;
+    if (header.levelCount == 0 || header.levelCount > maxLevels || header.width == 0 || header.height == 0) return false;
+
+    uint64_t tableEnd = sizeof(Header) + header.levelCount * sizeof(uint64_t);
+    if (header.dataOffset < tableEnd || header.dataOffset > file.size() || header.dataSize > file.size() - header.dataOffset) return false;
+
+    texture.levels.resize(header.levelCount);
+    for (uint32_t level = 0; level < header.levelCount; level++) {
+        uint64_t offset;
+        memcpy(&offset, file.data() + sizeof(Header) + level * sizeof(uint64_t), sizeof(offset));
+        if (offset >= header.dataSize) return false;
+        texture.levels[level] = offset;
+    }
+
+    texture.format = static_cast<VkFormat>(header.format);
+    texture.width = header.width;
+    texture.height = header.height;
+    texture.data = file.data() + header.dataOffset;
+    texture.size = static_cast<size_t>(header.dataSize);
+    texture.psnr = header.psnr;
+    return true;
+}
+
+bool Adren::Cook::write(const std::filesystem::path& path, uint64_t key, const Model::glTFImage& image) {
+    if (image.pixels.empty() || image.levels.empty() || image.levels.size() > maxLevels) return false;
+
+    Header header{};
+    header.magic = magic;
+    header.version = version;
+    header.key = key;
+    header.format = static_cast<uint32_t>(image.format);
+    header.width = static_cast<uint32_t>(image.width);
+    header.height = static_cast<uint32_t>(image.height);
+    header.levelCount = static_cast<uint32_t>(image.levels.size());
+    header.dataSize = image.pixels.size();
+    header.psnr = image.psnr;
+
+    // Level data starts aligned, so the offsets stay valid for any texel block size once staged.
+    uint64_t tableEnd = sizeof(Header) + header.levelCount * sizeof(uint64_t);
+    header.dataOffset = (tableEnd + dataAlignment - 1) & ~(dataAlignment - 1);
+
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+
+    std::filesystem::path temporary = path;
+    temporary += ".tmp";
+
+    {
+        std::ofstream stream(temporary, std::ios::binary | std::ios::trunc);
+        if (!stream.is_open()) return false;
+
+        std::vector<uint64_t> levels(image.levels.begin(), image.levels.end());
+        const char zeros[dataAlignment] = {};
+
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        stream.write(reinterpret_cast<const char*>(levels.data()), levels.size() * sizeof(uint64_t));
+        stream.write(zeros, static_cast<std::streamsize>(header.dataOffset - tableEnd));
+        stream.write(reinterpret_cast<const char*>(image.pixels.data()), image.pixels.size());
+        if (!stream.good()) return false;
+    }
+
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+
+    return true;
+}
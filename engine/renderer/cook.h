@@ -0,0 +1,53 @@
+/*
+	cook.h
+	Adrenaline Engine
+
+	This reads and writes cooked textures, images stored in the format and mip levels the GPU samples.
+	A cooked file is a header, the offset of every level and the level data, laid out for VkBufferImageCopy.
+*/
+
+#pragma once
+#include "model.h"
+#include <filesystem>
+
+namespace Adren::Cook {
+	// Bumped whenever the layout or the encoders change, so older files stop matching.
+	static const uint32_t version = 1;
+
+	// 64-bit FNV-1a, pass the result back in as seed to hash several ranges.
+	uint64_t hash(const void* data, size_t size, uint64_t seed = 14695981039346656037ull);
+
+	// A read only memory mapping of a whole file.
+	class File {
+	public:
+		File() = default;
+		File(const File&) = delete;
+		File& operator=(const File&) = delete;
+		~File();
+
+		// Opening again closes the file mapped before.
+		bool open(const std::filesystem::path& path);
+		void close();
+		const uint8_t* data() const { return bytes; }
+		size_t size() const { return length; }
+	private:
+		const uint8_t* bytes = nullptr;
+		size_t length = 0;
+	};
+
+	struct Texture {
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<VkDeviceSize> levels; // Offset of every mip level in data, largest first.
+		const uint8_t* data = nullptr;     // Points into the mapped file.
+		size_t size = 0;
+		float psnr = 0.0f;
+	};
+
+	// Fails when the file is not a cooked texture of this version for key.
+	bool read(const File& file, uint64_t key, Texture& texture);
+
+	// Writes through a temporary file, so an interrupted write never leaves a broken texture behind.
+	bool write(const std::filesystem::path& path, uint64_t key, const Model::glTFImage& image);
+}
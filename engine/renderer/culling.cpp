@@ -0,0 +1,681 @@
+/*
+    culling.cpp
+    Adrenaline Engine
+
+    This has the definitions of culling.h
+*/
+
+#include "culling.h"
+#include "info.h"
+#include <functional>
+#include <algorithm>
+#include <memory>
+
+#ifdef ADREN_DEBUG
+#include "debugger.h"
+#endif
+
+void Adren::Culling::reload(const std::string& name, Pipeline& pipeline, HotReload& hotReload, DeletionQueue& deletion, uint32_t frameCount) {
+    VkPipeline* target = nullptr;
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    if (name == "cull.spv") {
+        target = &cullPipeline;
+        layout = cullLayout;
+    } else if (name == "hzb.spv") {
+        target = &reducePipeline;
+        layout = reduceLayout;
+    } else {
+        return;
+    }
+
+    std::string path = "../engine/resources/shaders/" + name;
+    auto built = std::make_shared<VkPipeline>(VK_NULL_HANDLE);
+    hotReload.run([&pipeline, built, path, layout]() { *built = pipeline.rebuildCompute(path, layout); },
+        [this, built, target, &deletion, frameCount]() {
+            if (*built == VK_NULL_HANDLE) return;
+
+            // Frames in flight dispatched the old pipeline, it goes once they have finished.
+            deletion.push(frameCount, [device = device, old = *target]() { vkDestroyPipeline(device, old, nullptr); });
+            *target = *built;
+        });
+}
+
+void Adren::Culling::create(Pipeline& pipeline, size_t frameCount) {
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+#ifdef ADREN_DEBUG
+    Adren::Debugger::vibeCheck("CULLING SAMPLER", vkCreateSampler(device, &samplerInfo, nullptr, &sampler));
+#else
+    vkCreateSampler(device, &samplerInfo, nullptr, &sampler);
+#endif
+
+    // The culling set has the per frame data, the draws, the meshlets, the outputs, the depth pyramid and the LODs.
+    // Both layouts are reflected from the shaders.
+    cullPipeline = pipeline.createCompute("../engine/resources/shaders/cull.spv", cullLayout, cullSetLayout);
+    reducePipeline = pipeline.createCompute("../engine/resources/shaders/hzb.spv", reduceLayout, reduceSetLayout);
+
+    uint32_t setCount = static_cast<uint32_t>(frameCount);
+    std::array<VkDescriptorPoolSize, 3> poolSizes{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER; poolSizes[0].descriptorCount = setCount;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER; poolSizes[1].descriptorCount = setCount * 9;
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER; poolSizes[2].descriptorCount = setCount;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = setCount;
+
+#ifdef ADREN_DEBUG
+    Adren::Debugger::vibeCheck("CULLING DESCRIPTOR POOL", vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool));
+#else
+    vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool);
+#endif
+
+    frames.resize(frameCount);
+    std::vector<VkDescriptorSetLayout> layouts(frameCount, cullSetLayout);
+    std::vector<VkDescriptorSet> sets(frameCount);
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = pool;
+    allocInfo.descriptorSetCount = setCount;
+    allocInfo.pSetLayouts = layouts.data();
+    Adren::Debugger::vibeCheck("ALLOCATED CULLING SETS", vkAllocateDescriptorSets(device, &allocInfo, sets.data()));
+
+    for (size_t i = 0; i < frames.size(); i++) {
+        FrameData& frame = frames[i];
+        frame.set = sets[i];
+
+        frame.data.size = sizeof(CullData);
+        buffers.createBuffer(allocator, frame.data.size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, frame.data, VMA_MEMORY_USAGE_AUTO);
+        vmaMapMemory(allocator, frame.data.memory, &frame.data.mapped);
+
+        // The statistics are read back on the CPU once the fence of the frame has been waited on.
+        frame.stats.size = sizeof(CullStats);
+        buffers.createBuffer(allocator, frame.stats.size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, frame.stats, VMA_MEMORY_USAGE_AUTO_PREFER_HOST);
+        vmaMapMemory(allocator, frame.stats.memory, &frame.stats.mapped);
+        memset(frame.stats.mapped, 0, sizeof(CullStats));
+
+#ifdef ADREN_DEBUG
+        Adren::Debugger::label(instance, device, VK_OBJECT_TYPE_BUFFER, (uint64_t)frame.data.buffer, "CULLING DATA BUFFER");
+        Adren::Debugger::label(instance, device, VK_OBJECT_TYPE_BUFFER, (uint64_t)frame.stats.buffer, "CULLING STATS BUFFER");
+#endif
+    }
+}
+
+void Adren::Culling::build(std::vector<Model*>& models, VkCommandPool& commandPool, VkDeviceSize dynamicAlign) {
+    std::vector<CullDraw> cullDraws;
+    std::vector<glm::uvec2> cullJobs;
+    std::vector<VkDrawIndexedIndirectCommand> commands;
+    drawInfos.clear();
+    lodDraws.clear();
+    for (auto& bucket : buckets) bucket.clear();
+    clusterCount = 0;
+    triangleCount = 0;
+
+    uint32_t matrixBase = 0;
+    uint32_t indexTotal = 0;     // In the 32-bit region.
+    uint32_t halfIndexTotal = 0; // In the 16-bit region, always even.
+
+    for (Model* model : models) {
+        uint32_t local = 0;
+
+        // Nodes are walked in the same order as Model::countMatrices so they find their matrix.
+        std::function<void(size_t)> walk = [&](size_t nodeIndex) {
+            auto& node = model->gltfModel.nodes[nodeIndex];
+            uint32_t matrixIndex = matrixBase + local;
+            glm::mat4 matrix = model->matrices[local++];
+
+            if (node.meshIndex.has_value() && node.meshIndex.value() < model->meshes.size()) {
+                glm::vec3 axes = glm::vec3(glm::length(glm::vec3(matrix[0])), glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2])));
+                float scale = glm::max(axes.x, glm::max(axes.y, axes.z));
+                bool uniform = scale - glm::min(axes.x, glm::min(axes.y, axes.z)) <= scale * 1e-3f;
+
+                for (Model::Primitive& primitive : model->meshes[node.meshIndex.value()].primitives) {
+                    if (primitive.meshletCount == 0) continue;
+
+                    uint32_t drawIndex = static_cast<uint32_t>(cullDraws.size());
+                    const Model::Material& material = model->materialOf(primitive);
+
+                    // Back facing clusters of double sided materials are still visible.
+                    CullDraw draw{};
+                    draw.model = matrix;
+                    draw.coneCulling = uniform && !material.doubleSided && glm::determinant(glm::mat3(matrix)) > 0.0f;
+                    draw.scale = scale;
+                    draw.halfIndices = primitive.indexType == VK_INDEX_TYPE_UINT16;
+                    cullDraws.push_back(draw);
+
+                    LodDraw lodDraw{};
+                    lodDraw.center = glm::vec3(matrix * glm::vec4(glm::vec3(primitive.sphere), 1.0f));
+                    lodDraw.radius = primitive.sphere.w * scale;
+                    lodDraw.levels.push_back({ 0.0f, primitive.meshletOffset, primitive.meshletCount, primitive.indexCount / 3 });
+                    for (Model::Lod& lod : primitive.lods) {
+                        lodDraw.levels.push_back({ lod.error * scale, lod.meshletOffset, lod.meshletCount, lod.indexCount / 3 });
+                    }
+
+                    DrawInfo info{};
+                    info.constants.dequant = primitive.dequant;
+                    info.constants.materialIndex = model->materialIndex(primitive);
+                    info.dynamicOffset = static_cast<uint32_t>(matrixIndex * dynamicAlign);
+                    info.key = model->pipelineKey(primitive);
+                    info.indexType = draw.halfIndices ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+                    buckets[static_cast<uint32_t>(material.alphaMode)].push_back(drawIndex);
+                    drawInfos.push_back(info);
+
+                    // Every draw owns a range as large as its full index list, the pass fills it from the start.
+                    // 16-bit ranges also hold the degenerate triangle each meshlet with an odd count adds.
+                    if (draw.halfIndices) {
+                        uint32_t capacity = 0;
+                        for (LodLevel& level : lodDraw.levels) {
+                            capacity = std::max(capacity, (level.triangleCount + level.meshletCount) * 3);
+                        }
+
+                        commands.push_back({ 0, 1, halfIndexTotal, primitive.vertexOffset, 0 });
+                        halfIndexTotal += (capacity + 1) & ~1u;
+                    } else {
+                        commands.push_back({ 0, 1, indexTotal, primitive.vertexOffset, 0 });
+                        indexTotal += primitive.indexCount;
+                    }
+
+                    // There are enough jobs for the level with the most meshlets, the rest exit early.
+                    uint32_t jobsNeeded = 0;
+                    for (LodLevel& level : lodDraw.levels) {
+                        jobsNeeded = std::max(jobsNeeded, level.meshletCount);
+                    }
+
+                    for (uint32_t m = 0; m < jobsNeeded; m++) {
+                        cullJobs.push_back(glm::uvec2(drawIndex, m));
+                    }
+
+                    clusterCount += primitive.meshletCount;
+                    triangleCount += primitive.indexCount / 3;
+                    lodDraws.push_back(lodDraw);
+                }
+            }
+
+            for (auto& child : node.children) {
+                walk(child);
+            }
+        };
+
+        for (auto& scene : model->gltfModel.scenes) {
+            for (auto& node : scene.nodeIndices) {
+                walk(node);
+            }
+        }
+
+        matrixBase += static_cast<uint32_t>(model->matrices.size());
+    }
+
+    jobCount = static_cast<uint32_t>(cullJobs.size());
+
+    // The 16-bit region follows the 32-bit one, its draws count their first index from there.
+    halfIndexOffset = sizeof(uint32_t) * indexTotal;
+    for (CullDraw& draw : cullDraws) {
+        if (draw.halfIndices) draw.indexBase = indexTotal;
+    }
+
+    for (size_t b = 0; b < 2; b++) {
+        std::stable_sort(buckets[b].begin(), buckets[b].end(), [&](uint32_t x, uint32_t y) {
+            return drawInfos[x].key.bits() < drawInfos[y].key.bits();
+        });
+    }
+
+    // Empty storage buffers are not allowed, so every list gets at least one element.
+    if (cullDraws.empty()) cullDraws.push_back(CullDraw{});
+    if (cullJobs.empty()) cullJobs.push_back(glm::uvec2(0));
+    if (commands.empty()) commands.push_back(VkDrawIndexedIndirectCommand{});
+
+    buffers.uploadBuffer(cullDraws.data(), sizeof(CullDraw) * cullDraws.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, draws, commandPool);
+    buffers.uploadBuffer(cullJobs.data(), sizeof(glm::uvec2) * cullJobs.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, jobs, commandPool);
+    buffers.uploadBuffer(commands.data(), sizeof(VkDrawIndexedIndirectCommand) * commands.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        commandTemplate, commandPool);
+
+    for (FrameData& frame : frames) {
+        frame.commands.size = commandTemplate.size;
+        buffers.createBuffer(allocator, frame.commands.size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.commands, VMA_MEMORY_USAGE_AUTO);
+
+        frame.indices.size = std::max<VkDeviceSize>(halfIndexOffset + sizeof(uint16_t) * halfIndexTotal, sizeof(uint32_t));
+        buffers.createBuffer(allocator, frame.indices.size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.indices, VMA_MEMORY_USAGE_AUTO);
+
+        // The LODs are picked on the CPU every frame, so they live in mapped memory like the culling data.
+        frame.lods.size = sizeof(CullLod) * cullDraws.size();
+        buffers.createBuffer(allocator, frame.lods.size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, frame.lods, VMA_MEMORY_USAGE_AUTO);
+        vmaMapMemory(allocator, frame.lods.memory, &frame.lods.mapped);
+        memset(frame.lods.mapped, 0, frame.lods.size);
+
+        // Frames in flight still read the sets, each one is pointed at the new buffers when dispatch reaches it.
+        frame.stale = true;
+    }
+
+#ifdef ADREN_DEBUG
+    std::cerr << "-> Culling Draws: " << drawInfos.size() << ", Clusters: " << clusterCount << ", Compacted Indices: "
+              << frames.size() << " x " << frames.front().indices.size << " bytes" << std::endl;
+#endif
+}
+
+void Adren::Culling::retireDraws(uint32_t frameCount) {
+    std::vector<Buffer> old = { draws, jobs, commandTemplate };
+    std::vector<Buffer> mapped;
+    for (FrameData& frame : frames) {
+        old.push_back(frame.commands);
+        old.push_back(frame.indices);
+        mapped.push_back(frame.lods);
+    }
+
+    deletion.push(frameCount, [allocator = allocator, old, mapped]() {
+        for (const Buffer& buffer : mapped) {
+            vmaUnmapMemory(allocator, buffer.memory);
+            vmaDestroyBuffer(allocator, buffer.buffer, buffer.memory);
+        }
+
+        for (const Buffer& buffer : old) {
+            vmaDestroyBuffer(allocator, buffer.buffer, buffer.memory);
+        }
+    });
+
+    drawInfos.clear();
+    lodDraws.clear();
+    jobCount = 0;
+}
+
+void Adren::Culling::resize(const std::vector<VkImageView>& views, VkExtent2D extent, VkCommandPool& commandPool, uint32_t frameCount) {
+    retirePyramid(frameCount);
+    depthViews = views;
+    depthExtent = extent;
+    createPyramid(extent, commandPool);
+    for (FrameData& frame : frames) frame.stale = true;
+}
+
+void Adren::Culling::createPyramid(VkExtent2D extent, VkCommandPool& commandPool) {
+    // The pyramid starts at the power of two below the viewport so every level is exactly half the last.
+    auto previousPow2 = [](uint32_t value) {
+        uint32_t result = 1;
+        while (result * 2 <= value) result *= 2;
+        return result;
+    };
+
+    pyramidExtent = { previousPow2(extent.width), previousPow2(extent.height) };
+    pyramidLevels = 1;
+    while ((std::max(pyramidExtent.width, pyramidExtent.height) >> pyramidLevels) > 0) pyramidLevels++;
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent = { pyramidExtent.width, pyramidExtent.height, 1 };
+    imageInfo.mipLevels = pyramidLevels;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = VK_FORMAT_R32_SFLOAT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo allocInfo{};
+    allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+    allocInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+    vmaCreateImage(allocator, &imageInfo, &allocInfo, &pyramid.image, &pyramid.memory, nullptr);
+    pyramid.format = imageInfo.format;
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = pyramid.image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = pyramid.format;
+    viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, pyramidLevels, 0, 1 };
+    vkCreateImageView(device, &viewInfo, nullptr, &pyramid.view);
+
+    pyramidMips.resize(pyramidLevels);
+    for (uint32_t level = 0; level < pyramidLevels; level++) {
+        viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+        vkCreateImageView(device, &viewInfo, nullptr, &pyramidMips[level]);
+    }
+
+    // The pyramid stays in the general layout, it is written and read by compute shaders only.
+    VkCommandBuffer commandBuffer = Adren::Tools::beginSingleTimeCommands(device, commandPool);
+
+    VkImageMemoryBarrier imageBarrier{};
+    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.image = pyramid.image;
+    imageBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, pyramidLevels, 0, 1 };
+    imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+    Adren::Tools::endSingleTimeCommands(commandBuffer, device, graphicsQueue, commandPool, deletion);
+
+    // Every frame in flight has its own chain of sets, they only differ in the depth the first level reads.
+    uint32_t setCount = pyramidLevels * static_cast<uint32_t>(depthViews.size());
+    VkDescriptorPoolSize poolSizes[2] = {
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, setCount },
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, setCount }
+    };
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    poolInfo.maxSets = setCount;
+
+#ifdef ADREN_DEBUG
+    Adren::Debugger::vibeCheck("PYRAMID DESCRIPTOR POOL", vkCreateDescriptorPool(device, &poolInfo, nullptr, &reducePool));
+#else
+    vkCreateDescriptorPool(device, &poolInfo, nullptr, &reducePool);
+#endif
+
+    std::vector<VkDescriptorSetLayout> layouts(pyramidLevels, reduceSetLayout);
+    reduceSets.assign(depthViews.size(), std::vector<VkDescriptorSet>(pyramidLevels));
+
+    for (size_t frame = 0; frame < depthViews.size(); frame++) {
+        VkDescriptorSetAllocateInfo setInfo{};
+        setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        setInfo.descriptorPool = reducePool;
+        setInfo.descriptorSetCount = pyramidLevels;
+        setInfo.pSetLayouts = layouts.data();
+        Adren::Debugger::vibeCheck("ALLOCATED PYRAMID SETS", vkAllocateDescriptorSets(device, &setInfo, reduceSets[frame].data()));
+
+        // Level 0 reads the viewport depth of the frame, every other level reads the one above it.
+        for (uint32_t level = 0; level < pyramidLevels; level++) {
+            VkDescriptorImageInfo source{};
+            source.sampler = sampler;
+            source.imageView = level == 0 ? depthViews[frame] : pyramidMips[level - 1];
+            source.imageLayout = level == 0 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+            VkDescriptorImageInfo target{};
+            target.imageView = pyramidMips[level];
+            target.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+            std::array<VkWriteDescriptorSet, 2> writes{};
+            writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[0].dstSet = reduceSets[frame][level];
+            writes[0].dstBinding = 0;
+            writes[0].descriptorCount = 1;
+            writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            writes[0].pImageInfo = &source;
+
+            writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[1].dstSet = reduceSets[frame][level];
+            writes[1].dstBinding = 1;
+            writes[1].descriptorCount = 1;
+            writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            writes[1].pImageInfo = &target;
+
+            vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+        }
+    }
+
+#ifdef ADREN_DEBUG
+    Adren::Debugger::label(instance, device, VK_OBJECT_TYPE_IMAGE, (uint64_t)pyramid.image, "DEPTH PYRAMID");
+    std::cerr << "-> Depth Pyramid: " << pyramidExtent.width << "x" << pyramidExtent.height << ", " << pyramidLevels << " levels" << std::endl;
+#endif
+}
+
+void Adren::Culling::writeSet(FrameData& frame) {
+    std::array<VkDescriptorBufferInfo, 10> bufferInfos{};
+    bufferInfos[0] = { frame.data.buffer, 0, VK_WHOLE_SIZE };
+    bufferInfos[1] = { draws.buffer, 0, VK_WHOLE_SIZE };
+    bufferInfos[2] = { jobs.buffer, 0, VK_WHOLE_SIZE };
+    bufferInfos[3] = { buffers.meshlets.buffer, 0, VK_WHOLE_SIZE };
+    bufferInfos[4] = { buffers.meshletVertices.buffer, 0, VK_WHOLE_SIZE };
+    bufferInfos[5] = { buffers.meshletTriangles.buffer, 0, VK_WHOLE_SIZE };
+    bufferInfos[6] = { frame.commands.buffer, 0, VK_WHOLE_SIZE };
+    bufferInfos[7] = { frame.indices.buffer, 0, VK_WHOLE_SIZE };
+    bufferInfos[8] = { frame.stats.buffer, 0, VK_WHOLE_SIZE };
+    bufferInfos[9] = { frame.lods.buffer, 0, VK_WHOLE_SIZE };
+
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.sampler = sampler;
+    imageInfo.imageView = pyramid.view;
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    std::array<VkWriteDescriptorSet, 11> writes{};
+    for (uint32_t b = 0; b < bufferInfos.size(); b++) {
+        writes[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[b].dstSet = frame.set;
+        writes[b].dstBinding = b < 9 ? b : 10;
+        writes[b].descriptorCount = 1;
+        writes[b].descriptorType = b == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[b].pBufferInfo = &bufferInfos[b];
+    }
+
+    // Binding 9 is the depth pyramid.
+    writes[10].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[10].dstSet = frame.set;
+    writes[10].dstBinding = 9;
+    writes[10].descriptorCount = 1;
+    writes[10].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    writes[10].pImageInfo = &imageInfo;
+
+    // Without a pyramid yet only the buffers are written, resize marks the set again.
+    uint32_t count = pyramidLevels > 0 ? 11 : 10;
+    vkUpdateDescriptorSets(device, count, writes.data(), 0, nullptr);
+    frame.stale = false;
+}
+
+void Adren::Culling::retirePyramid(uint32_t frameCount) {
+    if (pyramidLevels == 0) return;
+
+    // The reduce sets belong to reducePool, destroying the pool frees them.
+    deletion.push(frameCount, [device = device, allocator = allocator, image = pyramid, mips = pyramidMips, pool = reducePool]() {
+        for (VkImageView view : mips) {
+            vkDestroyImageView(device, view, nullptr);
+        }
+
+        vkDestroyImageView(device, image.view, nullptr);
+        vmaDestroyImage(allocator, image.image, image.memory);
+        vkDestroyDescriptorPool(device, pool, nullptr);
+    });
+
+    pyramidMips.clear();
+    reduceSets.clear();
+    pyramid = {};
+    reducePool = VK_NULL_HANDLE;
+    pyramidLevels = 0;
+    pyramidValid = false;
+}
+
+void Adren::Culling::barrier(VkCommandBuffer& commandBuffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+    VkMemoryBarrier memoryBarrier{};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.srcAccessMask = srcAccess;
+    memoryBarrier.dstAccessMask = dstAccess;
+
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
+
+void Adren::Culling::readStats(size_t frame) {
+    memcpy(&stats, frames[frame].stats.mapped, sizeof(CullStats));
+}
+
+void Adren::Culling::dispatch(VkCommandBuffer& commandBuffer, size_t frame, Camera& camera) {
+    FrameData& current = frames[frame];
+    if (current.stale) writeSet(current);
+
+    float P00 = camera.data.proj[0][0];
+    float P11 = glm::abs(camera.data.proj[1][1]);
+
+    CullData data{};
+    data.view = camera.data.view;
+    data.prevView = pyramidView;
+    data.frustum = glm::vec4(P00, 1.0f, P11, 1.0f) / glm::vec4(glm::sqrt(P00 * P00 + 1.0f), glm::sqrt(P00 * P00 + 1.0f),
+                                                                glm::sqrt(P11 * P11 + 1.0f), glm::sqrt(P11 * P11 + 1.0f));
+    data.projection = glm::vec4(P00, P11, camera.nearPlane, (float)camera.drawDistance * 1000.0f);
+    data.prevProjection = pyramidProjection;
+    data.pyramidSize = glm::vec2(pyramidExtent.width, pyramidExtent.height);
+    data.jobCount = jobCount;
+    data.flags = (frustumCulling ? 1 : 0) | (occlusionCulling && pyramidValid ? 2 : 0) | (coneCulling ? 4 : 0);
+    memcpy(current.data.mapped, &data, sizeof(data));
+
+    selectLods(current, camera);
+
+    VkBufferCopy copy{ 0, 0, commandTemplate.size };
+    vkCmdCopyBuffer(commandBuffer, commandTemplate.buffer, current.commands.buffer, 1, &copy);
+    vkCmdFillBuffer(commandBuffer, current.stats.buffer, 0, VK_WHOLE_SIZE, 0);
+
+    barrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    if (jobCount > 0) {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullLayout, 0, 1, &current.set, 0, nullptr);
+        vkCmdDispatch(commandBuffer, (jobCount + 63) / 64, 1, 1);
+    }
+
+    barrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+        VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_HOST_READ_BIT);
+}
+
+void Adren::Culling::selectLods(FrameData& frame, Camera& camera) {
+    lodStats = LodStats{};
+    if (lodDraws.empty()) return;
+
+    // Pixels covered by one world unit at a distance of one, from the vertical field of view of the camera.
+    float height = static_cast<float>(depthExtent.height);
+    float pixelScale = height / (2.0f * glm::tan(glm::radians(static_cast<float>(camera.fov)) * 0.5f));
+    float threshold = lodThreshold * glm::exp2(lodBias);
+    float relaxed = threshold * (1.0f - lodHysteresis);
+
+    CullLod* lods = static_cast<CullLod*>(frame.lods.mapped);
+
+    for (size_t i = 0; i < lodDraws.size(); i++) {
+        LodDraw& draw = lodDraws[i];
+        float distance = glm::distance(camera.pos, draw.center);
+        uint32_t level = 0;
+
+        // A camera inside the bounds always gets the full detail level.
+        if (height > 0.0f && distance > draw.radius) {
+            if (contributionCulling && draw.radius * pixelScale / distance < contributionPixels) {
+                lods[i] = { 0, 0 };
+                lodStats.contributionCulled++;
+                lodStats.contributionTriangles += draw.levels[0].triangleCount;
+                continue;
+            }
+
+            if (lodSelection) {
+                // The error is projected at the nearest point of the bounds, errors only grow with the level.
+                float pixels = pixelScale / (distance - draw.radius);
+                auto coarsest = [&](uint32_t from, float limit) {
+                    while (from + 1 < draw.levels.size() && draw.levels[from + 1].error * pixels <= limit) from++;
+                    return from;
+                };
+
+                // Going finer happens right away, going coarser needs the next level to be well under the threshold.
+                level = coarsest(0, threshold);
+                if (level > draw.level) {
+                    level = coarsest(draw.level, relaxed);
+                }
+            }
+        }
+
+        draw.level = level;
+        lods[i] = { draw.levels[level].meshletOffset, draw.levels[level].meshletCount };
+        lodStats.trianglesSaved += draw.levels[0].triangleCount - draw.levels[level].triangleCount;
+        lodStats.levels[std::min<size_t>(level, lodStats.levels.size() - 1)]++;
+    }
+}
+
+void Adren::Culling::draw(VkCommandBuffer& commandBuffer, size_t frame, Pipeline& pipeline, VkDescriptorSet& set, Camera& camera) {
+    if (drawInfos.empty()) return;
+
+    FrameData& current = frames[frame];
+
+    // Blended draws have no depth to hide behind, the farthest goes first. Commands stay where build put them.
+    std::vector<uint32_t>& blended = buckets[2];
+    std::sort(blended.begin(), blended.end(), [&](uint32_t x, uint32_t y) {
+        return glm::distance(camera.pos, lodDraws[x].center) > glm::distance(camera.pos, lodDraws[y].center);
+    });
+
+    // Pipelines are only looked up when the key changes, keys missing from the cache are created here.
+    // The index buffer is rebound when the draw switches between the 32-bit and the 16-bit region.
+    bool bound = false;
+    PipelineKey boundKey{};
+    VkIndexType boundType = VK_INDEX_TYPE_MAX_ENUM;
+    for (std::vector<uint32_t>& bucket : buckets) {
+        for (uint32_t i : bucket) {
+            DrawInfo& info = drawInfos[i];
+            if (!bound || !(info.key == boundKey)) {
+                bound = true;
+                boundKey = info.key;
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.get(info.key));
+            }
+
+            if (info.indexType != boundType) {
+                boundType = info.indexType;
+                VkDeviceSize offset = boundType == VK_INDEX_TYPE_UINT16 ? halfIndexOffset : 0;
+                vkCmdBindIndexBuffer(commandBuffer, current.indices.buffer, offset, boundType);
+            }
+
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout, 0, 1, &set, 1, &info.dynamicOffset);
+            vkCmdPushConstants(commandBuffer, pipeline.layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstant), &info.constants);
+            vkCmdDrawIndexedIndirect(commandBuffer, current.commands.buffer, i * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+        }
+    }
+}
+
+void Adren::Culling::buildPyramid(VkCommandBuffer& commandBuffer, size_t frame, Camera& camera) {
+    if (pyramidLevels == 0) return;
+
+    // The culling pass of this frame has to finish reading the pyramid before it is overwritten.
+    barrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, reducePipeline);
+
+    glm::ivec2 inSize = glm::ivec2(depthExtent.width, depthExtent.height);
+    for (uint32_t level = 0; level < pyramidLevels; level++) {
+        glm::ivec2 outSize = glm::max(glm::ivec2(pyramidExtent.width >> level, pyramidExtent.height >> level), glm::ivec2(1));
+        glm::ivec4 sizes = glm::ivec4(inSize, outSize);
+
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, reduceLayout, 0, 1, &reduceSets[frame][level], 0, nullptr);
+        vkCmdPushConstants(commandBuffer, reduceLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(sizes), &sizes);
+        vkCmdDispatch(commandBuffer, (outSize.x + 7) / 8, (outSize.y + 7) / 8, 1);
+
+        barrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+        inSize = outSize;
+    }
+
+    // The next frame tests against this depth, so it also needs the matrices it was rendered with.
+    pyramidValid = true;
+    pyramidView = camera.data.view;
+    pyramidProjection = glm::vec4(camera.data.proj[0][0], glm::abs(camera.data.proj[1][1]), camera.data.proj[2][2], camera.data.proj[3][2]);
+}
+
+void Adren::Culling::cleanup() {
+    // Nothing is in flight anymore, the renderer flushes the deletion queue right after.
+    retireDraws(0);
+    retirePyramid(0);
+
+    for (FrameData& frame : frames) {
+        vmaUnmapMemory(allocator, frame.data.memory);
+        vmaDestroyBuffer(allocator, frame.data.buffer, frame.data.memory);
+        vmaUnmapMemory(allocator, frame.stats.memory);
+        vmaDestroyBuffer(allocator, frame.stats.buffer, frame.stats.memory);
+    }
+
+    vkDestroyPipeline(device, cullPipeline, nullptr);
+    vkDestroyPipeline(device, reducePipeline, nullptr);
+    vkDestroyDescriptorPool(device, pool, nullptr);
+    vkDestroySampler(device, sampler, nullptr);
+}
@@ -0,0 +1,149 @@
+/*
+	culling.h
+	Adrenaline Engine
+
+	This handles the compute pass that culls meshlets before the viewport is drawn.
+	Visible meshlets are compacted into a per frame index buffer that is drawn indirectly. Primitives with 16-bit
+	indices are compacted into a 16-bit region after the 32-bit one.
+	Before the pass every draw picks the coarsest LOD whose error on screen is under a threshold.
+*/
+
+#pragma once
+#include "buffers.h"
+#include "pipeline.h"
+#include "camera.h"
+#include "simplify.h"
+
+namespace Adren {
+class Culling {
+public:
+	Culling(VkInstance& instance, Devices* devices, Buffers& buffers, DeletionQueue& deletion) : device(devices->getDevice()),
+		allocator(devices->getAllocator()), graphicsQueue(devices->getGraphicsQ()), instance(instance), buffers(buffers), deletion(deletion) {}
+
+	void create(Pipeline& pipeline, size_t frameCount);
+
+	// Rebuilds the pipeline of a changed cull.spv or hzb.spv on the worker of hotReload, other names are ignored.
+	void reload(const std::string& name, Pipeline& pipeline, HotReload& hotReload, DeletionQueue& deletion, uint32_t frameCount);
+	void build(std::vector<Model*>& models, VkCommandPool& commandPool, VkDeviceSize dynamicAlign);
+
+	// Hands the draw buffers to the deletion queue for frameCount frames, build can run right after.
+	void retireDraws(uint32_t frameCount);
+
+	// Replaces the depth pyramid, the old one is destroyed once the frames in flight are done with it.
+	// depthViews has the viewport depth of every frame in flight.
+	void resize(const std::vector<VkImageView>& depthViews, VkExtent2D extent, VkCommandPool& commandPool, uint32_t frameCount);
+	void readStats(size_t frame);
+	void dispatch(VkCommandBuffer& commandBuffer, size_t frame, Camera& camera);
+	// Draws opaque, then masked, then blended primitives back to front, binding the pipeline of each key once.
+	void draw(VkCommandBuffer& commandBuffer, size_t frame, Pipeline& pipeline, VkDescriptorSet& set, Camera& camera);
+	void buildPyramid(VkCommandBuffer& commandBuffer, size_t frame, Camera& camera);
+	void cleanup();
+
+	bool enabled = true;
+	bool frustumCulling = true;
+	bool occlusionCulling = true;
+	bool coneCulling = true;
+	bool lodSelection = true;
+	bool contributionCulling = true;
+
+	float lodThreshold = 1.0f;       // The largest error in pixels the picked LOD may have.
+	float lodBias = 0.0f;            // Scales the threshold by 2^bias, positive values pick coarser levels.
+	float lodHysteresis = 0.25f;     // A draw only gets coarser once the next level is this far under the threshold.
+	float contributionPixels = 1.0f; // Draws with a bounding sphere smaller than this radius on screen are skipped.
+
+	struct LodStats {
+		uint32_t trianglesSaved = 0;
+		uint32_t contributionCulled = 0;
+		uint32_t contributionTriangles = 0;
+		std::array<uint32_t, Simplify::maxLevels + 1> levels{};
+	};
+
+	// Results of the last finished frame.
+	CullStats stats{};
+	uint32_t clusterCount = 0;
+	uint32_t triangleCount = 0;
+
+	// Results of the LOD selection of the frame being recorded.
+	LodStats lodStats{};
+
+	std::vector<VkImageView> depthViews;
+	VkExtent2D depthExtent{};
+private:
+	struct DrawInfo {
+		PushConstant constants;
+		uint32_t dynamicOffset;
+		PipelineKey key; // See Model::pipelineKey.
+		VkIndexType indexType;
+	};
+
+	struct FrameData {
+		Buffer data;
+		Buffer commands;
+		Buffer indices;
+		Buffer stats;
+		Buffer lods;
+		VkDescriptorSet set = VK_NULL_HANDLE;
+		bool stale = true; // Set by build and resize, the set is written again before its next dispatch.
+	};
+
+	struct LodLevel {
+		float error; // In world units, the node scale is already applied.
+		uint32_t meshletOffset;
+		uint32_t meshletCount;
+		uint32_t triangleCount;
+	};
+
+	struct LodDraw {
+		glm::vec3 center;
+		float radius;
+		uint32_t level = 0; // The level picked last frame, kept for the hysteresis.
+		std::vector<LodLevel> levels;
+	};
+
+	void createPyramid(VkExtent2D extent, VkCommandPool& commandPool);
+	void retirePyramid(uint32_t frameCount);
+	void writeSet(FrameData& frame);
+	void selectLods(FrameData& frame, Camera& camera);
+	void barrier(VkCommandBuffer& commandBuffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+
+	std::vector<DrawInfo> drawInfos;
+
+	// Indices into drawInfos by alpha mode, opaque and masked ones grouped by pipeline key.
+	std::array<std::vector<uint32_t>, 3> buckets;
+	std::vector<LodDraw> lodDraws;
+	std::vector<FrameData> frames;
+	Buffer draws;
+	Buffer jobs;
+	Buffer commandTemplate;
+	uint32_t jobCount = 0;
+	VkDeviceSize halfIndexOffset = 0; // Where the 16-bit region of the index buffers starts, 4 byte aligned.
+
+	// Depth pyramid of the previous frame, each level keeps the farthest depth of the level above.
+	Image pyramid{};
+	VkExtent2D pyramidExtent{};
+	uint32_t pyramidLevels = 0;
+	std::vector<VkImageView> pyramidMips;
+	std::vector<std::vector<VkDescriptorSet>> reduceSets; // By frame, then level.
+	bool pyramidValid = false;
+	glm::mat4 pyramidView = glm::mat4(1.0f);
+	glm::vec4 pyramidProjection = glm::vec4(0.0f);
+
+	VkSampler sampler = VK_NULL_HANDLE;
+	// Reflected from the compute shaders, the layout cache owns them.
+	VkDescriptorSetLayout cullSetLayout = VK_NULL_HANDLE;
+	VkDescriptorSetLayout reduceSetLayout = VK_NULL_HANDLE;
+	VkPipelineLayout cullLayout = VK_NULL_HANDLE;
+	VkPipelineLayout reduceLayout = VK_NULL_HANDLE;
+	VkPipeline cullPipeline = VK_NULL_HANDLE;
+	VkPipeline reducePipeline = VK_NULL_HANDLE;
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	VkDescriptorPool reducePool = VK_NULL_HANDLE;
+
+	VkDevice& device;
+	VmaAllocator& allocator;
+	VkQueue& graphicsQueue;
+	VkInstance& instance;
+	Buffers& buffers;
+	DeletionQueue& deletion;
+};
+}
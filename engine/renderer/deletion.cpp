@@ -0,0 +1,42 @@
+/*
+    deletion.cpp
+    Adrenaline Engine
+
+    Definitions for the deletion queue.
+*/
+
+#include "deletion.h"
+
+void Adren::DeletionQueue::push(uint32_t frames, std::function<void()>&& function) {
+    entries.push_back({ frame + frames, std::move(function) });
+}
+
+void Adren::DeletionQueue::push(VkDevice device, VkFence fence, std::function<void()>&& function) {
+    entries.push_back({ 0, std::move(function), device, fence });
+}
+
+void Adren::DeletionQueue::next() {
+    frame++;
+
+    // Entries run in the order they were queued, so resources that depend on each other go in reverse creation order.
+    size_t kept = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        bool done = entries[i].fence != VK_NULL_HANDLE ? vkGetFenceStatus(entries[i].device, entries[i].fence) == VK_SUCCESS : entries[i].frame <= frame;
+        if (done) {
+            entries[i].function();
+        } else {
+            entries[kept++] = std::move(entries[i]);
+        }
+    }
+
+    entries.resize(kept);
+}
+
+void Adren::DeletionQueue::flush() {
+    for (Entry& entry : entries) {
+        if (entry.fence != VK_NULL_HANDLE) vkWaitForFences(entry.device, 1, &entry.fence, VK_TRUE, UINT64_MAX);
+        entry.function();
+    }
+
+    entries.clear();
+}
@@ -0,0 +1,44 @@
+/*
+	deletion.h
+	Adrenaline Engine
+
+	This defers destroying GPU resources until no frame in flight can still be using them.
+*/
+
+#pragma once
+#include "types.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace Adren {
+class DeletionQueue {
+public:
+	// Runs function once next has been called frames more times. With frames set to the number of frames in flight that
+	// is after the fence of the last frame submitted before the push has signaled, the last one that could use the resource.
+	void push(uint32_t frames, std::function<void()>&& function);
+
+	// Runs function once fence has signaled, for work submitted outside of a frame. The fence stays with the caller,
+	// function is where it gets destroyed.
+	void push(VkDevice device, VkFence fence, std::function<void()>&& function);
+
+	// Called once per frame, right after waiting on the fence of the frame.
+	void next();
+
+	// Runs everything still queued, waiting for the fences of entries that have one. Frame entries are only
+	// valid to run while the device is idle.
+	void flush();
+
+	size_t size() const { return entries.size(); }
+private:
+	struct Entry {
+		uint64_t frame;
+		std::function<void()> function;
+		VkDevice device = VK_NULL_HANDLE;
+		VkFence fence = VK_NULL_HANDLE; // Replaces frame when set.
+	};
+
+	std::vector<Entry> entries;
+	uint64_t frame = 0;
+};
+}
@@ -6,57 +6,105 @@
 */
 #include "descriptor.h"
 #include "info.h"
+#include <algorithm>
 
 #ifdef ADREN_DEBUG
 #include "debugger.h"
 #endif
 
-void Adren::Descriptor::createLayout(std::vector<Model*>& models) {
-    VkDescriptorSetLayoutBinding uboBinding = Adren::Info::uboLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0);
+void Adren::Descriptor::checkLayout(const Reflection::Program& program) {
+    struct Expected {
+        uint32_t set;
+        uint32_t binding;
+        VkDescriptorType type;
+        uint32_t count; // 0 for the runtime array.
+    };
 
-    VkDescriptorSetLayoutBinding dynamicUboBinding = Adren::Info::uboLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT, 1);
+    // What writeBufferSet and updateTable write, sorted like the reflected bindings.
+    const std::array<Expected, 5> expected = {{
+        { 0, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
+        { 0, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
+        { 0, 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 },
+        { 1, 0, VK_DESCRIPTOR_TYPE_SAMPLER, Samplers::capacity },
+        { 1, 1, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 0 }
+    }};
 
-    VkDescriptorSetLayoutBinding samplerBinding = Adren::Info::samplerLayoutBinding();
+    for (size_t i = 0; i < std::max(expected.size(), program.bindings.size()); i++) {
+        const Reflection::Binding* found = i < program.bindings.size() ? &program.bindings[i] : nullptr;
+        const Expected* wanted = i < expected.size() ? &expected[i] : nullptr;
 
-    VkDescriptorSetLayoutBinding textureBinding = Adren::Info::textureLayoutBinding(2048);
+        if (found && wanted && found->set == wanted->set && found->layout.binding == wanted->binding &&
+            found->layout.descriptorType == wanted->type && found->layout.descriptorCount == wanted->count) continue;
 
-    std::array<VkDescriptorSetLayoutBinding, 4> bindings = {uboBinding, dynamicUboBinding, samplerBinding, textureBinding};
-    VkDescriptorSetLayoutCreateInfo layoutInfo{};
-    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        std::string message = "The shaders don't match the descriptor sets the renderer writes: ";
+        if (found) {
+            message += "set " + std::to_string(found->set) + " binding " + std::to_string(found->layout.binding) + " has type " +
+                std::to_string(found->layout.descriptorType) + " and count " + std::to_string(found->layout.descriptorCount);
+        } else {
+            message += "set " + std::to_string(wanted->set) + " binding " + std::to_string(wanted->binding) + " is missing";
+        }
 
-    VkDescriptorBindingFlags flags[4];
-    flags[0] = 0; flags[1] = 0; flags[2] = 0;
-    flags[3] = VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT;
+        if (found && wanted) {
+            message += ", expected set " + std::to_string(wanted->set) + " binding " + std::to_string(wanted->binding) + " with type " +
+                std::to_string(wanted->type) + " and count " + std::to_string(wanted->count);
+        }
 
-    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlags{};
-    bindingFlags.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
-    bindingFlags.bindingCount = static_cast<uint32_t>(bindings.size());
-    bindingFlags.pBindingFlags = flags;
+        throw std::runtime_error(message + "!");
+    }
+}
 
-    layoutInfo.pBindings = bindings.data();
-    layoutInfo.pNext = &bindingFlags;
+void Adren::Descriptor::createLayout(Reflection& reflection, const Reflection::Program& program) {
+    checkLayout(program);
 
-#ifdef ADREN_DEBUG
-    Adren::Debugger::vibeCheck("DESCRIPTOR SET LAYOUT", vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &layout));
-#else
-    vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &layout);
-#endif
+    // The shaders decide what the sets hold, only what SPIR-V can't express is added here.
+    // The model matrices are bound with a dynamic offset, which looks like any other uniform buffer in the shader.
+    std::vector<VkDescriptorSetLayoutBinding> bindings = program.setBindings(0);
+    for (VkDescriptorSetLayoutBinding& binding : bindings) {
+        if (binding.binding == 1 && binding.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER) {
+            binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        }
+    }
+
+    layout = reflection.setLayout(bindings);
+
+    // Dynamic uniform buffers can't live in an update after bind set, so the table gets a layout of its own.
+    VkPhysicalDeviceDescriptorIndexingProperties indexing{};
+    indexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &indexing;
+    vkGetPhysicalDeviceProperties2(gpu, &properties);
+
+    maxTableSize = std::min({ indexing.maxPerStageDescriptorUpdateAfterBindSampledImages,
+        indexing.maxDescriptorSetUpdateAfterBindSampledImages, 1u << 16 });
+
+    // The runtime array of textures is the variable sized binding, it has to be the last one of the set.
+    std::vector<VkDescriptorSetLayoutBinding> tableBindings = program.setBindings(1);
+    std::vector<VkDescriptorBindingFlags> flags(tableBindings.size(),
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT);
+
+    for (size_t i = 0; i < tableBindings.size(); i++) {
+        if (tableBindings[i].descriptorCount > 0) continue;
+        tableBindings[i].descriptorCount = maxTableSize;
+        flags[i] |= VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT;
+    }
+
+    tableLayout = reflection.setLayout(tableBindings, flags, VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT);
 }
 
-void Adren::Descriptor::createPool(std::vector<VkImage>& images) {
-    // This block creates 4 descriptor pools with different types
-    std::array<VkDescriptorPoolSize, 4> poolSizes{};
-    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER; poolSizes[0].descriptorCount = 100000;
-    poolSizes[1].type = VK_DESCRIPTOR_TYPE_SAMPLER; poolSizes[1].descriptorCount = 100000;
-    poolSizes[2].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE; poolSizes[2].descriptorCount = 100000;
-    poolSizes[3].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC; poolSizes[3].descriptorCount = 100000;
+void Adren::Descriptor::createPool(uint32_t setCount) {
+    // Set 0 only holds the uniform buffers and the materials of every frame, the table has a pool of its own.
+    std::array<VkDescriptorPoolSize, 3> poolSizes{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER; poolSizes[0].descriptorCount = setCount;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC; poolSizes[1].descriptorCount = setCount;
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER; poolSizes[2].descriptorCount = setCount;
 
     VkDescriptorPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
     poolInfo.pPoolSizes = poolSizes.data();
-    poolInfo.maxSets = static_cast<uint32_t>(images.size());
+    poolInfo.maxSets = setCount;
 
 #ifdef ADREN_DEBUG
     Adren::Debugger::vibeCheck("DESCRIPTOR POOL", vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool));
@@ -65,7 +113,7 @@ void Adren::Descriptor::createPool(std::vector<VkImage>& images) {
 #endif
 }
 
-void Adren::Descriptor::fillWrites(std::array<VkWriteDescriptorSet, 4>& write, int index, VkDescriptorSet& dSet, int binding, VkDescriptorType type, size_t& count) {
+void Adren::Descriptor::fillWrites(std::array<VkWriteDescriptorSet, 3>& write, int index, VkDescriptorSet& dSet, int binding, VkDescriptorType type, size_t& count) {
     write[index].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     write[index].dstSet = dSet;
     write[index].dstBinding = binding;
@@ -74,76 +122,284 @@ void Adren::Descriptor::fillWrites(std::array<VkWriteDescriptorSet, 4>& write, i
     write[index].descriptorCount = count;
 }
 
-void Adren::Descriptor::createSets(std::vector<Model::Texture>& textures, std::vector<VkImage>& images, Buffer& cam) {
-    size_t textureSize = textures.size();
-    uint32_t setCount = static_cast<uint32_t>(images.size());
+void Adren::Descriptor::createSets(uint32_t setCount, Buffer& cam) {
     std::vector<VkDescriptorSetLayout> layouts(setCount, layout);
-    
-    uint32_t counts[4];
-    for (int c = 0; c < 4; c++) { counts[c] = textureSize; }
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = pool;
+    allocInfo.descriptorSetCount = setCount;
+    allocInfo.pSetLayouts = layouts.data();
+
+    sets.resize(setCount);
+    dirty.assign(setCount, {});
+    Adren::Debugger::vibeCheck("ALLOCATED DESCRIPTOR SETS", vkAllocateDescriptorSets(device, &allocInfo, sets.data()));
+
+    writeBuffers(cam);
+}
+
+void Adren::Descriptor::writeBuffers(Buffer& cam) {
+    camera = &cam;
+    staleBuffers.assign(sets.size(), true);
+}
+
+void Adren::Descriptor::writeBufferSet(uint32_t set) {
+    VkDescriptorBufferInfo bufferInfo{};
+    bufferInfo.buffer = camera->buffer;
+    bufferInfo.offset = 0;
+    bufferInfo.range = sizeof(CameraObject);
+
+    VkDescriptorBufferInfo dynamicBufferInfo{};
+    dynamicBufferInfo.buffer = buffers.dynamicUniform.buffer;
+    dynamicBufferInfo.offset = 0;
+    dynamicBufferInfo.range = sizeof(glm::mat4);
+
+    VkDescriptorBufferInfo materialInfo{};
+    materialInfo.buffer = buffers.materials.buffer;
+    materialInfo.offset = 0;
+    materialInfo.range = VK_WHOLE_SIZE;
+
+    std::array<VkWriteDescriptorSet, 3> dWrites{};
+
+    size_t count = 1;
+    fillWrites(dWrites, 0, sets[set], 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, count);
+    dWrites[0].pBufferInfo = &bufferInfo;
+
+    fillWrites(dWrites, 1, sets[set], 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, count);
+    dWrites[1].pBufferInfo = &dynamicBufferInfo;
+
+    fillWrites(dWrites, 2, sets[set], 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, count);
+    dWrites[2].pBufferInfo = &materialInfo;
+
+    vkUpdateDescriptorSets(device, static_cast<uint32_t>(dWrites.size()), dWrites.data(), 0, nullptr);
+    staleBuffers[set] = false;
+}
+
+uint32_t Adren::Descriptor::allocateTextures(uint32_t count) {
+    if (count == 0) return slots;
+
+    // First fit, the table only grows when no freed run is long enough.
+    for (auto range = freeRanges.begin(); range != freeRanges.end(); range++) {
+        if (range->count < count) continue;
+
+        uint32_t first = range->first;
+        range->first += count;
+        range->count -= count;
+        if (range->count == 0) freeRanges.erase(range);
+
+        fresh.push_back({ first, count });
+        return first;
+    }
+
+    // Models past the device limit can't be sampled at all, leaving them out would draw them with the wrong textures.
+    if (maxTableSize != 0 && count > maxTableSize - slots) {
+        throw std::runtime_error("Texture table needs " + std::to_string(slots + count) + " slots, the device allows "
+            + std::to_string(maxTableSize) + "!");
+    }
+
+    uint32_t first = slots;
+    slots += count;
+    fresh.push_back({ first, count });
+    return first;
+}
+
+void Adren::Descriptor::freeTextures(uint32_t first, uint32_t count) {
+    if (count == 0) return;
+
+    deletion.push(static_cast<uint32_t>(tableSets.size()), [this, first, count]() {
+        auto next = std::lower_bound(freeRanges.begin(), freeRanges.end(), first, [](const Range& range, uint32_t slot) {
+            return range.first < slot;
+        });
+
+        next = freeRanges.insert(next, { first, count });
+
+        if (next + 1 != freeRanges.end() && next->first + next->count == (next + 1)->first) {
+            next->count += (next + 1)->count;
+            freeRanges.erase(next + 1);
+        }
+
+        if (next != freeRanges.begin() && (next - 1)->first + (next - 1)->count == next->first) {
+            (next - 1)->count += next->count;
+            freeRanges.erase(next);
+        }
+    });
+}
+
+void Adren::Descriptor::createTable(uint32_t capacity, uint32_t setCount) {
+    std::array<VkDescriptorPoolSize, 2> poolSizes{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_SAMPLER; poolSizes[0].descriptorCount = Samplers::capacity * setCount;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE; poolSizes[1].descriptorCount = capacity * setCount;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = setCount;
+
+    // Frames in flight still read the old table, it goes once all of them have finished.
+    if (tablePool != VK_NULL_HANDLE) {
+        deletion.push(setCount, [device = device, old = tablePool]() {
+            vkDestroyDescriptorPool(device, old, nullptr);
+        });
+    }
+
+#ifdef ADREN_DEBUG
+    Adren::Debugger::vibeCheck("TABLE POOL", vkCreateDescriptorPool(device, &poolInfo, nullptr, &tablePool));
+#else
+    vkCreateDescriptorPool(device, &poolInfo, nullptr, &tablePool);
+#endif
+
+    std::vector<VkDescriptorSetLayout> layouts(setCount, tableLayout);
+    std::vector<uint32_t> counts(setCount, capacity);
 
     VkDescriptorSetVariableDescriptorCountAllocateInfo setCounts{};
     setCounts.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
     setCounts.descriptorSetCount = setCount;
-    setCounts.pDescriptorCounts = counts;
+    setCounts.pDescriptorCounts = counts.data();
 
     VkDescriptorSetAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = pool;
+    allocInfo.descriptorPool = tablePool;
     allocInfo.descriptorSetCount = setCount;
     allocInfo.pSetLayouts = layouts.data();
     allocInfo.pNext = &setCounts;
 
-    sets.resize(setCount);
-    Adren::Debugger::vibeCheck("ALLOCATED DESCRIPTOR SETS", vkAllocateDescriptorSets(device, &allocInfo, sets.data()));
+    tableSets.resize(setCount);
+    Adren::Debugger::vibeCheck("ALLOCATED TABLE SETS", vkAllocateDescriptorSets(device, &allocInfo, tableSets.data()));
+
+    tableCapacity = capacity;
+    writtenSamplers = 0;
+
+#ifdef ADREN_DEBUG
+    std::cerr << "-> Texture table: " << capacity << " slots" << std::endl;
+#endif
+}
+
+void Adren::Descriptor::updateTable(std::vector<Model::Texture>& textures) {
+    uint32_t setCount = static_cast<uint32_t>(sets.size());
+    if (setCount == 0) return;
+
+    // A new table starts out empty, every slot in use is written into it and nothing is left for beginFrame.
+    if (tablePool == VK_NULL_HANDLE || slots > tableCapacity) {
+        uint32_t capacity = std::max(tableCapacity, minTableSize);
+        while (capacity < slots) capacity *= 2;
+        createTable(std::min(capacity, maxTableSize), setCount);
+
+        std::vector<bool> used(slots, true);
+        for (const Range& range : freeRanges) {
+            std::fill(used.begin() + range.first, used.begin() + range.first + range.count, false);
+        }
 
-    VkSamplerCreateInfo sampInfo = Adren::Info::samplerInfo();
-    Adren::Debugger::vibeCheck("CREATE SAMPLER", vkCreateSampler(device, &sampInfo, nullptr, &sampler));
+        fresh.clear();
+        for (uint32_t i = 0; i < slots; i++) {
+            if (!used[i]) continue;
+            if (!fresh.empty() && fresh.back().first + fresh.back().count == i) fresh.back().count++;
+            else fresh.push_back({ i, 1 });
+        }
+
+        for (auto& indices : dirty) indices.clear();
+    }
 
-    VkDescriptorImageInfo samplerInfo{};
-    samplerInfo.sampler = sampler;
     std::vector<VkDescriptorImageInfo> imageInfo;
+    std::vector<VkWriteDescriptorSet> writes;
 
-    for (int i = 0; i < textureSize; i++) {
-        VkDescriptorImageInfo info;
-        info.sampler = sampler;
-        info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        info.imageView = textures[i].view;
-        imageInfo.push_back(info);
+    for (const Range& range : fresh) {
+        if (range.first + range.count > std::min(tableCapacity, static_cast<uint32_t>(textures.size()))) continue;
+        for (uint32_t i = range.first; i < range.first + range.count; i++) {
+            imageInfo.push_back({ VK_NULL_HANDLE, textures[i].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL });
+        }
     }
 
-    for (VkDescriptorSet& set : sets) {
-        VkDescriptorBufferInfo bufferInfo{};
-        bufferInfo.buffer = cam.buffer;
-        bufferInfo.offset = 0;
-        bufferInfo.range = sizeof(CameraObject);
+    // A new table gets the default sampler in the elements past the cached ones, later samplers overwrite them.
+    uint32_t samplerCount = static_cast<uint32_t>(samplers.samplers.size());
+    uint32_t samplerEnd = writtenSamplers == 0 && samplerCount > 0 ? Samplers::capacity : samplerCount;
+
+    std::vector<VkDescriptorImageInfo> samplerInfo;
+    for (uint32_t i = writtenSamplers; i < samplerEnd; i++) {
+        samplerInfo.push_back({ samplers.samplers[i < samplerCount ? i : 0], VK_NULL_HANDLE, VK_IMAGE_LAYOUT_UNDEFINED });
+    }
 
-        VkDescriptorBufferInfo dynamicBufferInfo{};
-        dynamicBufferInfo.buffer = buffers.dynamicUniform.buffer;
-        dynamicBufferInfo.offset = 0;
-        dynamicBufferInfo.range = sizeof(glm::mat4);
+    // imageInfo is complete before any write points into it.
+    for (VkDescriptorSet& set : tableSets) {
+        uint32_t offset = 0;
+        for (const Range& range : fresh) {
+            if (range.first + range.count > std::min(tableCapacity, static_cast<uint32_t>(textures.size()))) continue;
 
-        std::array<VkWriteDescriptorSet, 4> dWrites{};
+            VkWriteDescriptorSet write{};
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = set;
+            write.dstBinding = 1;
+            write.dstArrayElement = range.first;
+            write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+            write.descriptorCount = range.count;
+            write.pImageInfo = imageInfo.data() + offset;
+            writes.push_back(write);
+            offset += range.count;
+        }
 
-        size_t count = 1;
-        fillWrites(dWrites, 0, set, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, count);
-        dWrites[0].pBufferInfo = &bufferInfo;
+        if (!samplerInfo.empty()) {
+            VkWriteDescriptorSet write{};
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = set;
+            write.dstBinding = 0;
+            write.dstArrayElement = writtenSamplers;
+            write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+            write.descriptorCount = static_cast<uint32_t>(samplerInfo.size());
+            write.pImageInfo = samplerInfo.data();
+            writes.push_back(write);
+        }
+    }
 
-        fillWrites(dWrites, 1, set, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, count);
-        dWrites[1].pBufferInfo = &dynamicBufferInfo;
+    if (!writes.empty()) vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 
-        fillWrites(dWrites, 2, set, 2, VK_DESCRIPTOR_TYPE_SAMPLER, count);
-        dWrites[2].pImageInfo = &samplerInfo;
+    writtenSamplers = static_cast<uint32_t>(samplers.samplers.size());
+    fresh.clear();
+}
 
-        fillWrites(dWrites, 3, set, 3, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, textureSize);
-        dWrites[3].pImageInfo = imageInfo.data();
+void Adren::Descriptor::writeTexture(uint32_t set, uint32_t index, VkImageView view) {
+    if (index >= tableCapacity) return;
 
-        vkUpdateDescriptorSets(device, static_cast<uint32_t>(dWrites.size()), dWrites.data(), 0, nullptr);
+    VkDescriptorImageInfo info{};
+    info.imageView = view;
+    info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = tableSets[set];
+    write.dstBinding = 1;
+    write.dstArrayElement = index;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    write.descriptorCount = 1;
+    write.pImageInfo = &info;
+
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+}
+
+void Adren::Descriptor::replaceTexture(uint32_t index, std::vector<Model::Texture>& textures) {
+    if (currentSet >= tableSets.size()) return;
+
+    writeTexture(currentSet, index, textures[index].view);
+    for (uint32_t set = 0; set < dirty.size(); set++) {
+        if (set != currentSet) dirty[set].push_back(index);
     }
 }
 
+void Adren::Descriptor::beginFrame(uint32_t set, std::vector<Model::Texture>& textures) {
+    currentSet = set;
+    if (set < staleBuffers.size() && staleBuffers[set]) writeBufferSet(set);
+
+    if (set >= dirty.size() || set >= tableSets.size()) return;
+
+    for (uint32_t index : dirty[set]) {
+        if (index < textures.size()) writeTexture(set, index, textures[index].view);
+    }
+
+    dirty[set].clear();
+}
+
 void Adren::Descriptor::cleanup() {
-    vkDestroyDescriptorSetLayout(device, layout, nullptr);
     vkDestroyDescriptorPool(device, pool, nullptr);
-    vkDestroySampler(device, sampler, nullptr);
+    vkDestroyDescriptorPool(device, tablePool, nullptr);
+    samplers.cleanup();
 }
@@ -3,29 +3,95 @@
 	Adrenaline Engine
 
 	This file handles all the things related to descriptor sets.
+	Set 0 holds the camera, the model matrices and the materials. Set 1 is the bindless table of samplers and textures, it is
+	written element by element as textures come and go and grows into a larger pool when it runs out of slots.
 */
 
 #pragma once
 #include "buffers.h"
+#include "samplers.h"
+#include "deletion.h"
+#include "reflection.h"
 
 namespace Adren {
 class Descriptor {
 public:
-	Descriptor(Devices* devices, Buffers& buffers) : device(devices->getDevice()), buffers(buffers) {}
+	Descriptor(Devices* devices, Buffers& buffers, DeletionQueue& deletion) : samplers(devices), device(devices->getDevice()),
+		gpu(devices->getGPU()), buffers(buffers), deletion(deletion) {}
 
-	void createLayout(std::vector<Model*>& models);
-	void createPool(std::vector<VkImage>& images);
-	void createSets(std::vector<Model::Texture>& textures, std::vector<VkImage>& images, Buffer& cam);
+	// Set layouts from what the graphics shaders declare, see Reflection. Throws when the shaders declare other
+	// bindings than the ones the sets are written with.
+	void createLayout(Reflection& reflection, const Reflection::Program& program);
+	void createPool(uint32_t setCount);
+	void createSets(uint32_t setCount, Buffer& cam);
+
+	// Points set 0 at the uniform and material buffers again once they have been recreated. Every set is written when
+	// beginFrame reaches it, frames in flight keep the buffers they were recorded with.
+	void writeBuffers(Buffer& cam);
+
+	// First slot of a run of count slots in the table, taken from the free list or the end of the table. Throws when
+	// the table would outgrow maxTableSize.
+	uint32_t allocateTextures(uint32_t count);
+
+	// Gives a run back once every frame in flight is done with it.
+	void freeTextures(uint32_t first, uint32_t count);
+
+	// Number of slots the table hands out, textures needs one element per slot.
+	uint32_t slotCount() const { return slots; }
+
+	// Writes the slots and samplers added since the last call into every set, growing the table when it is too small.
+	// New slots aren't used by any pending frame, so this is valid at any point.
+	void updateTable(std::vector<Model::Texture>& textures);
+
+	// Points one element of the texture array of a set at another view. Only valid while no pending frame uses the element.
+	void writeTexture(uint32_t set, uint32_t index, VkImageView view);
+
+	// Points an element of the texture array of every set at the view in textures. The set of the current frame is
+	// written right away, the others when beginFrame reaches them.
+	void replaceTexture(uint32_t index, std::vector<Model::Texture>& textures);
+	void beginFrame(uint32_t set, std::vector<Model::Texture>& textures);
 
 	void cleanup();
 
-	std::vector<VkDescriptorSet> sets;
-	VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> sets;      // Set 0, one per frame in flight.
+	std::vector<VkDescriptorSet> tableSets; // Set 1, one per frame in flight.
+	VkDescriptorSetLayout layout = VK_NULL_HANDLE;      // Both layouts are owned by the layout cache.
+	VkDescriptorSetLayout tableLayout = VK_NULL_HANDLE;
 	VkDescriptorPool pool = VK_NULL_HANDLE;
-	VkSampler sampler = VK_NULL_HANDLE;
+	VkDescriptorPool tablePool = VK_NULL_HANDLE;
+
+	uint32_t minTableSize = 256;   // Slots of the first table, it doubles whenever it runs out.
+	uint32_t tableCapacity = 0;
+	uint32_t maxTableSize = 0;     // Upper bound of the layout, the lower of the update after bind sampled image limits per stage and per set.
+
+	// Outlives the pools and layouts, reloads reuse the samplers it already holds.
+	Samplers samplers;
 private:
-	void fillWrites(std::array<VkWriteDescriptorSet, 4>& write, int index, VkDescriptorSet& dSet, int binding, VkDescriptorType type, size_t& count);
-	Buffers& buffers;
+	void checkLayout(const Reflection::Program& program);
+	void createTable(uint32_t capacity, uint32_t setCount);
+
+	void writeBufferSet(uint32_t set);
+	std::vector<bool> staleBuffers; // Sets still pointing at retired buffers.
+	Buffer* camera = nullptr;
+
+	// Texture indices whose view changed after the set was last written.
+	std::vector<std::vector<uint32_t>> dirty;
+	uint32_t currentSet = 0;
+
+	struct Range {
+		uint32_t first;
+		uint32_t count;
+	};
+
+	std::vector<Range> freeRanges; // Sorted by first slot, neighbours are merged.
+	std::vector<Range> fresh;      // Allocated since the last updateTable, not written into the table yet.
+	uint32_t slots = 0;
+	uint32_t writtenSamplers = 0;
+
+	void fillWrites(std::array<VkWriteDescriptorSet, 3>& write, int index, VkDescriptorSet& dSet, int binding, VkDescriptorType type, size_t& count);
 	VkDevice& device;
+	VkPhysicalDevice& gpu;
+	Buffers& buffers;
+	DeletionQueue& deletion;
 };
-}
\ No newline at end of file
+}
@@ -43,8 +43,21 @@ bool Adren::Devices::isDeviceSuitable(VkPhysicalDevice& card, VkSurfaceKHR& surf
     
     VkPhysicalDeviceFeatures supportedFeatures;
     vkGetPhysicalDeviceFeatures(card, &supportedFeatures);
-    
-    return indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy;
+
+    // The texture table is an update after bind, partially bound array of variable size, createLogicalDevice enables these.
+    VkPhysicalDeviceDescriptorIndexingFeatures indexing{};
+    indexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &indexing;
+    vkGetPhysicalDeviceFeatures2(card, &features);
+
+    const bool indexingSupported = indexing.shaderSampledImageArrayNonUniformIndexing && indexing.runtimeDescriptorArray &&
+        indexing.descriptorBindingVariableDescriptorCount && indexing.descriptorBindingPartiallyBound &&
+        indexing.descriptorBindingSampledImageUpdateAfterBind && indexing.descriptorBindingUpdateUnusedWhilePending;
+
+    return indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy && indexingSupported;
 }
 
 void Adren::Devices::pickGPU(VkSurfaceKHR& surface) {
@@ -87,6 +100,13 @@ void Adren::Devices::createLogicalDevice() {
     VkPhysicalDeviceFeatures deviceFeatures{};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
 
+    // Block compressed textures are used whenever the GPU can sample them, see Images::formatSupported.
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(gpu, &supportedFeatures);
+    deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+    deviceFeatures.textureCompressionETC2 = supportedFeatures.textureCompressionETC2;
+    deviceFeatures.textureCompressionASTC_LDR = supportedFeatures.textureCompressionASTC_LDR;
+
     VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexing{};
     descriptorIndexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
 
@@ -94,6 +114,8 @@ void Adren::Devices::createLogicalDevice() {
     descriptorIndexing.runtimeDescriptorArray = VK_TRUE;
     descriptorIndexing.descriptorBindingVariableDescriptorCount = VK_TRUE;
     descriptorIndexing.descriptorBindingPartiallyBound = VK_TRUE;
+    descriptorIndexing.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    descriptorIndexing.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
 
 
     VkDeviceCreateInfo createInfo{};
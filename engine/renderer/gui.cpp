@@ -44,7 +44,8 @@ void Adren::GUI::createDescriptorPool() {
 #endif
 }
 
-void Adren::GUI::init(Camera& camera, GLFWwindow* window, VkSurfaceKHR& surface) {
+void Adren::GUI::init(Camera& camera, GLFWwindow* window, VkSurfaceKHR& surface, VkPipelineCache pipelineCache, uint32_t frameCount) {
+    framesInFlight = frameCount;
     createDescriptorPool();
     IMGUI_CHECKVERSION();
     ctx = ImGui::CreateContext();
@@ -94,10 +95,9 @@ void Adren::GUI::init(Camera& camera, GLFWwindow* window, VkSurfaceKHR& surface)
 
     queueFam = Adren::Tools::findQueueFamilies(gpu, surface);
 
-    createRenderPass(camera);
+    createRenderPass();
     createSampler();
     createCommands();
-    createFramebuffers(camera);
 
     ImGui_ImplGlfw_InitForVulkan(window, true);
 
@@ -107,7 +107,7 @@ void Adren::GUI::init(Camera& camera, GLFWwindow* window, VkSurfaceKHR& surface)
     guiInfo.Device = device;
     guiInfo.Queue = graphicsQueue;
     guiInfo.QueueFamily = queueFam.graphicsFamily.value();
-    guiInfo.PipelineCache = VK_NULL_HANDLE;
+    guiInfo.PipelineCache = pipelineCache;
     guiInfo.DescriptorPool = descriptorPool;
     guiInfo.Allocator = VK_NULL_HANDLE;
     guiInfo.MinImageCount = swapchain.imageCount;
@@ -121,15 +121,15 @@ void Adren::GUI::init(Camera& camera, GLFWwindow* window, VkSurfaceKHR& surface)
 
     ImGui_ImplVulkan_CreateFontsTexture(commandBuffer);
 
-    Adren::Tools::endSingleTimeCommands(commandBuffer, device, graphicsQueue, base.commandPool);
+    // The upload buffer of the fonts goes once the copy is done.
+    Adren::Tools::endSingleTimeCommands(commandBuffer, device, graphicsQueue, base.commandPool, deletion, []() {
+        ImGui_ImplVulkan_DestroyFontUploadObjects();
+    });
 
-    ImGui_ImplVulkan_DestroyFontUploadObjects();
-
-    base.set = ImGui_ImplVulkan_AddTexture(base.sampler, base.color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    createTargets(camera);
  
 #ifdef ADREN_DEBUG
         Adren::Debugger::label(instance, device, VK_OBJECT_TYPE_COMMAND_POOL, (uint64_t)base.commandPool, "IMGUI COMMAND POOL");
-        Adren::Debugger::label(instance, device, VK_OBJECT_TYPE_FRAMEBUFFER, (uint64_t)base.framebuffer, "IMGUI FRAMEBUFFER");
         Adren::Debugger::label(instance, device, VK_OBJECT_TYPE_RENDER_PASS, (uint64_t)base.renderpass, "IMGUI RENDER PASS");
         Adren::Debugger::log("ImGui has been initialized..");
 #endif
@@ -163,12 +163,8 @@ void Adren::GUI::cleanup() {
     vkDestroyCommandPool(device, base.commandPool, nullptr);
     vkDestroyDescriptorPool(device, descriptorPool, nullptr);
     vkDestroySampler(device, base.sampler, nullptr);
-    vmaDestroyImage(allocator, base.color.image, base.color.memory);
-    vkDestroyImageView(device, base.color.view, nullptr);
-    vmaDestroyImage(allocator, base.depth.image, base.depth.memory);
-    vkDestroyImageView(device, base.depth.view, nullptr);
+    destroyTargets(base.targets);
     vkDestroyRenderPass(device, base.renderpass, nullptr);
-    vkDestroyFramebuffer(device, base.framebuffer, nullptr); 
 }
 
 void Adren::GUI::mouseHandler(GLFWwindow* window, Camera& camera) {
@@ -200,17 +196,72 @@ void Adren::GUI::newFrame(GLFWwindow* window, Camera& camera) {
 
 }
 
-void Adren::GUI::createRenderPass(Camera& camera) {
-    images.createImage(camera.getWidth(), camera.getHeight(), swapchain.imgFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT 
-        | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VMA_MEMORY_USAGE_AUTO, base.color);
-    
-    base.color.view = images.createImageView(base.color.image, swapchain.imgFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+void Adren::GUI::createTargets(Camera& camera) {
+    base.targets.resize(framesInFlight);
+
+    for (Target& target : base.targets) {
+        images.createImage(camera.getWidth(), camera.getHeight(), swapchain.imgFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT 
+            | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VMA_MEMORY_USAGE_AUTO, target.color);
+        
+        target.color.view = images.createImageView(target.color.image, swapchain.imgFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+
+        // The depth is sampled afterwards to build the depth pyramid for occlusion culling.
+        images.createImage(camera.getWidth(), camera.getHeight(), images.depth.format, VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VMA_MEMORY_USAGE_AUTO, target.depth);
+
+        target.depth.view = images.createImageView(target.depth.image, images.depth.format, VK_IMAGE_ASPECT_DEPTH_BIT);
+
+        VkImageView attachments[2];
+        attachments[0] = target.color.view;
+        attachments[1] = target.depth.view;
+
+        VkFramebufferCreateInfo framebufferInfo{};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = base.renderpass;
+        framebufferInfo.attachmentCount = 2;
+        framebufferInfo.pAttachments = attachments;
+        framebufferInfo.width = camera.getWidth();
+        framebufferInfo.height = camera.getHeight();
+        framebufferInfo.layers = 1;
+
+#ifdef ADREN_DEBUG
+        Adren::Debugger::vibeCheck("IMGUI FRAME BUFFER", vkCreateFramebuffer(device, &framebufferInfo, nullptr, &target.framebuffer));
+#else
+        vkCreateFramebuffer(device, &framebufferInfo, nullptr, &target.framebuffer);
+#endif
+
+        target.set = ImGui_ImplVulkan_AddTexture(base.sampler, target.color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+#ifdef ADREN_DEBUG 
+        Adren::Debugger::label(instance, device, VK_OBJECT_TYPE_IMAGE, (uint64_t)target.color.image, "GUI COLOR IMAGE");
+        Adren::Debugger::label(instance, device, VK_OBJECT_TYPE_IMAGE, (uint64_t)target.depth.image, "GUI DEPTH IMAGE");
+        Adren::Debugger::label(instance, device, VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)target.color.view, "GUI COLOR IMAGE VIEW");
+        Adren::Debugger::label(instance, device, VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)target.depth.view, "GUI DEPTH IMAGE VIEW");
+        Adren::Debugger::label(instance, device, VK_OBJECT_TYPE_FRAMEBUFFER, (uint64_t)target.framebuffer, "IMGUI FRAMEBUFFER");
+#endif
+    }
+}
 
-    images.createImage(camera.getWidth(), camera.getHeight(), images.depth.format, VK_IMAGE_TILING_OPTIMAL,
-        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VMA_MEMORY_USAGE_AUTO, base.depth);
+void Adren::GUI::destroyTargets(const std::vector<Target>& targets) {
+    for (const Target& target : targets) {
+        vkDestroyFramebuffer(device, target.framebuffer, nullptr);
+        vkDestroyImageView(device, target.color.view, nullptr);
+        vkDestroyImageView(device, target.depth.view, nullptr);
+        vmaDestroyImage(allocator, target.color.image, target.color.memory);
+        vmaDestroyImage(allocator, target.depth.image, target.depth.memory);
+    }
+}
 
-    base.depth.view = images.createImageView(base.depth.image, images.depth.format, VK_IMAGE_ASPECT_DEPTH_BIT);
-   
+std::vector<VkImageView> Adren::GUI::depthViews() const {
+    std::vector<VkImageView> views;
+    for (const Target& target : base.targets) {
+        views.push_back(target.depth.view);
+    }
+
+    return views;
+}
+
+void Adren::GUI::createRenderPass() {
     std::array<VkAttachmentDescription, 2> attachments{};
     attachments[0].format = swapchain.imgFormat;
     attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
@@ -228,7 +279,7 @@ void Adren::GUI::createRenderPass(Camera& camera) {
     attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
     
     VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
     VkAttachmentReference depthReference = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
@@ -242,19 +293,20 @@ void Adren::GUI::createRenderPass(Camera& camera) {
     std::array<VkSubpassDependency, 2> dependencies;
     dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
     dependencies[0].dstSubpass = 0;
-    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
     dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
     dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
     
+    // The depth is read by the depth pyramid compute pass once the render pass is over.
     dependencies[1].srcSubpass = 0;
     dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
     dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-    dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+    dependencies[1].dependencyFlags = 0;
     
     VkRenderPassCreateInfo info{};
     info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -270,34 +322,6 @@ void Adren::GUI::createRenderPass(Camera& camera) {
 #else
     vkCreateRenderPass(device, &info, nullptr, &base.renderpass);
 #endif
-
-#ifdef ADREN_DEBUG 
-    Adren::Debugger::label(instance, device, VK_OBJECT_TYPE_IMAGE, (uint64_t)base.color.image, "GUI COLOR IMAGE");
-    Adren::Debugger::label(instance, device, VK_OBJECT_TYPE_IMAGE, (uint64_t)base.depth.image, "GUI DEPTH IMAGE");
-    Adren::Debugger::label(instance, device, VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)base.color.view, "GUI COLOR IMAGE VIEW");
-    Adren::Debugger::label(instance, device, VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)base.depth.view, "GUI DEPTH IMAGE VIEW");
-#endif
-}
-
-void Adren::GUI::createFramebuffers(Camera& camera) {
-    VkImageView attachments[2];
-    attachments[0] = base.color.view;
-    attachments[1] = base.depth.view;
-
-    VkFramebufferCreateInfo framebufferInfo{};
-    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-    framebufferInfo.renderPass = base.renderpass;
-    framebufferInfo.attachmentCount = 2;
-    framebufferInfo.pAttachments = attachments;
-    framebufferInfo.width = camera.getWidth();
-    framebufferInfo.height = camera.getHeight();
-    framebufferInfo.layers = 1;
-
-#ifdef ADREN_DEBUG
-    Adren::Debugger::vibeCheck("IMGUI FRAME BUFFER", vkCreateFramebuffer(device, &framebufferInfo, nullptr, &base.framebuffer));
-#else
-    vkCreateFramebuffer(device, &framebufferInfo, nullptr, &base.framebuffer);
-#endif
 }
 
 void Adren::GUI::createCommands() {
@@ -313,7 +337,7 @@ void Adren::GUI::createCommands() {
 #endif
 }
 
-// This function recreates images, renderpass and framebuffer used to display the Vulkan scene to the GUI.
+// This function recreates the images and framebuffers used to display the Vulkan scene to the GUI.
 // It re-renders the scene in a different display resolution dictated by the viewport function.
 // Thank you olkotov for inspiration https://github.com/ocornut/imgui/issues/1287#issuecomment-1093514753
 void Adren::GUI::resize(ImVec2& size, Camera& camera) {
@@ -322,27 +346,18 @@ void Adren::GUI::resize(ImVec2& size, Camera& camera) {
     camera.setWidth(size.x);
     camera.setHeight(size.y);
 
-    vkDeviceWaitIdle(device);
-    
-    // Destroying the images because we would have to recreate it in a different size.
-    vmaDestroyImage(allocator, base.depth.image, base.depth.memory);
-    vmaDestroyImage(allocator, base.color.image, base.color.memory);
-
-    // Same with the images
-    vkDestroyImageView(device, base.color.view, nullptr);
-    vkDestroyImageView(device, base.depth.view, nullptr);
-    
-    // This destroys the render pass and framebuffer because they are required to render to the viewport
-    vkDestroyRenderPass(device, base.renderpass, nullptr);
-    vkDestroyFramebuffer(device, base.framebuffer, nullptr);
+    // The frames in flight still render into the old targets and the GUI still samples them, so they are destroyed
+    // once those frames are done. The render pass doesn't depend on the size and is kept.
+    deletion.push(framesInFlight, [this, old = base.targets]() {
+        for (const Target& target : old) {
+            ImGui_ImplVulkan_RemoveTexture(target.set);
+        }
 
-    // This creates a new renderpass and framebuffer with the new size
-    createRenderPass(camera);
-    createFramebuffers(camera);
+        destroyTargets(old);
+    });
 
-    // We are redefining base.set to have the new size.
-    base.set = ImGui_ImplVulkan_AddTexture(base.sampler, 
-               base.color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    // This creates new targets with the new size, each with its own ImGui texture.
+    createTargets(camera);
 }
 
 // This function sets up the viewport element of the editor that shows what Vulkan is rendering.
@@ -372,7 +387,7 @@ void Adren::GUI::viewport(Camera& camera) {
     if (ImGui::BeginTabBar("ViewportTabBar")) {
         ImGui::PushStyleVar(ImGuiStyleVar_ItemInnerSpacing, ImVec2(0.0f, 0.0f));
         if (ImGui::BeginTabItem("Scene")) {
-            ImGui::Image((ImTextureID)base.set, ImVec2(camera.getWidth(), camera.getHeight()));
+            ImGui::Image((ImTextureID)base.targets[frame].set, ImVec2(camera.getWidth(), camera.getHeight()));
             ImGui::EndTabItem();
         }
 
@@ -384,11 +399,11 @@ void Adren::GUI::viewport(Camera& camera) {
     ImGui::End();
 }
 
-void Adren::GUI::beginRenderpass(Camera& camera, VkCommandBuffer& buffer, VkPipeline& pipeline, Buffer& vertex, Buffer& index) {
+void Adren::GUI::beginRenderpass(Camera& camera, VkCommandBuffer& buffer, VkPipeline& pipeline, Buffer& vertex) {
     VkRenderPassBeginInfo renderpassInfo{};
     renderpassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
     renderpassInfo.renderPass = base.renderpass;
-    renderpassInfo.framebuffer = base.framebuffer;
+    renderpassInfo.framebuffer = base.targets[frame].framebuffer;
     renderpassInfo.renderArea.offset = { 0, 0 };
     renderpassInfo.renderArea.extent.width = camera.getWidth();
     renderpassInfo.renderArea.extent.height = camera.getHeight();
@@ -422,8 +437,6 @@ void Adren::GUI::beginRenderpass(Camera& camera, VkCommandBuffer& buffer, VkPipe
     VkBuffer vertexBuffers[] = { vertex.buffer };
     VkDeviceSize offsets[] = { 0 };
     vkCmdBindVertexBuffers(buffer, 0, 1, vertexBuffers, offsets);
-
-    vkCmdBindIndexBuffer(buffer, index.buffer, 0, VK_INDEX_TYPE_UINT32); 
 }
 
 void Adren::GUI::draw(VkCommandBuffer& commandBuffer) { 
@@ -19,34 +19,50 @@
 namespace Adren {
 class GUI {
 public:
-    GUI(Devices* devices, Buffers& buffers, Images& images, Swapchain& swapchain, VkInstance& instance) : buffers(buffers), images(images), swapchain(swapchain), 
-        instance(instance), device(devices->getDevice()), graphicsQueue(devices->getGraphicsQ()), gpu(devices->getGPU()), allocator(devices->getAllocator()) {}
+    GUI(Devices* devices, Buffers& buffers, Images& images, Swapchain& swapchain, VkInstance& instance, DeletionQueue& deletion) : buffers(buffers), 
+        images(images), swapchain(swapchain), instance(instance), device(devices->getDevice()), graphicsQueue(devices->getGraphicsQ()), gpu(devices->getGPU()), 
+        allocator(devices->getAllocator()), deletion(deletion) {}
 
-    void init(Camera& camera, GLFWwindow* window, VkSurfaceKHR& surface);
+    // Creates a viewport target for each of the frameCount frames in flight. Targets replaced by a resize are destroyed
+    // frameCount frames later, see DeletionQueue.
+    void init(Camera& camera, GLFWwindow* window, VkSurfaceKHR& surface, VkPipelineCache pipelineCache, uint32_t frameCount);
     void cleanup();
     void mouseHandler(GLFWwindow* window, Camera& camera);
     void newFrame(GLFWwindow* window, Camera& camera);
     void viewport(Camera& camera);
-    void beginRenderpass(Camera& camera, VkCommandBuffer& buffer, VkPipeline& pipeline, Buffer& vertex, Buffer& index);
+    void beginRenderpass(Camera& camera, VkCommandBuffer& buffer, VkPipeline& pipeline, Buffer& vertex);
     void draw(VkCommandBuffer& commandBuffer);
 
+    // What the viewport renders into. Each frame in flight has its own, so a frame never draws over the image
+    // the GUI of an earlier frame is still sampling.
+    struct Target {
+        Image color, depth;
+        VkFramebuffer framebuffer;
+        VkDescriptorSet set; // The color image registered with ImGui.
+    };
+
     struct Base {
         VkRenderPass renderpass;
         VkCommandPool commandPool;
-        Image color, depth;
-        VkFramebuffer framebuffer;
-        VkDescriptorSet set;
+        std::vector<Target> targets;
         VkImageView view;
         VkSampler sampler;
     } base{};
 
+    // The frame in flight the next viewport and beginRenderpass use, the renderer sets it before each frame.
+    uint32_t frame = 0;
+
+    // The depth of every target, the depth pyramid reads them.
+    std::vector<VkImageView> depthViews() const;
+
     ImGuiContext* ctx = nullptr;
     ImGuiStyle* style = nullptr;
 private:
     void createCommands();
     void createSampler();
-    void createRenderPass(Camera& camera);
-    void createFramebuffers(Camera& camera);
+    void createTargets(Camera& camera);
+    void destroyTargets(const std::vector<Target>& targets);
+    void createRenderPass();
     void resize(ImVec2& size, Camera& camera);
     void createDescriptorPool();
     
@@ -60,5 +76,7 @@ private:
     QueueFamilyIndices queueFam;
     VkPhysicalDevice& gpu;
     VmaAllocator& allocator;
+    DeletionQueue& deletion;
+    uint32_t framesInFlight = 0;
 };
 }
@@ -0,0 +1,153 @@
+/*
+    hotreload.cpp
+    Adrenaline Engine
+
+    Definitions for shader hot reloading.
+*/
+
+#include "hotreload.h"
+#include <iostream>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+void Adren::HotReload::start(const std::filesystem::path& directory) {
+    if (!enabled || worker.joinable()) return;
+
+    this->directory = directory;
+    stopping = false;
+    worker = std::thread(&HotReload::work, this);
+}
+
+void Adren::HotReload::note(const std::string& name) {
+    if (std::filesystem::path(name).extension() != ".spv") return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    written[name] = std::chrono::steady_clock::now();
+}
+
+std::vector<std::string> Adren::HotReload::changed() {
+    std::vector<std::string> names;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (written.empty()) return names;
+
+    // Nothing is handed out while any file is still being written, a rebuild would otherwise see half of them.
+    auto now = std::chrono::steady_clock::now();
+    for (auto& [name, time] : written) {
+        if (now - time < settleTime) return names;
+    }
+
+    for (auto& [name, time] : written) {
+        names.push_back(name);
+    }
+
+    written.clear();
+    return names;
+}
+
+void Adren::HotReload::run(std::function<void()> build, std::function<void()> apply) {
+    auto job = std::make_unique<Job>();
+    job->build = std::move(build);
+    job->apply = std::move(apply);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    queue.push_back(std::move(job));
+}
+
+void Adren::HotReload::update() {
+    std::deque<std::unique_ptr<Job>> done;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done.swap(finished);
+    }
+
+    for (auto& job : done) {
+        job->apply();
+    }
+}
+
+void Adren::HotReload::work() {
+#ifdef __linux__
+    int watch = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch < 0 || inotify_add_watch(watch, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        std::cerr << "-> Hot reload: can't watch " << directory.string() << std::endl;
+    }
+#else
+    std::unordered_map<std::string, std::filesystem::file_time_type> times;
+    std::error_code error;
+    for (auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        times[entry.path().filename().string()] = entry.last_write_time(error);
+    }
+#endif
+
+    while (true) {
+        std::unique_ptr<Job> job;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) break;
+
+            if (!queue.empty()) {
+                job = std::move(queue.front());
+                queue.pop_front();
+            }
+        }
+
+        if (job) {
+            job->build();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            finished.push_back(std::move(job));
+            continue;
+        }
+
+        // Waiting on the directory doubles as the sleep between checks for jobs and for stopping.
+#ifdef __linux__
+        pollfd descriptor{ watch, POLLIN, 0 };
+        if (watch < 0 || poll(&descriptor, 1, 100) <= 0) {
+            if (watch < 0) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            continue;
+        }
+
+        alignas(inotify_event) char buffer[4096];
+        ssize_t length;
+        while ((length = read(watch, buffer, sizeof(buffer))) > 0) {
+            for (char* event = buffer; event < buffer + length;) {
+                inotify_event* info = reinterpret_cast<inotify_event*>(event);
+                if (info->len > 0) note(info->name);
+                event += sizeof(inotify_event) + info->len;
+            }
+        }
+#else
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        for (auto& entry : std::filesystem::directory_iterator(directory, error)) {
+            std::string name = entry.path().filename().string();
+            auto time = entry.last_write_time(error);
+            if (error) continue;
+
+            auto found = times.find(name);
+            if (found == times.end() || found->second != time) {
+                times[name] = time;
+                note(name);
+            }
+        }
+#endif
+    }
+
+#ifdef __linux__
+    if (watch >= 0) close(watch);
+#endif
+}
+
+void Adren::HotReload::cleanup() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        queue.clear();
+    }
+
+    if (worker.joinable()) worker.join();
+    update();
+}
@@ -0,0 +1,59 @@
+/*
+	hotreload.h
+	Adrenaline Engine
+
+	This watches the shader directory for recompiled .spv files and rebuilds what uses them on a worker thread.
+	Rebuilt pipelines are only swapped in by update, between frames, so the frames in flight keep the ones they recorded.
+*/
+
+#pragma once
+#include <thread>
+#include <mutex>
+#include <deque>
+#include <memory>
+#include <chrono>
+#include <functional>
+#include <filesystem>
+#include <unordered_map>
+
+namespace Adren {
+class HotReload {
+public:
+	// Starts watching directory, inotify on Linux and polling modification times elsewhere.
+	void start(const std::filesystem::path& directory);
+
+	// Names of the .spv files written since the last call that have stayed untouched for settleTime, so the files
+	// shaders.bat writes one after another arrive together.
+	std::vector<std::string> changed();
+
+	// Runs build on the worker, then apply on the render thread in the first update after build has returned.
+	void run(std::function<void()> build, std::function<void()> apply);
+
+	// Called once per frame after the fence wait, applies every finished job in the order they were queued.
+	void update();
+
+	// Stops the worker. Finished jobs are applied, queued ones dropped.
+	void cleanup();
+
+	bool enabled = true;
+	std::chrono::milliseconds settleTime{ 200 };
+private:
+	struct Job {
+		std::function<void()> build;
+		std::function<void()> apply;
+	};
+
+	void work();
+	void note(const std::string& name);
+
+	std::filesystem::path directory;
+	std::unordered_map<std::string, std::chrono::steady_clock::time_point> written; // Name to the last write.
+
+	std::deque<std::unique_ptr<Job>> queue;
+	std::deque<std::unique_ptr<Job>> finished;
+
+	std::thread worker;
+	std::mutex mutex;
+	bool stopping = false;
+};
+}
@@ -7,21 +7,22 @@
 
 #include "images.h"
 #include "tools.h"
-#include <stb/stb_image.h>
+#include <cmath>
+#include <fstream>
 
 #ifdef ADREN_DEBUG
 #include "debugger.h"
 #endif
 
 namespace Adren {
-void Images::createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VmaMemoryUsage vmaUsage, Image& image) {
+void Images::createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VmaMemoryUsage vmaUsage, Image& image, uint32_t mipLevels) {
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     imageInfo.imageType = VK_IMAGE_TYPE_2D;
     imageInfo.extent.width = width;
     imageInfo.extent.height = height;
     imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = 1;
+    imageInfo.mipLevels = mipLevels;
     imageInfo.arrayLayers = 1;
     imageInfo.format = format;
     imageInfo.tiling = tiling;
@@ -37,7 +38,7 @@ void Images::createImage(uint32_t width, uint32_t height, VkFormat format, VkIma
     vmaCreateImage(allocator, &imageInfo, &allocInfo, &image.image, &image.memory, nullptr);
 }
 
-VkImageView Images::createImageView(VkImage& image, VkFormat format, VkImageAspectFlags aspectFlags) {
+VkImageView Images::createImageView(VkImage& image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels) {
     VkImageViewCreateInfo viewInfo{};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     viewInfo.image = image;
@@ -45,7 +46,7 @@ VkImageView Images::createImageView(VkImage& image, VkFormat format, VkImageAspe
     viewInfo.format = format;
     viewInfo.subresourceRange.aspectMask = aspectFlags;
     viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.levelCount = mipLevels;
     viewInfo.subresourceRange.baseArrayLayer = 0;
     viewInfo.subresourceRange.layerCount = 1;
 
@@ -55,9 +56,7 @@ VkImageView Images::createImageView(VkImage& image, VkFormat format, VkImageAspe
     return imageView;
 }
 
-void Images::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, VkCommandPool& commandPool) {
-    VkCommandBuffer commandBuffer = Tools::beginSingleTimeCommands(device, commandPool);
-
+void Images::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, VkCommandBuffer commandBuffer, uint32_t mipLevels) {
     VkImageMemoryBarrier barrier{};
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
     barrier.oldLayout = oldLayout;
@@ -67,7 +66,7 @@ void Images::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout
     barrier.image = image;
     barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.levelCount = mipLevels;
     barrier.subresourceRange.baseArrayLayer = 0;
     barrier.subresourceRange.layerCount = 1;
 
@@ -93,60 +92,509 @@ void Images::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout
     }
 
     vkCmdPipelineBarrier(commandBuffer, sourceStage, destinationStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-    Adren::Tools::endSingleTimeCommands(commandBuffer, device, graphicsQueue, commandPool);
 }
 
-void Images::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, VkCommandPool& commandPool) {
-    VkCommandBuffer commandBuffer = Tools::beginSingleTimeCommands(device, commandPool);
+void Images::copyBufferToImage(VkBuffer buffer, VkDeviceSize offset, VkImage image, uint32_t width, uint32_t height, const std::vector<VkDeviceSize>& levels, VkCommandBuffer commandBuffer) {
+    // One region per mip level, every level is half the size of the one before it.
+    std::vector<VkBufferImageCopy> regions(levels.size());
+    for (uint32_t level = 0; level < regions.size(); level++) {
+        VkBufferImageCopy& region = regions[level];
+        region.bufferOffset = offset + levels[level];
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = level;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = { 0, 0, 0 };
+        region.imageExtent = { std::max(width >> level, 1u), std::max(height >> level, 1u), 1 };
+    }
+
+    vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+}
 
-    VkBufferImageCopy region{};
-    region.bufferOffset = 0;
-    region.bufferRowLength = 0;
-    region.bufferImageHeight = 0;
-    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
-    region.imageOffset = { 0, 0, 0 };
-    region.imageExtent = { width, height, 1 };
+bool Images::formatSupported(VkFormat format) {
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(gpu, format, &props);
+    return (props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
 
-    vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+bool Images::canGenerateMipmaps(VkFormat format) {
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(gpu, format, &props);
 
-    Adren::Tools::endSingleTimeCommands(commandBuffer, device, graphicsQueue, commandPool);
+    VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (props.optimalTilingFeatures & needed) == needed;
 }
 
-void Images::loadTextures(VkInstance& instance, std::vector<Model*>& models, std::vector<Model::Texture>& textures, VkCommandPool& commandPool) {
-    for (Model* model : models) {
-        for (Model::glTFImage& image : model->images) {
-            Model::Texture texture{};
+// Every level is blitted down from the one above it. Blits filter sRGB formats in linear space,
+// so the mips of color textures don't darken.
+void Images::generateMipmaps(VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels, VkCommandBuffer commandBuffer) {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.subresourceRange.levelCount = 1;
+
+    int32_t mipWidth = static_cast<int32_t>(width);
+    int32_t mipHeight = static_cast<int32_t>(height);
+
+    for (uint32_t level = 1; level < mipLevels; level++) {
+        barrier.subresourceRange.baseMipLevel = level - 1;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
 
-            Buffer staging;
-            buffers.createBuffer(allocator, image.bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging, VMA_MEMORY_USAGE_AUTO);
+        int32_t nextWidth = std::max(mipWidth / 2, 1);
+        int32_t nextHeight = std::max(mipHeight / 2, 1);
 
-            uint8_t* data;
-            vmaMapMemory(allocator, staging.memory, (void**)&data);
-            memcpy(data, image.buffer, image.bufferSize);
-            vmaUnmapMemory(allocator, staging.memory);
+        VkImageBlit blit{};
+        blit.srcOffsets[0] = { 0, 0, 0 };
+        blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
+        blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1 };
+        blit.dstOffsets[0] = { 0, 0, 0 };
+        blit.dstOffsets[1] = { nextWidth, nextHeight, 1 };
+        blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
 
-            createImage(image.width, image.height, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT |
-                VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VMA_MEMORY_USAGE_AUTO, texture);
-            transitionImageLayout(texture.image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, commandPool);
-            copyBufferToImage(staging.buffer, texture.image, static_cast<uint32_t>(image.width), static_cast<uint32_t>(image.height), commandPool);
-            transitionImageLayout(texture.image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, commandPool);
+        vkCmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
-            vmaDestroyBuffer(allocator, staging.buffer, staging.memory);
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        mipWidth = nextWidth;
+        mipHeight = nextHeight;
+    }
+
+    // The last level was only written to.
+    barrier.subresourceRange.baseMipLevel = mipLevels - 1;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+bool Images::compressImage(Model::glTFImage& image) {
+    bool srgb = image.format == VK_FORMAT_R8G8B8A8_SRGB;
+    if (image.failed || image.levels.size() != 1 || (!srgb && image.format != VK_FORMAT_R8G8B8A8_UNORM)) return false;
+
+    Bcn::Format format = Bcn::Format::BC7;
+    if (image.role == Model::ImageRole::Normal) {
+        format = Bcn::Format::BC5;
+    } else if (image.role == Model::ImageRole::Mask) {
+        format = Bcn::Format::BC4;
+    } else if (compressionQuality == Bcn::Quality::Fast) {
+        bool opaque = true;
+        for (size_t i = 3; i < image.pixels.size() && opaque; i += 4) opaque = image.pixels[i] == 255;
+        format = opaque ? Bcn::Format::BC1 : Bcn::Format::BC3;
+    }
 
-            texture.view = createImageView(texture.image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
-            textures.push_back(texture);
-            stbi_image_free(image.buffer);
+    VkFormat vkFormat = Bcn::vkFormat(format, srgb);
+    if (!formatSupported(vkFormat)) return false;
+
+    Bcn::Result result = Bcn::compress(image.pixels.data(), static_cast<uint32_t>(image.width), static_cast<uint32_t>(image.height),
+        format, srgb, compressionQuality);
 
 #ifdef ADREN_DEBUG
-            Adren::Debugger::label(instance, device, VK_OBJECT_TYPE_IMAGE, (uint64_t)texture.image, "TEXTURE IMAGE");
-            Adren::Debugger::label(instance, device, VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)texture.view, "TEXTURE IMAGE VIEW");
+    std::cerr << "-> " << image.width << "x" << image.height << " image compressed to " << Bcn::name(format) << ", PSNR " << result.psnr << " dB" << std::endl;
 #endif
+
+    image.pixels = std::move(result.data);
+    image.levels = std::move(result.levels);
+    image.format = vkFormat;
+    image.psnr = result.psnr;
+    return true;
+}
+
+// Brings a decoded image to what gets sampled. Images with mips drop their largest levels to fit maxTextureDimension,
+// plain RGBA8 images are halved instead and then block compressed, or given a CPU mip chain when they go to the cache.
+void Images::cookImage(Model::glTFImage& image) {
+    if (image.failed) return;
+
+    bool srgb = image.format == VK_FORMAT_R8G8B8A8_SRGB;
+    bool rgba = srgb || image.format == VK_FORMAT_R8G8B8A8_UNORM;
+
+    auto tooLarge = [&]() {
+        return maxTextureDimension > 0 && static_cast<uint32_t>(std::max(image.width, image.height)) > maxTextureDimension;
+    };
+
+    while (tooLarge() && image.levels.size() > 1) {
+        VkDeviceSize dropped = image.levels[1];
+        image.pixels.erase(image.pixels.begin(), image.pixels.begin() + dropped);
+        image.levels.erase(image.levels.begin());
+        for (VkDeviceSize& level : image.levels) level -= dropped;
+
+        image.width = std::max(image.width / 2, 1);
+        image.height = std::max(image.height / 2, 1);
+    }
+
+    if (!rgba || image.levels.size() != 1) return;
+
+    while (tooLarge()) {
+        image.pixels = Bcn::downsample(image.pixels, static_cast<uint32_t>(image.width), static_cast<uint32_t>(image.height), srgb);
+        image.width = std::max(image.width / 2, 1);
+        image.height = std::max(image.height / 2, 1);
+    }
+
+    if (compressTextures && compressImage(image)) return;
+    if (!cookTextures) return;
+
+    // Without a cache the GPU blits the mips, which is cheaper than building them here.
+    std::vector<unsigned char> level = image.pixels;
+    uint32_t width = static_cast<uint32_t>(image.width), height = static_cast<uint32_t>(image.height);
+    while (width > 1 || height > 1) {
+        level = Bcn::downsample(level, width, height, srgb);
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+
+        image.levels.push_back(image.pixels.size());
+        image.pixels.insert(image.pixels.end(), level.begin(), level.end());
+    }
+}
+
+// Everything that changes what cookImage produces is part of the key, so changing a setting cooks again.
+// The role also decides whether plain images are sRGB.
+uint64_t Images::cookKey(const Model::glTFImage& image) {
+    const uint32_t settings[] = {
+        Cook::version,
+        static_cast<uint32_t>(image.role),
+        compressTextures,
+        static_cast<uint32_t>(compressionQuality),
+        maxTextureDimension,
+        formatSupported(VK_FORMAT_BC7_SRGB_BLOCK),
+    };
+
+    return Cook::hash(settings, sizeof(settings), image.hash);
+}
+
+std::filesystem::path Images::cookPath(uint64_t key) {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.adtx", static_cast<unsigned long long>(key));
+    return cookDirectory / name;
+}
+
+// A cooked file that matches wins, otherwise the image is decoded and cooked here and written for the next load.
+bool Images::prepareImage(TextureLoad& load, Model::glTFImage& image, const std::vector<uint8_t>& source) {
+    load.key = cookKey(image);
+
+    if (cookTextures && !source.empty() && load.file.open(cookPath(load.key)) && Cook::read(load.file, load.key, load.cookedTexture) &&
+        formatSupported(load.cookedTexture.format)) {
+        image.width = static_cast<int>(load.cookedTexture.width);
+        image.height = static_cast<int>(load.cookedTexture.height);
+        image.format = load.cookedTexture.format;
+        image.levels = load.cookedTexture.levels;
+        image.psnr = load.cookedTexture.psnr;
+        image.size = load.cookedTexture.size;
+        load.cooked = true;
+        return true;
+    }
+
+    load.file.close();
+    Model::decodeImage(image, source);
+    cookImage(image);
+
+    // Block compressed formats the GPU can't sample fail like images that don't decode.
+    if (!image.failed && !formatSupported(image.format)) {
+        std::cerr << "-> Image format " << image.format << " is not supported by the GPU" << std::endl;
+        image.failed = true;
+    }
+
+    if (image.failed) return false;
+
+    image.size = image.pixels.size();
+    load.written = cookTextures && !source.empty() && Cook::write(cookPath(load.key), load.key, image);
+    return true;
+}
+
+void Images::prepareTexture(TextureLoad& load) {
+    if (load.resident || load.source == nullptr) return;
+    if (prepareImage(load, load.work, *load.source)) return;
+
+    // Failed images keep their slot with a single white texel.
+    load.work.pixels = { 255, 255, 255, 255 };
+    load.work.width = 1;
+    load.work.height = 1;
+    load.work.format = VK_FORMAT_R8G8B8A8_SRGB;
+    load.work.levels = { 0 };
+    load.work.size = load.work.pixels.size();
+    load.work.failed = true;
+}
+
+// Nothing waits for the copies, so the ring only hands out bytes behind the head that no unfinished copy reads.
+// False when there are none, the caller stages somewhere else or tries again later.
+bool Images::stage(const uint8_t* data, VkDeviceSize size, VkDeviceSize& offset) {
+    if (stagingRing.buffer == VK_NULL_HANDLE) {
+        stagingRing.size = stagingRingSize;
+        buffers.createBuffer(allocator, stagingRing.size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingRing, VMA_MEMORY_USAGE_AUTO);
+        vmaMapMemory(allocator, stagingRing.memory, &stagingRing.mapped);
+    }
+
+    if (size > stagingRing.size) return false;
+
+    offset = (stagingHead + 15) & ~VkDeviceSize(15);
+    if (staged.empty()) {
+        offset = 0;
+    } else if (stagingHead > staged.front().offset) {
+        // The bytes in use don't wrap, the ring is free after the head and before the oldest copy.
+        if (offset + size > stagingRing.size) {
+            if (size > staged.front().offset) return false;
+            offset = 0;
         }
+    } else if (offset + size > staged.front().offset) {
+        return false;
+    }
+
+    memcpy(static_cast<uint8_t*>(stagingRing.mapped) + offset, data, size);
+    vmaFlushAllocation(allocator, stagingRing.memory, offset, size);
+    stagingHead = offset + size;
+    staged.push_back({ offset, stagingHead });
+    return true;
+}
+
+void Images::unstage(VkDeviceSize offset) {
+    for (auto it = staged.begin(); it != staged.end(); it++) {
+        if (it->offset != offset) continue;
+        staged.erase(it);
+        return;
+    }
+}
+
+uint32_t Images::firstResidentLevel(const Model::glTFImage& image) {
+    uint32_t level = 0;
+    if (residentDimension == 0) return level;
+
+    uint32_t largest = static_cast<uint32_t>(std::max(image.width, image.height));
+    while (level + 1 < image.levels.size() && (largest >> level) > residentDimension) level++;
+    return level;
+}
+
+Model::Texture Images::uploadImage(const uint8_t* data, VkDeviceSize size, uint32_t width, uint32_t height, VkFormat format,
+    const std::vector<VkDeviceSize>& levels, uint32_t firstLevel, VkCommandBuffer commandBuffer, std::function<void()>& retire) {
+    Model::Texture texture{};
+    texture.format = format;
+
+    // Levels before firstLevel stay behind, the rest move up as if the image started there.
+    std::vector<VkDeviceSize> resident(levels.begin() + firstLevel, levels.end());
+    for (VkDeviceSize& level : resident) level -= levels[firstLevel];
+    data += levels[firstLevel];
+    size -= levels[firstLevel];
+    width = std::max(width >> firstLevel, 1u);
+    height = std::max(height >> firstLevel, 1u);
+
+    uint32_t mipLevels = static_cast<uint32_t>(resident.size());
+
+    // Images that come without mips get a full chain, block compressed formats can't be blitted to.
+    bool generate = mipLevels == 1 && canGenerateMipmaps(format);
+    if (generate) {
+        mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+    }
+
+    // Images larger than the whole ring, or that find it full of copies still running, get a staging buffer of their own.
+    Buffer staging{};
+    VkBuffer source = stagingRing.buffer;
+    VkDeviceSize offset = 0;
+
+    if (stage(data, size, offset)) {
+        retire = [this, offset]() { unstage(offset); };
+    } else {
+        buffers.createBuffer(allocator, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging, VMA_MEMORY_USAGE_AUTO);
+
+        void* mapped;
+        vmaMapMemory(allocator, staging.memory, &mapped);
+        memcpy(mapped, data, size);
+        vmaUnmapMemory(allocator, staging.memory);
+        source = staging.buffer;
+        offset = 0;
+        retire = [allocator = allocator, staging]() { vmaDestroyBuffer(allocator, staging.buffer, staging.memory); };
+    }
+
+    // Streaming copies resident levels out of textures, blits read them too.
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    createImage(width, height, format, VK_IMAGE_TILING_OPTIMAL, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        VMA_MEMORY_USAGE_AUTO, texture, mipLevels);
+    transitionImageLayout(texture.image, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, commandBuffer, mipLevels);
+    copyBufferToImage(source, offset, texture.image, width, height, resident, commandBuffer);
+
+    if (generate) {
+        generateMipmaps(texture.image, width, height, mipLevels, commandBuffer);
+    } else {
+        transitionImageLayout(texture.image, format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, commandBuffer, mipLevels);
     }
+
+    texture.view = createImageView(texture.image, format, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
+    return texture;
+}
+
+Model::Texture Images::uploadImage(Model::glTFImage& image, uint32_t firstLevel, VkCommandBuffer commandBuffer, std::function<void()>& retire) {
+    return uploadImage(image.pixels.data(), image.pixels.size(), static_cast<uint32_t>(image.width), static_cast<uint32_t>(image.height),
+        image.format, image.levels, firstLevel, commandBuffer, retire);
+}
+
+bool Images::changeResidency(Model::glTFImage& image, const Model::Texture& texture, uint32_t from, uint32_t to, Model::Texture& result, VkCommandBuffer commandBuffer) {
+    uint32_t levelCount = static_cast<uint32_t>(image.levels.size());
+    if (from >= levelCount || to >= levelCount || from == to) return false;
+
+    // Levels that don't fit the ring at once are left for a smaller step.
+    if (to < from && image.levels[from] - image.levels[to] > (stagingRing.buffer != VK_NULL_HANDLE ? stagingRing.size : stagingRingSize)) return false;
+
+    // Finer levels need their texels from the CPU, the cooked file stays mapped until they are staged.
+    Cook::File file;
+    Cook::Texture cooked;
+    const uint8_t* data = image.pixels.empty() ? nullptr : image.pixels.data();
+    if (to < from && data == nullptr) {
+        if (image.cookedKey == 0 || !file.open(cookPath(image.cookedKey)) || !Cook::read(file, image.cookedKey, cooked) || cooked.levels != image.levels) return false;
+        data = cooked.data;
+    }
+
+    // A ring busy with copies that haven't finished leaves the step for a later frame.
+    VkDeviceSize offset = 0;
+    if (to < from && !stage(data + image.levels[to], image.levels[from] - image.levels[to], offset)) return false;
+
+    uint32_t width = std::max(static_cast<uint32_t>(image.width) >> to, 1u);
+    uint32_t height = std::max(static_cast<uint32_t>(image.height) >> to, 1u);
+    uint32_t mipLevels = levelCount - to;
+
+    result = {};
+    result.format = image.format;
+    createImage(width, height, image.format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
+        VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VMA_MEMORY_USAGE_AUTO, result, mipLevels);
+
+    std::vector<VkBufferImageCopy> uploads;
+    if (to < from) {
+        for (uint32_t level = to; level < from; level++) {
+            VkBufferImageCopy region{};
+            region.bufferOffset = offset + image.levels[level] - image.levels[to];
+            region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - to, 0, 1 };
+            region.imageExtent = { std::max(static_cast<uint32_t>(image.width) >> level, 1u), std::max(static_cast<uint32_t>(image.height) >> level, 1u), 1 };
+            uploads.push_back(region);
+        }
+    }
+
+    std::vector<VkImageCopy> copies;
+    for (uint32_t level = std::max(from, to); level < levelCount; level++) {
+        VkImageCopy region{};
+        region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - from, 0, 1 };
+        region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - to, 0, 1 };
+        region.extent = { std::max(static_cast<uint32_t>(image.width) >> level, 1u), std::max(static_cast<uint32_t>(image.height) >> level, 1u), 1 };
+        copies.push_back(region);
+    }
+
+    auto barrier = [&](VkImage target, uint32_t levels, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+        VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage) {
+        VkImageMemoryBarrier imageBarrier{};
+        imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        imageBarrier.oldLayout = oldLayout;
+        imageBarrier.newLayout = newLayout;
+        imageBarrier.srcAccessMask = srcAccess;
+        imageBarrier.dstAccessMask = dstAccess;
+        imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.image = target;
+        imageBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levels, 0, 1 };
+        vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+    };
+
+    // Frames recorded before every descriptor set has the new view still sample the old texture, so it goes back to being read only.
+    // The barriers order the copy after the fragment shaders of the frames submitted before this one.
+    uint32_t oldLevels = levelCount - from;
+    barrier(result.image, mipLevels, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    barrier(texture.image, oldLevels, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_SHADER_READ_BIT,
+        VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    if (!uploads.empty()) {
+        vkCmdCopyBufferToImage(commandBuffer, stagingRing.buffer, result.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(uploads.size()), uploads.data());
+    }
+
+    vkCmdCopyImage(commandBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, result.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        static_cast<uint32_t>(copies.size()), copies.data());
+
+    barrier(texture.image, oldLevels, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT,
+        VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    barrier(result.image, mipLevels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+    if (!uploads.empty()) deletion.push(frameCount, [this, offset]() { unstage(offset); });
+
+    result.view = createImageView(result.image, image.format, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
+    return true;
+}
+
+Model::Texture Images::finishTexture(VkInstance& instance, TextureLoad& load, VkCommandBuffer commandBuffer) {
+    Model::glTFImage& image = load.model->images[load.image];
+    Model::Texture texture{};
+
+    // The bytes, their hash and the role stay with the model image, the rest is what the loader thread made.
+    if (!load.resident) {
+        image.pixels = std::move(load.work.pixels);
+        image.width = load.work.width;
+        image.height = load.work.height;
+        image.format = load.work.format;
+        image.levels = std::move(load.work.levels);
+        image.size = load.work.size;
+        image.failed = load.work.failed;
+        image.psnr = load.work.psnr;
+        image.cookedKey = load.cooked || load.written ? load.key : 0;
+    }
+
+    std::function<void()> retire;
+    if (load.cooked) {
+        texture = uploadImage(load.cookedTexture.data, load.cookedTexture.size, load.cookedTexture.width, load.cookedTexture.height,
+            load.cookedTexture.format, load.cookedTexture.levels, firstResidentLevel(image), commandBuffer, retire);
+        load.file.close();
+    } else {
+        image.size = image.pixels.size();
+        texture = uploadImage(image, image.failed ? 0 : firstResidentLevel(image), commandBuffer, retire);
+    }
+
+    // The staging bytes are read until the frame the upload is recorded into has finished.
+    deletion.push(frameCount, std::move(retire));
+
+    // Pixels are only in memory between decoding and cooking, or for good when nothing gets written to disk.
+    if (load.written) {
+        image.pixels.clear();
+        image.pixels.shrink_to_fit();
+    }
+
+#ifdef ADREN_DEBUG
+    Adren::Debugger::label(instance, device, VK_OBJECT_TYPE_IMAGE, (uint64_t)texture.image, "TEXTURE IMAGE");
+    Adren::Debugger::label(instance, device, VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)texture.view, "TEXTURE IMAGE VIEW");
+#endif
+
+    return texture;
+}
+
+void Images::createPlaceholder(const char* path, VkCommandPool& commandPool) {
+    Model::glTFImage image{};
+    std::ifstream stream(path, std::ios::binary | std::ios::ate);
+    if (stream.is_open()) {
+        image.source.resize(static_cast<size_t>(stream.tellg()));
+        stream.seekg(0);
+        stream.read(reinterpret_cast<char*>(image.source.data()), image.source.size());
+    }
+
+    // A missing file still leaves the white texel.
+    Model::decodeImage(image, image.source);
+
+    std::function<void()> retire;
+    VkCommandBuffer commandBuffer = Tools::beginSingleTimeCommands(device, commandPool);
+    placeholder = uploadImage(image, 0, commandBuffer, retire);
+    Adren::Tools::endSingleTimeCommands(commandBuffer, device, graphicsQueue, commandPool, deletion, std::move(retire));
+    placeholder.index = -1;
 }
 
 void Images::createDepthResources(VkExtent2D extent) {
@@ -172,6 +620,14 @@ void Images::createDepthResources(VkExtent2D extent) {
 
 void Images::cleanup() {
     vmaDestroyImage(allocator, depth.image, depth.memory);
+    vkDestroyImageView(device, placeholder.view, nullptr);
+    vmaDestroyImage(allocator, placeholder.image, placeholder.memory);
+
+    if (stagingRing.buffer != VK_NULL_HANDLE) {
+        vmaUnmapMemory(allocator, stagingRing.memory);
+        vmaDestroyBuffer(allocator, stagingRing.buffer, stagingRing.memory);
+        stagingRing = {};
+    }
 }
 
 }
\ No newline at end of file
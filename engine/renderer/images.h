@@ -9,27 +9,110 @@
 #include "model.h"
 #include "types.h"
 #include "buffers.h"
+#include "bcn.h"
+#include "cook.h"
+#include "deletion.h"
+#include <deque>
+#include <functional>
+#include <filesystem>
+#include <string>
 
 namespace Adren {
 class Images {
 public:
-	Images(Devices* devices, Buffers& buffers) : device(devices->getDevice()), buffers(buffers), 
-		gpu(devices->getGPU()), graphicsQueue(devices->getGraphicsQ()), allocator(devices->getAllocator()) {}
+	Images(Devices* devices, Buffers& buffers, DeletionQueue& deletion, uint32_t frameCount) : device(devices->getDevice()), buffers(buffers), 
+		gpu(devices->getGPU()), graphicsQueue(devices->getGraphicsQ()), allocator(devices->getAllocator()), deletion(deletion), frameCount(frameCount) {}
 
 	void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, 
-		VkMemoryPropertyFlags properties, VmaMemoryUsage vmaUsage, Image& image);
-	VkImageView createImageView(VkImage& image, VkFormat format, VkImageAspectFlags aspectFlags);
-	void loadTextures(VkInstance& instance, std::vector<Model*>& models, std::vector<Model::Texture>& textures, VkCommandPool& commandPool);
+		VkMemoryPropertyFlags properties, VmaMemoryUsage vmaUsage, Image& image, uint32_t mipLevels = 1);
+	VkImageView createImageView(VkImage& image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels = 1);
+	bool formatSupported(VkFormat format);
+	void createPlaceholder(const char* path, VkCommandPool& commandPool);
 	void createDepthResources(VkExtent2D extent);
 	void cleanup();
 	Image depth = {};
+
+	// Bound in every slot of the texture array until its image is loaded, it is shared and never swapped out.
+	Model::Texture placeholder{};
+
+	// Loading an image is split in two. prepareTexture does the CPU work, reading the cooked file or decoding and
+	// cooking, and only touches the load so it runs on the loader thread. finishTexture hands the result to the model
+	// image and records its upload into commandBuffer, the frame command buffer, on the thread that owns the queue.
+	struct TextureLoad {
+		Model* model = nullptr;
+		uint32_t image = 0;   // In the model.
+		uint32_t texture = 0; // In the global texture array.
+		std::string name;
+
+		// Copies of the model images without their bytes, the bytes stay in the model and are only read.
+		Model::glTFImage work;
+		const std::vector<uint8_t>* source = nullptr;
+
+		bool resident = false; // The model image still has its pixels, there is nothing to prepare.
+		bool cooked = false;   // The levels are in file, mapped until the upload.
+		bool written = false;  // The pixels were cooked to disk and go once they are uploaded.
+		uint64_t key = 0;
+		Cook::File file;
+		Cook::Texture cookedTexture;
+	};
+
+	void prepareTexture(TextureLoad& load);
+	Model::Texture finishTexture(VkInstance& instance, TextureLoad& load, VkCommandBuffer commandBuffer);
+
+	// Plain RGBA8 images are block compressed by their role when the GPU samples the format. Fast picks BC1 and BC3
+	// for color, the other qualities BC7. Compressed images keep their pixels, so reloading a scene encodes nothing.
+	bool compressTextures = true;
+	Bcn::Quality compressionQuality = Bcn::Quality::Normal;
+
+	// Cooked images are written to cookDirectory with their whole mip chain and mapped straight into the staging
+	// ring on later loads. Larger images are halved until they fit maxTextureDimension, 0 keeps every size.
+	bool cookTextures = true;
+	std::filesystem::path cookDirectory = "cache/textures";
+	uint32_t maxTextureDimension = 0;
+	VkDeviceSize stagingRingSize = 64ull << 20; // Read when the ring is first needed.
+
+	// Images with mips start with only the levels at most this large on the GPU, Streaming brings in the rest.
+	// 0 uploads every level.
+	uint32_t residentDimension = 128;
+	uint32_t firstResidentLevel(const Model::glTFImage& image);
+
+	// Recreates a texture whose largest level is from with to as its largest level. Levels both hold are copied on the
+	// GPU, finer ones come from the pixels or the cooked file of the image. The copies are recorded into the frame
+	// commandBuffer ahead of its passes, so they run after the frames before it are done sampling the old texture.
+	bool changeResidency(Model::glTFImage& image, const Model::Texture& texture, uint32_t from, uint32_t to, Model::Texture& result, VkCommandBuffer commandBuffer);
 private:
-	void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, VkCommandPool& commandPool);
-	void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, VkCommandPool& commandPool);
+	void copyBufferToImage(VkBuffer buffer, VkDeviceSize offset, VkImage image, uint32_t width, uint32_t height, const std::vector<VkDeviceSize>& levels, VkCommandBuffer commandBuffer);
+	void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, VkCommandBuffer commandBuffer, uint32_t mipLevels = 1);
+	bool compressImage(Model::glTFImage& image);
+	void cookImage(Model::glTFImage& image);
+	uint64_t cookKey(const Model::glTFImage& image);
+	std::filesystem::path cookPath(uint64_t key);
+	bool prepareImage(TextureLoad& load, Model::glTFImage& image, const std::vector<uint8_t>& source);
+	bool stage(const uint8_t* data, VkDeviceSize size, VkDeviceSize& offset);
+	void unstage(VkDeviceSize offset);
+
+	// Records the upload into commandBuffer. retire releases the staging bytes, the caller runs it once commandBuffer has finished.
+	Model::Texture uploadImage(const uint8_t* data, VkDeviceSize size, uint32_t width, uint32_t height, VkFormat format,
+		const std::vector<VkDeviceSize>& levels, uint32_t firstLevel, VkCommandBuffer commandBuffer, std::function<void()>& retire);
+	Model::Texture uploadImage(Model::glTFImage& image, uint32_t firstLevel, VkCommandBuffer commandBuffer, std::function<void()>& retire);
+	void generateMipmaps(VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels, VkCommandBuffer commandBuffer);
+	bool canGenerateMipmaps(VkFormat format);
 	VkDevice& device;
 	VkPhysicalDevice& gpu;
 	VkQueue& graphicsQueue;
 	Buffers& buffers;
 	VmaAllocator& allocator;
+	DeletionQueue& deletion;
+	uint32_t frameCount; // Frames in flight, how long staging recorded into a frame stays in use.
+
+	// The ring bytes copies that haven't finished read from, oldest first.
+	struct Staged {
+		VkDeviceSize offset;
+		VkDeviceSize end;
+	};
+
+	Buffer stagingRing{};
+	VkDeviceSize stagingHead = 0;
+	std::deque<Staged> staged;
 };
 }
\ No newline at end of file
@@ -189,11 +189,11 @@ inline VkDescriptorSetLayoutBinding uboLayoutBinding(VkDescriptorType type, VkSh
     };
 }
 
-inline VkDescriptorSetLayoutBinding samplerLayoutBinding() {
+inline VkDescriptorSetLayoutBinding samplerLayoutBinding(uint32_t count) {
     return VkDescriptorSetLayoutBinding {
-        .binding = 2,
+        .binding = 0,
         .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER,
-        .descriptorCount = 1,
+        .descriptorCount = count,
         .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
         .pImmutableSamplers = 0
     };
@@ -201,7 +201,7 @@ inline VkDescriptorSetLayoutBinding samplerLayoutBinding() {
 
 inline VkDescriptorSetLayoutBinding textureLayoutBinding(uint32_t count) {
     return VkDescriptorSetLayoutBinding {
-        .binding = 3,
+        .binding = 1,
         .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
         .descriptorCount = count,
         .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
@@ -222,6 +222,8 @@ inline VkSamplerCreateInfo samplerInfo() {
         .maxAnisotropy = 16.0f,
         .compareEnable = VK_FALSE,
         .compareOp = VK_COMPARE_OP_ALWAYS,
+        .minLod = 0.0f,
+        .maxLod = VK_LOD_CLAMP_NONE, // Every mip level of the textures is used.
         .borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK,
         .unnormalizedCoordinates = VK_FALSE,
     };
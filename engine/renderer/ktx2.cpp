@@ -0,0 +1,151 @@
+/*
+    ktx2.cpp
+    Adrenaline Engine
+
+    Definitions for the KTX2 reader.
+    The layout follows the KTX File Format Specification 2.0 by the Khronos Group.
+*/
+
+#include "ktx2.h"
+#include "basis.h"
+#include <cstring>
+
+namespace {
+const uint8_t identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+struct Header {
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+};
+
+// The supercompression global data follows the header, BasisLZ keeps the ETC1S codebooks in it.
+struct GlobalData {
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+
+const size_t headerSize = sizeof(Header) + sizeof(GlobalData);
+const uint32_t basisLZ = 1;
+
+// Everything read refuses without looking at the levels.
+bool check(const Header& header, std::string& error) {
+    // UASTC is stored with an undefined format too, without BasisLZ.
+    if (header.vkFormat == VK_FORMAT_UNDEFINED && header.supercompressionScheme != basisLZ) {
+        error = "UASTC payloads are not supported";
+        return false;
+    }
+
+    if (header.supercompressionScheme != 0 && header.supercompressionScheme != basisLZ) {
+        error = "supercompressed payloads other than BasisLZ are not supported";
+        return false;
+    }
+
+    if (header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1 || header.pixelHeight == 0) {
+        error = "only 2D textures are supported";
+        return false;
+    }
+
+    return true;
+}
+
+struct LevelIndex {
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+}
+
+bool Adren::Ktx2::isKtx2(const uint8_t* bytes, size_t size) {
+    return size >= sizeof(identifier) && memcmp(bytes, identifier, sizeof(identifier)) == 0;
+}
+
+bool Adren::Ktx2::read(const uint8_t* bytes, size_t size, Texture& texture, std::string& error) {
+    if (!isKtx2(bytes, size) || size < sizeof(identifier) + headerSize) {
+        error = "not a KTX2 file";
+        return false;
+    }
+
+    Header header;
+    memcpy(&header, bytes + sizeof(identifier), sizeof(Header));
+    if (!check(header, error)) return false;
+
+    // A level count of 0 asks the loader to generate the mips, the file only has the base level.
+    uint32_t levelCount = header.levelCount == 0 ? 1 : header.levelCount;
+    size_t indexOffset = sizeof(identifier) + headerSize;
+    if (size < indexOffset + levelCount * sizeof(LevelIndex)) {
+        error = "truncated level index";
+        return false;
+    }
+
+    texture.width = header.pixelWidth;
+    texture.height = header.pixelHeight;
+    texture.levels.clear();
+    texture.data.clear();
+
+    // Only the base level is transcoded, the block compressor builds the mips again from it.
+    if (header.supercompressionScheme == basisLZ) {
+        GlobalData global;
+        memcpy(&global, bytes + sizeof(identifier) + sizeof(Header), sizeof(GlobalData));
+
+        LevelIndex index;
+        memcpy(&index, bytes + indexOffset, sizeof(LevelIndex));
+
+        if (global.sgdByteOffset + global.sgdByteLength > size || index.byteOffset + index.byteLength > size) {
+            error = "BasisLZ data is out of bounds";
+            return false;
+        }
+
+        if (!Adren::Basis::transcodeEtc1s(bytes + global.sgdByteOffset, global.sgdByteLength, levelCount, 0, bytes + index.byteOffset,
+            index.byteLength, header.pixelWidth, header.pixelHeight, texture.data, error)) {
+            return false;
+        }
+
+        texture.format = VK_FORMAT_R8G8B8A8_UNORM;
+        texture.levels = { 0 };
+        texture.transcoded = true;
+        return true;
+    }
+
+    texture.format = static_cast<VkFormat>(header.vkFormat);
+    texture.transcoded = false;
+
+    for (uint32_t level = 0; level < levelCount; level++) {
+        LevelIndex index;
+        memcpy(&index, bytes + indexOffset + level * sizeof(LevelIndex), sizeof(LevelIndex));
+
+        if (index.byteOffset + index.byteLength > size) {
+            error = "level " + std::to_string(level) + " is out of bounds";
+            return false;
+        }
+
+        // 16 bytes covers every block size and the 4 byte alignment buffer to image copies need.
+        size_t offset = (texture.data.size() + 15) & ~size_t(15);
+        texture.levels.push_back(offset);
+        texture.data.resize(offset + index.byteLength);
+        memcpy(texture.data.data() + offset, bytes + index.byteOffset, index.byteLength);
+    }
+
+    return true;
+}
+
+bool Adren::Ktx2::supported(const uint8_t* bytes, size_t size) {
+    if (!isKtx2(bytes, size) || size < sizeof(identifier) + headerSize) return false;
+
+    Header header;
+    memcpy(&header, bytes + sizeof(identifier), sizeof(Header));
+
+    std::string error;
+    return check(header, error);
+}
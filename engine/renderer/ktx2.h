@@ -0,0 +1,33 @@
+/*
+	ktx2.h
+	Adrenaline Engine
+
+	This reads KTX2 containers that store a native VkFormat, with their mip levels. ETC1S payloads of
+	KHR_texture_basisu are transcoded to RGBA8, UASTC payloads aren't and those textures use their plain image.
+*/
+
+#pragma once
+#include "types.h"
+#include <vector>
+#include <string>
+
+namespace Adren::Ktx2 {
+	struct Texture {
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<VkDeviceSize> levels; // Offset of every mip level in data, largest first.
+		std::vector<uint8_t> data;
+		bool transcoded = false;          // RGBA8 from ETC1S with only the base level, the role picks sRGB.
+	};
+
+	bool isKtx2(const uint8_t* bytes, size_t size);
+
+	// Copies the levels of a 2D texture into texture.data, each one aligned for vkCmdCopyBufferToImage, or
+	// transcodes its BasisLZ base level. UASTC and Zstandard payloads and array, cube and 3D textures are
+	// refused with a reason in error.
+	bool read(const uint8_t* bytes, size_t size, Texture& texture, std::string& error);
+
+	// Whether read accepts the file, from its header alone.
+	bool supported(const uint8_t* bytes, size_t size);
+}
@@ -0,0 +1,285 @@
+/*
+    loader.cpp
+    Adrenaline Engine
+
+    Definitions for the texture loader.
+*/
+
+#include "loader.h"
+#include "cook.h"
+#include <algorithm>
+
+#ifdef ADREN_DEBUG
+#include "debugger.h"
+#endif
+
+void Adren::Loader::load(std::vector<Model*>& models, std::vector<Model::Texture>& textures) {
+    std::vector<std::unique_ptr<Images::TextureLoad>> loads;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (queue.empty() && ready.empty() && current == nullptr) {
+            stats = Stats{};
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    // Slots come from Model::textureBase, textures already holds one element for each of them.
+    for (uint32_t slot = static_cast<uint32_t>(owners.size()); slot < textures.size(); slot++) owners.push_back(slot);
+    slotImages.resize(textures.size());
+    sharing.resize(textures.size());
+    references.resize(textures.size(), 0);
+
+    for (Model* model : models) {
+        if (model->textureBase == UINT32_MAX) continue;
+
+        for (uint32_t i = 0; i < model->images.size() && model->textureBase + i < textures.size(); i++) {
+            Model::glTFImage& image = model->images[i];
+            uint32_t slot = model->textureBase + i;
+
+            // The same bytes can still need another texture when they are sampled for another role. Model::loadTextures
+            // already picked the KHR_texture_basisu or the plain image of every texture, the slot only ever loads its own.
+            const uint64_t content[] = {
+                image.hash,
+                static_cast<uint64_t>(image.role),
+            };
+
+            uint64_t key = Cook::hash(content, sizeof(content));
+            auto found = image.source.empty() ? keys.end() : keys.find(key);
+
+            slotImages[slot] = { model, i };
+            owners[slot] = found != keys.end() ? found->second : slot;
+            sharing[slot].clear();
+            references[slot] = 0;
+            sharing[owners[slot]].push_back(slot);
+            references[owners[slot]]++;
+            textures[slot] = images.placeholder;
+
+            if (found != keys.end()) {
+                stats.shared++;
+                continue;
+            }
+
+            if (!image.source.empty()) keys.emplace(key, slot);
+            loads.push_back(makeLoad(model, i, slot));
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& load : loads) queue.push_back(std::move(load));
+        stats.queued += static_cast<uint32_t>(loads.size());
+        stopping = false;
+    }
+
+    if (!worker.joinable()) worker = std::thread(&Loader::work, this);
+    wake.notify_one();
+}
+
+std::unique_ptr<Adren::Images::TextureLoad> Adren::Loader::makeLoad(Model* model, uint32_t image, uint32_t slot) {
+    const Model::glTFImage& source = model->images[image];
+
+    auto load = std::make_unique<Images::TextureLoad>();
+    load->model = model;
+    load->image = image;
+    load->texture = slot;
+    load->resident = !source.pixels.empty();
+
+    load->name = source.name.empty() ? "Image " + std::to_string(image) : source.name;
+
+    // The worker gets a copy without pixels, its format follows the role like Model::assignImageRoles, since cooking
+    // may have changed the one in the model.
+    if (!load->resident) {
+        load->work.hash = source.hash;
+        load->work.role = source.role;
+        load->work.format = source.role == Model::ImageRole::Color ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+        load->source = &source.source;
+    }
+
+    return load;
+}
+
+void Adren::Loader::work() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        wake.wait(lock, [&]() { return stopping || !queue.empty(); });
+        if (stopping) return;
+
+        std::unique_ptr<Images::TextureLoad> load = std::move(queue.front());
+        queue.pop_front();
+        current = load.get();
+
+        lock.unlock();
+        images.prepareTexture(*load);
+        lock.lock();
+
+        current = nullptr;
+        ready.push_back(std::move(load));
+        idle.notify_all();
+    }
+}
+
+std::vector<uint32_t> Adren::Loader::update(VkInstance& instance, std::vector<Model::Texture>& textures, VkCommandBuffer commandBuffer) {
+    std::vector<uint32_t> done;
+
+    uint32_t uploads = 0;
+    while (uploads++ < uploadsPerFrame) {
+        std::unique_ptr<Images::TextureLoad> load;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (ready.empty()) break;
+
+            load = std::move(ready.front());
+            ready.pop_front();
+        }
+
+        // The placeholder in the slots is shared, so there is nothing to destroy.
+        if (load->texture >= textures.size()) continue;
+        Model::Texture texture = images.finishTexture(instance, *load, commandBuffer);
+        const Model::glTFImage& image = load->model->images[load->image];
+
+        // Images sharing the texture describe it like the image it was loaded from, they keep their own bytes and pixels.
+        for (uint32_t slot : users(load->texture)) {
+            textures[slot] = texture;
+            done.push_back(slot);
+            if (slot == load->texture) continue;
+
+            Model::glTFImage* shared = slot < slotImages.size() && slotImages[slot].model != nullptr ?
+                &slotImages[slot].model->images[slotImages[slot].image] : nullptr;
+            if (shared != nullptr) {
+                shared->width = image.width;
+                shared->height = image.height;
+                shared->format = image.format;
+                shared->levels = image.levels;
+                shared->size = image.size;
+                shared->failed = image.failed;
+                shared->psnr = image.psnr;
+                shared->cookedKey = image.cookedKey;
+            }
+
+            stats.savedBytes += image.size;
+        }
+
+        stats.finished++;
+        if (load->cooked) stats.cooked++;
+        else if (!load->resident) stats.decoded++;
+        if (load->model->images[load->image].failed) stats.failed++;
+    }
+
+    if (!done.empty()) {
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        if (stats.firstMs == 0.0) stats.firstMs = elapsed.count();
+        stats.lastMs = elapsed.count();
+
+#ifdef ADREN_DEBUG
+        if (stats.finished == stats.queued) {
+            std::cerr << "-> Textures: " << stats.cooked << " cooked, " << stats.decoded << " decoded, first after " << stats.firstMs
+                << " ms, all after " << stats.lastMs << " ms" << std::endl;
+            std::cerr << "-> Shared Textures: " << stats.shared << " saving " << stats.savedBytes / 1024 << " KB" << std::endl;
+        }
+#endif
+    }
+
+    return done;
+}
+
+std::vector<Adren::Loader::Pending> Adren::Loader::pending() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<Pending> result;
+
+    for (auto& load : ready) result.push_back({ load->name, State::Ready });
+    if (current != nullptr) result.push_back({ current->name, State::Preparing });
+    for (auto& load : queue) result.push_back({ load->name, State::Queued });
+
+    return result;
+}
+
+const std::vector<uint32_t>& Adren::Loader::users(uint32_t slot) const {
+    static const std::vector<uint32_t> none;
+    uint32_t first = owner(slot);
+    return first < sharing.size() ? sharing[first] : none;
+}
+
+bool Adren::Loader::release(uint32_t slot) {
+    uint32_t first = owner(slot);
+    if (first >= references.size()) return true;
+    if (references[first] == 0) return false;
+
+    // The slot goes back to the table and can be handed to another model, so nothing may point at it anymore.
+    std::vector<uint32_t>& users = sharing[first];
+    users.erase(std::remove(users.begin(), users.end(), slot), users.end());
+    slotImages[slot] = {};
+    owners[slot] = slot;
+
+    if (--references[first] > 0) {
+        if (first == slot) transfer(slot, users.front());
+        return false;
+    }
+
+    // Later images with the same content can't share a texture that is gone.
+    for (auto key = keys.begin(); key != keys.end(); key++) {
+        if (key->second != first) continue;
+        keys.erase(key);
+        break;
+    }
+
+    drop(first);
+    return true;
+}
+
+void Adren::Loader::transfer(uint32_t from, uint32_t to) {
+    sharing[to] = std::move(sharing[from]);
+    sharing[from].clear();
+    references[to] = references[from];
+    references[from] = 0;
+    for (uint32_t slot : sharing[to]) owners[slot] = to;
+
+    for (auto& key : keys) {
+        if (key.second == from) key.second = to;
+    }
+
+    // The pending load reads the image of the released slot, the new owner loads its own image with the same content.
+    if (!drop(from)) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(makeLoad(slotImages[to].model, slotImages[to].image, to));
+        stats.queued++;
+    }
+
+    wake.notify_one();
+}
+
+bool Adren::Loader::drop(uint32_t slot) {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [&]() { return current == nullptr || current->texture != slot; });
+
+    auto matches = [&](const std::unique_ptr<Images::TextureLoad>& load) { return load->texture == slot; };
+    size_t pending = queue.size() + ready.size();
+    queue.erase(std::remove_if(queue.begin(), queue.end(), matches), queue.end());
+    ready.erase(std::remove_if(ready.begin(), ready.end(), matches), ready.end());
+
+    uint32_t dropped = static_cast<uint32_t>(pending - queue.size() - ready.size());
+    stats.queued -= std::min(stats.queued, dropped);
+    return dropped > 0;
+}
+
+void Adren::Loader::cancel() {
+    std::unique_lock<std::mutex> lock(mutex);
+    queue.clear();
+    idle.wait(lock, [&]() { return current == nullptr; });
+    ready.clear();
+}
+
+void Adren::Loader::cleanup() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        queue.clear();
+    }
+
+    wake.notify_all();
+    if (worker.joinable()) worker.join();
+    ready.clear();
+}
@@ -0,0 +1,105 @@
+/*
+	loader.h
+	Adrenaline Engine
+
+	This loads the images of models on a worker thread while the scene renders with a placeholder.
+	The worker reads cooked files or decodes and cooks, finished images are uploaded a few per frame.
+*/
+
+#pragma once
+#include "images.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <chrono>
+#include <unordered_map>
+
+namespace Adren {
+class Loader {
+public:
+	Loader(Images& images) : images(images) {}
+
+	// Points the slots of models, from their textureBase on, at the placeholder and queues their images for the worker.
+	void load(std::vector<Model*>& models, std::vector<Model::Texture>& textures);
+
+	// Records the uploads of up to uploadsPerFrame finished images into commandBuffer, the frame command buffer, puts
+	// them in their slot of textures and returns the slots.
+	std::vector<uint32_t> update(VkInstance& instance, std::vector<Model::Texture>& textures, VkCommandBuffer commandBuffer);
+
+	// Drops every load that hasn't been uploaded, waiting for the one the worker is on.
+	void cancel();
+	void cleanup();
+
+	// Slots whose images have the same bytes and role share the texture of the first of them, their owner.
+	uint32_t owner(uint32_t slot) const { return slot < owners.size() ? owners[slot] : slot; }
+	const std::vector<uint32_t>& users(uint32_t slot) const;
+
+	// Drops the reference slot holds on its texture, true when it was the last one and the texture has to go. An owner
+	// that still has users hands the texture to the next of them, so the slot can be reused. Loads never outlive the
+	// image they read, the caller may free the model once every slot of it is released.
+	bool release(uint32_t slot);
+
+	uint32_t uploadsPerFrame = 4;
+
+	enum class State { Queued, Preparing, Ready };
+
+	struct Pending {
+		std::string name;
+		State state;
+	};
+
+	// A copy of every load that hasn't been uploaded yet, in the order they finish.
+	std::vector<Pending> pending();
+
+	struct Stats {
+		uint32_t queued = 0;   // Loads since the last batch was queued.
+		uint32_t finished = 0;
+		uint32_t cooked = 0;   // Read from the cooked texture cache.
+		uint32_t decoded = 0;
+		uint32_t failed = 0;
+		uint32_t shared = 0;          // Slots that use the texture of another.
+		VkDeviceSize savedBytes = 0;  // Of the shared slots whose owner has been uploaded.
+		double firstMs = 0.0;  // From queueing to the first and to the last upload.
+		double lastMs = 0.0;
+	};
+
+	Stats stats{};
+private:
+	void work();
+
+	std::unique_ptr<Images::TextureLoad> makeLoad(Model* model, uint32_t image, uint32_t slot);
+
+	// Moves the users and references of owner from to slot to, a pending load of from is queued again for the image of to.
+	void transfer(uint32_t from, uint32_t to);
+
+	// Removes the pending load of slot, waiting for the worker when it is on it. True when there was one.
+	bool drop(uint32_t slot);
+
+	std::deque<std::unique_ptr<Images::TextureLoad>> queue;
+	std::deque<std::unique_ptr<Images::TextureLoad>> ready;
+	Images::TextureLoad* current = nullptr;
+
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable idle;
+	bool stopping = false;
+
+	// The image a slot samples, by model and index since loads need both.
+	struct SlotImage {
+		Model* model = nullptr;
+		uint32_t image = 0;
+	};
+
+	std::vector<SlotImage> slotImages;             // Per slot.
+	std::vector<uint32_t> owners;                  // Per slot.
+	std::vector<std::vector<uint32_t>> sharing;    // Per owner, every slot using its texture, owner first.
+	std::vector<uint32_t> references;              // Per owner.
+	std::unordered_map<uint64_t, uint32_t> keys;   // Content to owner.
+
+	std::chrono::steady_clock::time_point start;
+	Images& images;
+};
+}
@@ -0,0 +1,133 @@
+/*
+	meshlets.cpp
+	Adrenaline Engine
+
+	Definitions for meshlet generation.
+*/
+
+#include "meshlets.h"
+#include <cfloat>
+#include <cmath>
+
+void Adren::Meshlets::build(const std::vector<glm::vec3>& positions, const uint32_t* indices, size_t indexCount,
+	std::vector<Meshlet>& meshlets, std::vector<uint32_t>& meshletVertices, std::vector<uint32_t>& meshletTriangles) {
+	const uint8_t unused = 0xff;
+	std::vector<uint8_t> local(positions.size(), unused);
+
+	Meshlet current{};
+	current.vertexOffset = static_cast<uint32_t>(meshletVertices.size());
+	current.triangleOffset = static_cast<uint32_t>(meshletTriangles.size());
+
+	auto finish = [&]() {
+		for (uint32_t i = 0; i < current.vertexCount; i++) {
+			local[meshletVertices[current.vertexOffset + i]] = unused;
+		}
+
+		computeBounds(current, positions, meshletVertices, meshletTriangles);
+		meshlets.push_back(current);
+
+		current = Meshlet{};
+		current.vertexOffset = static_cast<uint32_t>(meshletVertices.size());
+		current.triangleOffset = static_cast<uint32_t>(meshletTriangles.size());
+	};
+
+	// Triangles are taken in index order, which for most exporters is already close to spatial order.
+	for (size_t i = 0; i + 2 < indexCount; i += 3) {
+		uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+
+		if (a >= positions.size() || b >= positions.size() || c >= positions.size()) continue;
+		if (a == b || b == c || a == c) continue;
+
+		uint32_t added = (local[a] == unused) + (local[b] == unused) + (local[c] == unused);
+
+		if (current.vertexCount + added > maxVertices || current.triangleCount >= maxTriangles) {
+			finish();
+			added = 3;
+		}
+
+		for (uint32_t v : { a, b, c }) {
+			if (local[v] == unused) {
+				local[v] = static_cast<uint8_t>(current.vertexCount++);
+				meshletVertices.push_back(v);
+			}
+		}
+
+		meshletTriangles.push_back(local[a] | (local[b] << 8) | (local[c] << 16));
+		current.triangleCount++;
+	}
+
+	if (current.triangleCount > 0) finish();
+}
+
+void Adren::Meshlets::computeBounds(Meshlet& meshlet, const std::vector<glm::vec3>& positions,
+	const std::vector<uint32_t>& meshletVertices, const std::vector<uint32_t>& meshletTriangles) {
+	glm::vec3 min = glm::vec3(FLT_MAX);
+	glm::vec3 max = glm::vec3(-FLT_MAX);
+
+	for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+		const glm::vec3& p = positions[meshletVertices[meshlet.vertexOffset + i]];
+		min = glm::min(min, p);
+		max = glm::max(max, p);
+	}
+
+	glm::vec3 center = (min + max) * 0.5f;
+	float radius = 0.0f;
+
+	for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+		radius = std::max(radius, glm::distance(center, positions[meshletVertices[meshlet.vertexOffset + i]]));
+	}
+
+	meshlet.sphere = glm::vec4(center, radius);
+
+	// The normal cone follows meshoptimizer: the axis is the average triangle normal and the cutoff is
+	// derived from the widest angle between the axis and any triangle normal.
+	std::vector<glm::vec3> normals;
+	std::vector<glm::vec3> corners;
+	glm::vec3 axis = glm::vec3(0.0f);
+
+	for (uint32_t i = 0; i < meshlet.triangleCount; i++) {
+		uint32_t packed = meshletTriangles[meshlet.triangleOffset + i];
+		const glm::vec3& p0 = positions[meshletVertices[meshlet.vertexOffset + (packed & 0xff)]];
+		const glm::vec3& p1 = positions[meshletVertices[meshlet.vertexOffset + ((packed >> 8) & 0xff)]];
+		const glm::vec3& p2 = positions[meshletVertices[meshlet.vertexOffset + ((packed >> 16) & 0xff)]];
+
+		glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		float length = glm::length(normal);
+		if (length <= 0.0f) continue;
+
+		normal /= length;
+		normals.push_back(normal);
+		corners.push_back(p0);
+		axis += normal;
+	}
+
+	float axisLength = glm::length(axis);
+	meshlet.cone = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	meshlet.apex = glm::vec4(center, 0.0f);
+
+	if (normals.empty() || axisLength <= 0.0f) return;
+
+	axis /= axisLength;
+	float minDot = 1.0f;
+
+	for (const glm::vec3& normal : normals) {
+		minDot = std::min(minDot, glm::dot(normal, axis));
+	}
+
+	// Anything wider than roughly 85 degrees can never be rejected, so the cone is left disabled.
+	if (minDot <= 0.1f) {
+		meshlet.cone = glm::vec4(axis, 1.0f);
+		return;
+	}
+
+	// Moving the apex back along the axis makes the cone contain every triangle plane.
+	float maxT = 0.0f;
+
+	for (size_t i = 0; i < normals.size(); i++) {
+		float t = glm::dot(center - corners[i], normals[i]) / glm::dot(axis, normals[i]);
+		maxT = std::max(maxT, t);
+	}
+
+	meshlet.apex = glm::vec4(center - axis * maxT, 0.0f);
+	meshlet.cone = glm::vec4(axis, std::sqrt(1.0f - minDot * minDot));
+}
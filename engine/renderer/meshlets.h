@@ -0,0 +1,24 @@
+/*
+	meshlets.h
+	Adrenaline Engine
+
+	This splits primitives into meshlets (small clusters of triangles) with bounds for culling.
+*/
+
+#pragma once
+#include "types.h"
+#include <vector>
+
+namespace Adren::Meshlets {
+	static const uint32_t maxVertices = 64;
+	static const uint32_t maxTriangles = 124;
+
+	// Appends the meshlets of an indexed triangle list to the output lists. Meshlet vertices are
+	// indices into positions and every triangle is packed as three 8-bit meshlet vertex indices.
+	void build(const std::vector<glm::vec3>& positions, const uint32_t* indices, size_t indexCount,
+		std::vector<Meshlet>& meshlets, std::vector<uint32_t>& meshletVertices, std::vector<uint32_t>& meshletTriangles);
+
+	// Fills in the bounding sphere and normal cone of a meshlet whose lists are already written.
+	void computeBounds(Meshlet& meshlet, const std::vector<glm::vec3>& positions, 
+		const std::vector<uint32_t>& meshletVertices, const std::vector<uint32_t>& meshletTriangles);
+}
@@ -0,0 +1,548 @@
+/*
+    meshopt.cpp
+    Adrenaline Engine
+
+    Definitions for the EXT_meshopt_compression decoders.
+    The formats follow the extension specification and meshoptimizer by Arseny Kapoulkine.
+*/
+
+#include "meshopt.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ADREN_MESHOPT_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+const uint8_t vertexHeader = 0xA0;
+const uint8_t indexHeader = 0xE0;
+const uint8_t sequenceHeader = 0xD0;
+
+const size_t byteGroupSize = 16;
+const size_t byteGroupDecodeLimit = 24;
+const size_t vertexBlockSizeBytes = 8192;
+const size_t vertexBlockMaxSize = 256;
+const size_t tailMaxSize = 32;
+
+size_t vertexBlockSize(size_t stride) {
+    size_t result = (vertexBlockSizeBytes / stride) & ~(byteGroupSize - 1);
+    return std::min(result, vertexBlockMaxSize);
+}
+
+uint8_t unzigzag8(uint8_t v) {
+    return static_cast<uint8_t>(-(v & 1) ^ (v >> 1));
+}
+
+// A group of 16 bytes is stored as zeros, 2-bit or 4-bit values or raw bytes. The largest 2-bit and
+// 4-bit values mean the real byte follows the packed values.
+const uint8_t* decodeBytesGroup(const uint8_t* data, uint8_t* buffer, int bitsLog2) {
+    switch (bitsLog2) {
+        case 0:
+            memset(buffer, 0, byteGroupSize);
+            return data;
+        case 1:
+        case 2: {
+            int bits = bitsLog2 == 1 ? 2 : 4;
+            uint8_t sentinel = static_cast<uint8_t>((1 << bits) - 1);
+            const uint8_t* extra = data + bits * 2;
+
+            for (size_t i = 0; i < byteGroupSize; i++) {
+                uint8_t byte = data[(i * bits) / 8];
+                uint8_t value = static_cast<uint8_t>((byte >> (8 - bits - (i * bits) % 8)) & sentinel);
+                buffer[i] = value == sentinel ? *extra++ : value;
+            }
+
+            return extra;
+        }
+        default:
+            memcpy(buffer, data, byteGroupSize);
+            return data + byteGroupSize;
+    }
+}
+
+const uint8_t* decodeBytes(const uint8_t* data, const uint8_t* end, uint8_t* buffer, size_t size) {
+    size_t headerSize = (size / byteGroupSize + 3) / 4;
+    if (static_cast<size_t>(end - data) < headerSize) return nullptr;
+
+    const uint8_t* header = data;
+    data += headerSize;
+
+    for (size_t i = 0; i < size; i += byteGroupSize) {
+        if (static_cast<size_t>(end - data) < byteGroupDecodeLimit) return nullptr;
+
+        size_t group = i / byteGroupSize;
+        int bitsLog2 = (header[group / 4] >> ((group % 4) * 2)) & 3;
+        data = decodeBytesGroup(data, buffer + i, bitsLog2);
+    }
+
+    return data;
+}
+
+// Every byte of the vertex is stored as its own stream of zigzag deltas from the previous vertex.
+const uint8_t* decodeVertexBlock(const uint8_t* data, const uint8_t* end, uint8_t* vertexData, size_t count, size_t stride, uint8_t* last) {
+    uint8_t buffer[vertexBlockMaxSize];
+    uint8_t transposed[vertexBlockSizeBytes];
+    size_t countAligned = (count + byteGroupSize - 1) & ~(byteGroupSize - 1);
+
+    for (size_t k = 0; k < stride; k++) {
+        data = decodeBytes(data, end, buffer, countAligned);
+        if (data == nullptr) return nullptr;
+
+        uint8_t previous = last[k];
+        for (size_t i = 0; i < count; i++) {
+            uint8_t value = static_cast<uint8_t>(unzigzag8(buffer[i]) + previous);
+            transposed[i * stride + k] = value;
+            previous = value;
+        }
+    }
+
+    memcpy(vertexData, transposed, count * stride);
+    memcpy(last, &transposed[stride * (count - 1)], stride);
+    return data;
+}
+
+uint32_t decodeVByte(const uint8_t*& data) {
+    uint8_t lead = *data++;
+    if (lead < 128) return lead;
+
+    uint32_t result = lead & 127;
+    uint32_t shift = 7;
+
+    for (int i = 0; i < 4; i++) {
+        uint8_t group = *data++;
+        result |= static_cast<uint32_t>(group & 127) << shift;
+        shift += 7;
+        if (group < 128) break;
+    }
+
+    return result;
+}
+
+uint32_t decodeIndex(const uint8_t*& data, uint32_t last) {
+    uint32_t v = decodeVByte(data);
+    uint32_t delta = (v >> 1) ^ (0u - (v & 1));
+    return last + delta;
+}
+
+void writeIndex(void* destination, size_t i, size_t stride, uint32_t index) {
+    if (stride == 2) {
+        static_cast<uint16_t*>(destination)[i] = static_cast<uint16_t>(index);
+    } else {
+        static_cast<uint32_t*>(destination)[i] = index;
+    }
+}
+
+// The FIFOs have to be updated exactly like the encoder does, every read wraps around 16 entries.
+struct IndexState {
+    uint32_t edges[16][2];
+    uint32_t vertices[16];
+    size_t edgeOffset = 0;
+    size_t vertexOffset = 0;
+
+    IndexState() {
+        memset(edges, -1, sizeof(edges));
+        memset(vertices, -1, sizeof(vertices));
+    }
+
+    void pushEdge(uint32_t a, uint32_t b) {
+        edges[edgeOffset][0] = a;
+        edges[edgeOffset][1] = b;
+        edgeOffset = (edgeOffset + 1) & 15;
+    }
+
+    void pushVertex(uint32_t v, bool condition = true) {
+        vertices[vertexOffset] = v;
+        vertexOffset = (vertexOffset + (condition ? 1 : 0)) & 15;
+    }
+};
+
+template<typename T>
+void filterOctScalar(T* data, size_t count) {
+    const float max = static_cast<float>((1 << (sizeof(T) * 8 - 1)) - 1);
+
+    for (size_t i = 0; i < count; i++) {
+        float x = static_cast<float>(data[i * 4 + 0]);
+        float y = static_cast<float>(data[i * 4 + 1]);
+        float z = static_cast<float>(data[i * 4 + 2]) - std::fabs(x) - std::fabs(y);
+
+        // Folds the lower half of the octahedron back.
+        float t = z >= 0.0f ? 0.0f : z;
+        x += x >= 0.0f ? t : -t;
+        y += y >= 0.0f ? t : -t;
+
+        float s = max / std::sqrt(x * x + y * y + z * z);
+        data[i * 4 + 0] = static_cast<T>(static_cast<int>(x * s + (x >= 0.0f ? 0.5f : -0.5f)));
+        data[i * 4 + 1] = static_cast<T>(static_cast<int>(y * s + (y >= 0.0f ? 0.5f : -0.5f)));
+        data[i * 4 + 2] = static_cast<T>(static_cast<int>(z * s + (z >= 0.0f ? 0.5f : -0.5f)));
+    }
+}
+
+void filterQuatScalar(int16_t* data, size_t count) {
+    const float scale = 1.0f / std::sqrt(2.0f);
+
+    for (size_t i = 0; i < count; i++) {
+        // The high bits of w hold the scale, the low 2 bits the index of the dropped component.
+        float ss = scale / static_cast<float>(data[i * 4 + 3] | 3);
+        float x = static_cast<float>(data[i * 4 + 0]) * ss;
+        float y = static_cast<float>(data[i * 4 + 1]) * ss;
+        float z = static_cast<float>(data[i * 4 + 2]) * ss;
+        float w = std::sqrt(std::max(1.0f - x * x - y * y - z * z, 0.0f));
+
+        int qc = data[i * 4 + 3] & 3;
+        data[i * 4 + ((qc + 1) & 3)] = static_cast<int16_t>(static_cast<int>(x * 32767.0f + (x >= 0.0f ? 0.5f : -0.5f)));
+        data[i * 4 + ((qc + 2) & 3)] = static_cast<int16_t>(static_cast<int>(y * 32767.0f + (y >= 0.0f ? 0.5f : -0.5f)));
+        data[i * 4 + ((qc + 3) & 3)] = static_cast<int16_t>(static_cast<int>(z * 32767.0f + (z >= 0.0f ? 0.5f : -0.5f)));
+        data[i * 4 + ((qc + 0) & 3)] = static_cast<int16_t>(static_cast<int>(w * 32767.0f + 0.5f));
+    }
+}
+
+void filterExpScalar(uint32_t* data, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        // A 24-bit signed mantissa with an 8-bit signed exponent, ldexp without the library call.
+        int32_t m = static_cast<int32_t>(data[i] << 8) >> 8;
+        int32_t e = static_cast<int32_t>(data[i]) >> 24;
+
+        uint32_t bits = static_cast<uint32_t>(e + 127) << 23;
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        f *= static_cast<float>(m);
+        memcpy(&data[i], &f, sizeof(f));
+    }
+}
+
+#ifdef ADREN_MESHOPT_SSE2
+// Flips the sign of t in the lanes where x is negative.
+inline __m128 signedAdd(__m128 x, __m128 t) {
+    __m128 sign = _mm_and_ps(x, _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(0x80000000))));
+    return _mm_add_ps(x, _mm_xor_ps(t, sign));
+}
+
+// Shared by both octahedral layouts, the inputs are sign extended components.
+inline void octahedral(__m128i xi, __m128i yi, __m128i zi, float max, __m128i& xr, __m128i& yr, __m128i& zr) {
+    __m128 x = _mm_cvtepi32_ps(xi);
+    __m128 y = _mm_cvtepi32_ps(yi);
+    __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    __m128 z = _mm_sub_ps(_mm_sub_ps(_mm_cvtepi32_ps(zi), _mm_and_ps(x, absMask)), _mm_and_ps(y, absMask));
+
+    __m128 t = _mm_min_ps(z, _mm_setzero_ps());
+    x = signedAdd(x, t);
+    y = signedAdd(y, t);
+
+    __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_add_ps(_mm_mul_ps(y, y), _mm_mul_ps(z, z))));
+    __m128 s = _mm_div_ps(_mm_set1_ps(max), length);
+
+    xr = _mm_cvtps_epi32(_mm_mul_ps(x, s));
+    yr = _mm_cvtps_epi32(_mm_mul_ps(y, s));
+    zr = _mm_cvtps_epi32(_mm_mul_ps(z, s));
+}
+
+void filterOct8(int8_t* data, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i n4 = _mm_loadu_si128(reinterpret_cast<__m128i*>(&data[i * 4]));
+
+        __m128i xi = _mm_srai_epi32(_mm_slli_epi32(n4, 24), 24);
+        __m128i yi = _mm_srai_epi32(_mm_slli_epi32(n4, 16), 24);
+        __m128i zi = _mm_srai_epi32(_mm_slli_epi32(n4, 8), 24);
+
+        __m128i xr, yr, zr;
+        octahedral(xi, yi, zi, 127.0f, xr, yr, zr);
+
+        __m128i mask = _mm_set1_epi32(0xFF);
+        __m128i result = _mm_and_si128(xr, mask);
+        result = _mm_or_si128(result, _mm_slli_epi32(_mm_and_si128(yr, mask), 8));
+        result = _mm_or_si128(result, _mm_slli_epi32(_mm_and_si128(zr, mask), 16));
+        result = _mm_or_si128(result, _mm_and_si128(n4, _mm_set1_epi32(static_cast<int>(0xFF000000))));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&data[i * 4]), result);
+    }
+
+    filterOctScalar(data + i * 4, count - i);
+}
+
+// Splits four 8 byte elements into 32-bit lanes holding xy and zw.
+inline void load16(int16_t* data, __m128i& xy, __m128i& zw) {
+    __m128 n0 = _mm_loadu_ps(reinterpret_cast<float*>(data));
+    __m128 n1 = _mm_loadu_ps(reinterpret_cast<float*>(data + 8));
+    xy = _mm_castps_si128(_mm_shuffle_ps(n0, n1, _MM_SHUFFLE(2, 0, 2, 0)));
+    zw = _mm_castps_si128(_mm_shuffle_ps(n0, n1, _MM_SHUFFLE(3, 1, 3, 1)));
+}
+
+void filterOct16(int16_t* data, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i xy, zw;
+        load16(&data[i * 4], xy, zw);
+
+        __m128i xi = _mm_srai_epi32(_mm_slli_epi32(xy, 16), 16);
+        __m128i yi = _mm_srai_epi32(xy, 16);
+        __m128i zi = _mm_srai_epi32(_mm_slli_epi32(zw, 16), 16);
+
+        __m128i xr, yr, zr;
+        octahedral(xi, yi, zi, 32767.0f, xr, yr, zr);
+
+        __m128i mask = _mm_set1_epi32(0xFFFF);
+        __m128i resultXY = _mm_or_si128(_mm_and_si128(xr, mask), _mm_slli_epi32(yr, 16));
+        __m128i resultZW = _mm_or_si128(_mm_and_si128(zr, mask), _mm_andnot_si128(mask, zw));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&data[i * 4]), _mm_unpacklo_epi32(resultXY, resultZW));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&data[i * 4 + 8]), _mm_unpackhi_epi32(resultXY, resultZW));
+    }
+
+    filterOctScalar(data + i * 4, count - i);
+}
+
+void filterQuat(int16_t* data, size_t count) {
+    const float scale = 1.0f / std::sqrt(2.0f);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i xy, zw;
+        load16(&data[i * 4], xy, zw);
+
+        __m128i wi = _mm_srai_epi32(zw, 16);
+        __m128 ss = _mm_div_ps(_mm_set1_ps(scale), _mm_cvtepi32_ps(_mm_or_si128(wi, _mm_set1_epi32(3))));
+
+        __m128 x = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(xy, 16), 16)), ss);
+        __m128 y = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(xy, 16)), ss);
+        __m128 z = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(zw, 16), 16)), ss);
+
+        __m128 ww = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_add_ps(_mm_mul_ps(x, x), _mm_add_ps(_mm_mul_ps(y, y), _mm_mul_ps(z, z))));
+        __m128 w = _mm_sqrt_ps(_mm_max_ps(ww, _mm_setzero_ps()));
+
+        __m128 full = _mm_set1_ps(32767.0f);
+        __m128i xr = _mm_cvtps_epi32(_mm_mul_ps(x, full));
+        __m128i yr = _mm_cvtps_epi32(_mm_mul_ps(y, full));
+        __m128i zr = _mm_cvtps_epi32(_mm_mul_ps(z, full));
+        __m128i wr = _mm_cvtps_epi32(_mm_mul_ps(w, full));
+
+        // Laid out as w, x, y, z so the dropped component can be put back with a rotation.
+        __m128i mask = _mm_set1_epi32(0xFFFF);
+        __m128i wx = _mm_or_si128(_mm_and_si128(wr, mask), _mm_slli_epi32(xr, 16));
+        __m128i yz = _mm_or_si128(_mm_and_si128(yr, mask), _mm_slli_epi32(zr, 16));
+
+        alignas(16) uint64_t rotated[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(&rotated[0]), _mm_unpacklo_epi32(wx, yz));
+        _mm_store_si128(reinterpret_cast<__m128i*>(&rotated[2]), _mm_unpackhi_epi32(wx, yz));
+
+        for (size_t k = 0; k < 4; k++) {
+            uint32_t shift = (data[(i + k) * 4 + 3] & 3) * 16;
+            uint64_t value = shift == 0 ? rotated[k] : (rotated[k] << shift) | (rotated[k] >> (64 - shift));
+            memcpy(&data[(i + k) * 4], &value, sizeof(value));
+        }
+    }
+
+    filterQuatScalar(data + i * 4, count - i);
+}
+
+void filterExp(uint32_t* data, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i*>(&data[i]));
+
+        __m128i m = _mm_srai_epi32(_mm_slli_epi32(v, 8), 8);
+        __m128i e = _mm_srai_epi32(v, 24);
+        __m128 power = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(e, _mm_set1_epi32(127)), 23));
+
+        _mm_storeu_ps(reinterpret_cast<float*>(&data[i]), _mm_mul_ps(power, _mm_cvtepi32_ps(m)));
+    }
+
+    filterExpScalar(data + i, count - i);
+}
+#else
+void filterOct8(int8_t* data, size_t count) { filterOctScalar(data, count); }
+void filterOct16(int16_t* data, size_t count) { filterOctScalar(data, count); }
+void filterQuat(int16_t* data, size_t count) { filterQuatScalar(data, count); }
+void filterExp(uint32_t* data, size_t count) { filterExpScalar(data, count); }
+#endif
+}
+
+bool Adren::Meshopt::decodeVertexBuffer(void* destination, size_t count, size_t stride, const uint8_t* buffer, size_t bufferSize) {
+    if (stride == 0 || stride > 256 || stride % 4 != 0) return false;
+    if (bufferSize < 1 + stride) return false;
+
+    const uint8_t* data = buffer;
+    const uint8_t* end = buffer + bufferSize;
+
+    uint8_t header = *data++;
+    if ((header & 0xF0) != vertexHeader || (header & 0x0F) > 0) return false;
+
+    // The first vertex is stored in the tail, every block starts from the last vertex of the block before.
+    uint8_t last[vertexBlockMaxSize];
+    memcpy(last, end - stride, stride);
+
+    uint8_t* vertexData = static_cast<uint8_t*>(destination);
+    size_t blockSize = vertexBlockSize(stride);
+
+    for (size_t offset = 0; offset < count; offset += blockSize) {
+        size_t size = std::min(blockSize, count - offset);
+        data = decodeVertexBlock(data, end, vertexData + offset * stride, size, stride, last);
+        if (data == nullptr) return false;
+    }
+
+    return static_cast<size_t>(end - data) == std::max(stride, tailMaxSize);
+}
+
+bool Adren::Meshopt::decodeIndexBuffer(void* destination, size_t count, size_t stride, const uint8_t* buffer, size_t bufferSize) {
+    if (count % 3 != 0 || (stride != 2 && stride != 4)) return false;
+
+    // The smallest stream has the header, a byte per triangle and the 16 byte code table.
+    if (bufferSize < 1 + count / 3 + 16) return false;
+    if ((buffer[0] & 0xF0) != indexHeader) return false;
+
+    int version = buffer[0] & 0x0F;
+    if (version > 1) return false;
+
+    IndexState state;
+    uint32_t next = 0;
+    uint32_t last = 0;
+    int fecMax = version >= 1 ? 13 : 15;
+
+    const uint8_t* code = buffer + 1;
+    const uint8_t* data = code + count / 3;
+    const uint8_t* safeEnd = buffer + bufferSize - 16;
+    const uint8_t* codeTable = safeEnd;
+
+    for (size_t i = 0; i < count; i += 3) {
+        // A triangle reads at most 16 bytes, which the code table at the end always covers.
+        if (data > safeEnd) return false;
+
+        uint8_t codeTri = *code++;
+        uint32_t a, b, c;
+
+        if (codeTri < 0xF0) {
+            // Two vertices come from a recent edge, the third from the vertex FIFO, the next new vertex or the data.
+            int fe = codeTri >> 4;
+            a = state.edges[(state.edgeOffset - 1 - fe) & 15][0];
+            b = state.edges[(state.edgeOffset - 1 - fe) & 15][1];
+
+            int fec = codeTri & 15;
+            if (fec < fecMax) {
+                c = fec == 0 ? next : state.vertices[(state.vertexOffset - 1 - fec) & 15];
+                next += fec == 0;
+                state.pushVertex(c, fec == 0);
+            } else {
+                // 13 and 14 are the last free index minus and plus one.
+                last = c = fec != 15 ? last + (fec - (fec ^ 3)) : decodeIndex(data, last);
+                state.pushVertex(c);
+            }
+
+            state.pushEdge(c, b);
+            state.pushEdge(a, c);
+        } else {
+            int feb, fec;
+            bool reset = false;
+
+            if (codeTri < 0xFE) {
+                uint8_t codeAux = codeTable[codeTri & 15];
+                feb = codeAux >> 4;
+                fec = codeAux & 15;
+
+                a = next++;
+                b = feb == 0 ? next : state.vertices[(state.vertexOffset - feb) & 15];
+                next += feb == 0;
+                c = fec == 0 ? next : state.vertices[(state.vertexOffset - fec) & 15];
+                next += fec == 0;
+            } else {
+                uint8_t codeAux = *data++;
+                int fea = codeTri == 0xFE ? 0 : 15;
+                feb = codeAux >> 4;
+                fec = codeAux & 15;
+                reset = codeAux == 0;
+
+                if (reset) next = 0;
+
+                a = fea == 0 ? next++ : 0;
+                b = feb == 0 ? next++ : state.vertices[(state.vertexOffset - feb) & 15];
+                c = fec == 0 ? next++ : state.vertices[(state.vertexOffset - fec) & 15];
+
+                if (fea == 15) last = a = decodeIndex(data, last);
+                if (feb == 15) last = b = decodeIndex(data, last);
+                if (fec == 15) last = c = decodeIndex(data, last);
+            }
+
+            state.pushVertex(a);
+            state.pushVertex(b, feb == 0 || feb == 15);
+            state.pushVertex(c, fec == 0 || fec == 15);
+
+            state.pushEdge(b, a);
+            state.pushEdge(c, b);
+            state.pushEdge(a, c);
+        }
+
+        writeIndex(destination, i + 0, stride, a);
+        writeIndex(destination, i + 1, stride, b);
+        writeIndex(destination, i + 2, stride, c);
+    }
+
+    return data == safeEnd;
+}
+
+bool Adren::Meshopt::decodeIndexSequence(void* destination, size_t count, size_t stride, const uint8_t* buffer, size_t bufferSize) {
+    if (stride != 2 && stride != 4) return false;
+
+    // The smallest stream has the header, a byte per index and a 4 byte tail.
+    if (bufferSize < 1 + count + 4) return false;
+    if ((buffer[0] & 0xF0) != sequenceHeader) return false;
+    if ((buffer[0] & 0x0F) > 1) return false;
+
+    const uint8_t* data = buffer + 1;
+    const uint8_t* safeEnd = buffer + bufferSize - 4;
+
+    // Every index is a delta from one of two baselines, the lowest bit picks which.
+    uint32_t last[2] = {};
+
+    for (size_t i = 0; i < count; i++) {
+        if (data >= safeEnd) return false;
+
+        uint32_t v = decodeVByte(data);
+        uint32_t baseline = v & 1;
+        v >>= 1;
+
+        uint32_t index = last[baseline] + ((v >> 1) ^ (0u - (v & 1)));
+        last[baseline] = index;
+        writeIndex(destination, i, stride, index);
+    }
+
+    return data == safeEnd;
+}
+
+void Adren::Meshopt::decodeFilterOct(void* buffer, size_t count, size_t stride) {
+    if (stride == 4) {
+        filterOct8(static_cast<int8_t*>(buffer), count);
+    } else if (stride == 8) {
+        filterOct16(static_cast<int16_t*>(buffer), count);
+    }
+}
+
+void Adren::Meshopt::decodeFilterQuat(void* buffer, size_t count, size_t stride) {
+    if (stride == 8) filterQuat(static_cast<int16_t*>(buffer), count);
+}
+
+void Adren::Meshopt::decodeFilterExp(void* buffer, size_t count, size_t stride) {
+    if (stride % 4 == 0) filterExp(static_cast<uint32_t*>(buffer), count * (stride / 4));
+}
+
+bool Adren::Meshopt::decode(void* destination, size_t count, size_t stride, const uint8_t* buffer, size_t bufferSize, Mode mode, Filter filter) {
+    switch (mode) {
+        case Mode::Attributes:
+            if (!decodeVertexBuffer(destination, count, stride, buffer, bufferSize)) return false;
+            break;
+        case Mode::Triangles:
+            return decodeIndexBuffer(destination, count, stride, buffer, bufferSize);
+        case Mode::Indices:
+            return decodeIndexSequence(destination, count, stride, buffer, bufferSize);
+    }
+
+    switch (filter) {
+        case Filter::Octahedral: decodeFilterOct(destination, count, stride); break;
+        case Filter::Quaternion: decodeFilterQuat(destination, count, stride); break;
+        case Filter::Exponential: decodeFilterExp(destination, count, stride); break;
+        default: break;
+    }
+
+    return true;
+}
@@ -0,0 +1,35 @@
+/*
+	meshopt.h
+	Adrenaline Engine
+
+	This decodes buffer views compressed with EXT_meshopt_compression.
+	The bitstreams are the ones written by meshoptimizer's encoders.
+*/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace Adren::Meshopt {
+	// In the same order as fastgltf::MeshoptCompressionMode and fastgltf::MeshoptCompressionFilter.
+	enum class Mode { Attributes, Triangles, Indices };
+	enum class Filter { None, Octahedral, Quaternion, Exponential };
+
+	// Every decoder returns false when the data is malformed or does not fit the given count and stride.
+	// Attributes are decoded from the 0xA0 vertex stream, strides have to be a multiple of 4 up to 256.
+	bool decodeVertexBuffer(void* destination, size_t count, size_t stride, const uint8_t* buffer, size_t bufferSize);
+
+	// Triangle lists from the 0xE1 index stream, strides are 2 or 4.
+	bool decodeIndexBuffer(void* destination, size_t count, size_t stride, const uint8_t* buffer, size_t bufferSize);
+
+	// Any other index list from the 0xD1 index sequence stream, strides are 2 or 4.
+	bool decodeIndexSequence(void* destination, size_t count, size_t stride, const uint8_t* buffer, size_t bufferSize);
+
+	// Filters run in place on decoded attributes and use SSE2 when the target has it.
+	void decodeFilterOct(void* buffer, size_t count, size_t stride);
+	void decodeFilterQuat(void* buffer, size_t count, size_t stride);
+	void decodeFilterExp(void* buffer, size_t count, size_t stride);
+
+	// Decodes one compressed buffer view and applies its filter.
+	bool decode(void* destination, size_t count, size_t stride, const uint8_t* buffer, size_t bufferSize, Mode mode, Filter filter);
+}
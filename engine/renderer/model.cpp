@@ -10,11 +10,19 @@
 
 #include "model.h"
 #include "tools.h"
+#include "meshlets.h"
+#include "simplify.h"
+#include "meshopt.h"
+#include "ktx2.h"
+#include "cook.h"
+#include "atlas.h"
 
 #include <fastgltf/core.hpp>
 #include <fastgltf/types.hpp>
 #include <fastgltf/tools.hpp>
 #include <fastgltf/glm_element_traits.hpp>
+#include <cfloat>
+#include <fstream>
 
 #include "../adrenaline.h" // This is where STB_IMAGE_IMPLEMENTATION is defined.
 
@@ -68,6 +76,8 @@ Adren::Model::Model(std::string_view modelPath) {
         Adren::Debugger::log("GLTF Loaded");
 #endif
 
+        decompressBufferViews();
+
         for (auto& image : gltfModel.images) {
             loadImages(image);
         }
@@ -80,6 +90,8 @@ Adren::Model::Model(std::string_view modelPath) {
             loadMaterials(material);
         }
 
+        assignImageRoles();
+
 #ifdef ADREN_DEBUG
         std::cerr << "-> Meshes Size: " << gltfModel.meshes.size() << std::endl;
 #endif
@@ -87,6 +99,25 @@ Adren::Model::Model(std::string_view modelPath) {
             loadMesh(mesh);
         }
 
+        // Before the meshlets, so their texture coordinate density is measured in the pages.
+        buildAtlases();
+
+#ifdef ADREN_DEBUG
+        size_t baseIndices = indices.size();
+#endif
+
+        generateLods();
+
+#ifdef ADREN_DEBUG
+        std::cerr << "-> LOD Indices: " << indices.size() - baseIndices << " on top of " << baseIndices << std::endl;
+#endif
+
+        buildMeshlets();
+
+#ifdef ADREN_DEBUG
+        std::cerr << "-> Meshlets: " << meshlets.size() << std::endl;
+#endif
+
         for (auto& scene : gltfModel.scenes) {
             for (auto& node : scene.nodeIndices) {
                 countMeshes(modelSize, node);
@@ -107,11 +138,11 @@ void Adren::Model::countMeshes(uint32_t& num, size_t index) {
 
 void Adren::Model::countMatrices(std::vector<glm::mat4>& matrices, size_t index, glm::mat4 matrix) {
     const fastgltf::Node& node = gltfModel.nodes[index];
-    glm::mat4 temp = glm::mat4(1.0f);
-    matrices.push_back(getTransformMatrix(node, temp));
+    glm::mat4 world = getTransformMatrix(node, matrix);
+    matrices.push_back(world);
 
     for (const auto& child : node.children) {
-        countMatrices(matrices, child, glm::mat4(1.0f));
+        countMatrices(matrices, child, world);
     }
 }
 
@@ -136,63 +167,110 @@ glm::mat4 Adren::Model::getTransformMatrix(const fastgltf::Node& node, glm::mat4
 
 bool Adren::Model::loadImages(fastgltf::Image& image) {
     glTFImage gltfImage{};
-    
+
     std::visit(fastgltf::visitor{
         [](auto& arg) {},
         [&](fastgltf::sources::URI& filePath) {
             assert(filePath.fileByteOffset == 0);
             assert(filePath.uri.isLocalPath());
-            int width, height, nrChannels;
 
             const std::string path(filePath.uri.path().begin(), filePath.uri.path().end()); // Thanks C++.
-            unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrChannels, 4);
-            gltfImage = glTFImage {
-                .buffer = data,
-                .bufferSize = static_cast<VkDeviceSize>(width * height * 4),
-                .height = height,
-                .width = width
-            };
+            std::ifstream stream(path, std::ios::binary | std::ios::ate);
+            if (!stream.is_open()) return;
+
+            gltfImage.source.resize(static_cast<size_t>(stream.tellg()));
+            stream.seekg(0);
+            stream.read(reinterpret_cast<char*>(gltfImage.source.data()), gltfImage.source.size());
         },
         [&](fastgltf::sources::Array& vector) {
-            int width, height, nrChannels;
-            unsigned char* data = stbi_load_from_memory(vector.bytes.data(), static_cast<int>(vector.bytes.size()), &width, &height, &nrChannels, 4);
-            gltfImage = glTFImage {
-                .buffer = data,
-                .bufferSize = static_cast<VkDeviceSize>(width * height * 4),
-                .height = height,
-                .width = width
-            };
+            gltfImage.source.assign(vector.bytes.begin(), vector.bytes.end());
         },
         [&](fastgltf::sources::BufferView& view) {
             auto& bufferView = gltfModel.bufferViews[view.bufferViewIndex];
-            auto& buffer = gltfModel.buffers[bufferView.bufferIndex];
-            std::visit(fastgltf::visitor {
-                [](auto& arg) {},
-                [&](fastgltf::sources::Array& vector) {
-                    int width, height, nrChannels;
-                    unsigned char* data = stbi_load_from_memory(vector.bytes.data() + bufferView.byteOffset, static_cast<int>(bufferView.byteLength), &width, &height, &nrChannels, 4);
-                    gltfImage = glTFImage {
-                        .buffer = data,
-                        .bufferSize = static_cast<VkDeviceSize>(width * height * 4),
-                        .height = height,
-                        .width = width
-                    };
-                }
-            }, buffer.data);
+            const std::byte* data = bufferData(bufferView.bufferIndex);
+            if (data == nullptr) return;
+
+            const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data) + bufferView.byteOffset;
+            gltfImage.source.assign(bytes, bytes + bufferView.byteLength);
         },
     }, image.data);
 
-    images.emplace_back(gltfImage);
+    gltfImage.hash = Adren::Cook::hash(gltfImage.source.data(), gltfImage.source.size());
+    gltfImage.name = std::string(std::string_view(image.name));
+    images.emplace_back(std::move(gltfImage));
 
     return true;
 }
 
+void Adren::Model::decodeImage(glTFImage& image, const std::vector<uint8_t>& source) {
+    const uint8_t* bytes = source.empty() ? nullptr : source.data();
+    size_t size = source.size();
+
+    if (bytes != nullptr && Adren::Ktx2::isKtx2(bytes, size)) {
+        Adren::Ktx2::Texture texture;
+        std::string error;
+
+        if (Adren::Ktx2::read(bytes, size, texture, error)) {
+            image.pixels = std::move(texture.data);
+            image.width = static_cast<int>(texture.width);
+            image.height = static_cast<int>(texture.height);
+            if (!texture.transcoded) image.format = texture.format;
+            image.levels = std::move(texture.levels);
+            return;
+        }
+
+        std::cerr << "-> KTX2 image could not be loaded: " << error << std::endl;
+    } else if (bytes != nullptr) {
+        int width, height, nrChannels;
+        unsigned char* data = stbi_load_from_memory(bytes, static_cast<int>(size), &width, &height, &nrChannels, 4);
+
+        if (data != nullptr) {
+            image.pixels.assign(data, data + static_cast<size_t>(width) * height * 4);
+            image.width = width;
+            image.height = height;
+            stbi_image_free(data);
+            return;
+        }
+    }
+
+    // Images that fail keep their slot with a single white texel, so texture indices stay valid.
+    image.pixels = { 255, 255, 255, 255 };
+    image.width = 1;
+    image.height = 1;
+    image.failed = true;
+}
+
 bool Adren::Model::loadMaterials(fastgltf::Material& material) {
     Material newMaterial{};
     newMaterial.baseColorFactor = glm::make_vec4(material.pbrData.baseColorFactor.data());
+    newMaterial.emissiveFactor = glm::make_vec3(material.emissiveFactor.data()) * material.emissiveStrength;
+    newMaterial.metallicFactor = material.pbrData.metallicFactor;
+    newMaterial.roughnessFactor = material.pbrData.roughnessFactor;
+    newMaterial.alphaMode = material.alphaMode;
+    newMaterial.alphaCutoff = material.alphaCutoff;
+    newMaterial.doubleSided = material.doubleSided;
+    newMaterial.unlit = material.unlit;
 
     if (material.pbrData.baseColorTexture.has_value()) {
-        newMaterial.baseColorTextureIndex = (material.pbrData.baseColorTexture.value()).textureIndex;
+        newMaterial.baseColorTextureIndex = static_cast<int32_t>(material.pbrData.baseColorTexture->textureIndex);
+    }
+
+    if (material.pbrData.metallicRoughnessTexture.has_value()) {
+        newMaterial.metallicRoughnessTextureIndex = static_cast<int32_t>(material.pbrData.metallicRoughnessTexture->textureIndex);
+    }
+
+    if (material.normalTexture.has_value()) {
+        newMaterial.normalTextureIndex = static_cast<int32_t>(material.normalTexture->textureIndex);
+        newMaterial.normalScale = material.normalTexture->scale;
+    }
+
+    if (material.occlusionTexture.has_value()) {
+        newMaterial.occlusionTextureIndex = static_cast<int32_t>(material.occlusionTexture->textureIndex);
+        newMaterial.occlusionStrength = material.occlusionTexture->strength;
+    }
+
+    if (material.emissiveTexture.has_value()) {
+        newMaterial.emissiveTextureIndex = static_cast<int32_t>(material.emissiveTexture->textureIndex);
     }
 
     materials.emplace_back(newMaterial);
@@ -201,11 +279,421 @@ bool Adren::Model::loadMaterials(fastgltf::Material& material) {
 
 bool Adren::Model::loadTextures(fastgltf::Texture& texture) {
     Texture newTex{};
-    newTex.index = texture.imageIndex.value();
+
+    // KHR_texture_basisu images win when they can be transcoded, UASTC ones use the plain image. Without one the
+    // KTX2 image is loaded, refused with a reason and left white.
+    auto transcodable = [&](size_t index) {
+        return index < images.size() && Adren::Ktx2::supported(images[index].source.data(), images[index].source.size());
+    };
+
+    if (texture.basisuImageIndex.has_value() && (!texture.imageIndex.has_value() || transcodable(texture.basisuImageIndex.value()))) {
+        newTex.index = static_cast<int32_t>(texture.basisuImageIndex.value());
+    } else {
+        newTex.index = static_cast<int32_t>(texture.imageIndex.value_or(0));
+    }
+
+    // Textures without a sampler repeat and filter linearly with mipmaps, as glTF asks.
+    if (texture.samplerIndex.has_value() && texture.samplerIndex.value() < gltfModel.samplers.size()) {
+        fastgltf::Sampler& sampler = gltfModel.samplers[texture.samplerIndex.value()];
+
+        auto address = [](fastgltf::Wrap wrap) {
+            switch (wrap) {
+            case fastgltf::Wrap::ClampToEdge: return VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            case fastgltf::Wrap::MirroredRepeat: return VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+            default: return VK_SAMPLER_ADDRESS_MODE_REPEAT;
+            }
+        };
+
+        newTex.sampler.addressModeU = address(sampler.wrapS);
+        newTex.sampler.addressModeV = address(sampler.wrapT);
+
+        if (sampler.magFilter.has_value()) {
+            newTex.sampler.magFilter = sampler.magFilter.value() == fastgltf::Filter::Nearest ? VK_FILTER_NEAREST : VK_FILTER_LINEAR;
+        }
+
+        if (sampler.minFilter.has_value()) {
+            switch (sampler.minFilter.value()) {
+            case fastgltf::Filter::Nearest:
+                newTex.sampler.minFilter = VK_FILTER_NEAREST;
+                newTex.sampler.mipmaps = false;
+                break;
+            case fastgltf::Filter::Linear:
+                newTex.sampler.mipmaps = false;
+                break;
+            case fastgltf::Filter::NearestMipMapNearest:
+                newTex.sampler.minFilter = VK_FILTER_NEAREST;
+                newTex.sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+                break;
+            case fastgltf::Filter::LinearMipMapNearest:
+                newTex.sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+                break;
+            case fastgltf::Filter::NearestMipMapLinear:
+                newTex.sampler.minFilter = VK_FILTER_NEAREST;
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
     textures.push_back(newTex);
     return true;
 }
 
+void Adren::Model::assignImageRoles() {
+    std::vector<int32_t> roles(images.size(), -1);
+
+    auto assign = [&](size_t textureIndex, ImageRole role) {
+        if (textureIndex >= textures.size()) return;
+
+        int32_t image = textures[textureIndex].index;
+        if (image < 0 || image >= static_cast<int32_t>(images.size())) return;
+        roles[image] = std::max(roles[image], static_cast<int32_t>(role));
+    };
+
+    for (auto& material : gltfModel.materials) {
+        if (material.pbrData.baseColorTexture.has_value()) assign(material.pbrData.baseColorTexture->textureIndex, ImageRole::Color);
+        if (material.emissiveTexture.has_value()) assign(material.emissiveTexture->textureIndex, ImageRole::Color);
+        if (material.pbrData.metallicRoughnessTexture.has_value()) assign(material.pbrData.metallicRoughnessTexture->textureIndex, ImageRole::Linear);
+        if (material.normalTexture.has_value()) assign(material.normalTexture->textureIndex, ImageRole::Normal);
+        if (material.occlusionTexture.has_value()) assign(material.occlusionTexture->textureIndex, ImageRole::Mask);
+    }
+
+    // Images nothing samples stay color, everything but color holds data that must not be read as sRGB.
+    for (size_t i = 0; i < images.size(); i++) {
+        if (roles[i] >= 0) images[i].role = static_cast<ImageRole>(roles[i]);
+        if (images[i].role != ImageRole::Color && images[i].format == VK_FORMAT_R8G8B8A8_SRGB) {
+            images[i].format = VK_FORMAT_R8G8B8A8_UNORM;
+        }
+    }
+}
+
+void Adren::Model::buildAtlases() {
+    if (!packAtlases || images.size() < 2 || gltfModel.materials.empty()) return;
+
+    // Images start out packable and drop out as soon as one use can't work with a tile.
+    std::vector<bool> packable(images.size(), true);
+    std::vector<bool> used(images.size(), false);
+
+    auto image = [&](size_t textureIndex) {
+        return textureIndex < textures.size() ? textures[textureIndex].index : -1;
+    };
+
+    for (auto& material : gltfModel.materials) {
+        auto& baseColor = material.pbrData.baseColorTexture;
+        bool alone = baseColor.has_value() && baseColor->texCoordIndex == 0 && baseColor->transform == nullptr &&
+            !material.pbrData.metallicRoughnessTexture.has_value() && !material.normalTexture.has_value() &&
+            !material.occlusionTexture.has_value() && !material.emissiveTexture.has_value();
+
+        for (size_t textureIndex : {
+            baseColor.has_value() ? baseColor->textureIndex : SIZE_MAX,
+            material.pbrData.metallicRoughnessTexture.has_value() ? material.pbrData.metallicRoughnessTexture->textureIndex : SIZE_MAX,
+            material.normalTexture.has_value() ? material.normalTexture->textureIndex : SIZE_MAX,
+            material.occlusionTexture.has_value() ? material.occlusionTexture->textureIndex : SIZE_MAX,
+            material.emissiveTexture.has_value() ? material.emissiveTexture->textureIndex : SIZE_MAX }) {
+            int32_t index = image(textureIndex);
+            if (index < 0 || index >= static_cast<int32_t>(images.size())) continue;
+            if (!alone) packable[index] = false;
+            used[index] = true;
+        }
+    }
+
+    // Texture coordinates outside the image would wrap into the neighbours of the tile.
+    for (Mesh& mesh : meshes) {
+        for (Primitive& primitive : mesh.primitives) {
+            if (primitive.materialIndex < 0 || primitive.materialIndex >= static_cast<int32_t>(gltfModel.materials.size())) continue;
+
+            auto& baseColor = gltfModel.materials[primitive.materialIndex].pbrData.baseColorTexture;
+            int32_t index = baseColor.has_value() ? image(baseColor->textureIndex) : -1;
+            if (index < 0 || index >= static_cast<int32_t>(images.size())) continue;
+
+            glm::vec4 range = primitive.dequant.texCoord;
+            const float epsilon = 1e-4f;
+            if (glm::any(glm::lessThan(glm::vec2(range), glm::vec2(-epsilon))) ||
+                glm::any(glm::greaterThan(glm::vec2(range) + glm::vec2(range.z, range.w), glm::vec2(1.0f + epsilon)))) {
+                packable[index] = false;
+            }
+        }
+    }
+
+    std::vector<Atlas::Tile> tiles;
+    std::vector<uint32_t> tileImages;
+    for (uint32_t i = 0; i < images.size(); i++) {
+        if (!packable[i] || !used[i] || images[i].role != ImageRole::Color || images[i].source.empty()) continue;
+        if (Adren::Ktx2::isKtx2(images[i].source.data(), images[i].source.size())) continue;
+
+        glTFImage decoded{};
+        decodeImage(decoded, images[i].source);
+        if (decoded.failed || static_cast<uint32_t>(std::max(decoded.width, decoded.height)) > atlasMaxDimension) continue;
+
+        Atlas::Tile tile{};
+        tile.width = static_cast<uint32_t>(decoded.width);
+        tile.height = static_cast<uint32_t>(decoded.height);
+        tile.rgba = std::move(decoded.pixels);
+        tiles.push_back(std::move(tile));
+        tileImages.push_back(i);
+    }
+
+    if (tiles.size() < 2) return;
+
+    std::vector<Atlas::Page> pages = Atlas::pack(tiles, atlasPageSize, atlasLevels, true);
+    if (pages.empty()) return;
+
+    // Packed images leave the list and the pages go on its end, textures follow their image.
+    std::vector<int32_t> tileOf(images.size(), -1);
+    for (size_t t = 0; t < tiles.size(); t++) {
+        if (tiles[t].page >= 0) tileOf[tileImages[t]] = static_cast<int32_t>(t);
+    }
+
+    std::vector<int32_t> remap(images.size(), -1);
+    std::vector<glTFImage> packed;
+    for (uint32_t i = 0; i < images.size(); i++) {
+        if (tileOf[i] >= 0) continue;
+        remap[i] = static_cast<int32_t>(packed.size());
+        packed.push_back(std::move(images[i]));
+    }
+
+    uint32_t firstPage = static_cast<uint32_t>(packed.size());
+    for (size_t p = 0; p < pages.size(); p++) {
+        glTFImage page{};
+        page.name = "Atlas " + std::to_string(p);
+        page.width = static_cast<int>(pages[p].size);
+        page.height = static_cast<int>(pages[p].size);
+        page.format = VK_FORMAT_R8G8B8A8_SRGB;
+        page.levels = std::move(pages[p].levels);
+        page.pixels = std::move(pages[p].pixels);
+        page.size = page.pixels.size();
+        page.hash = Adren::Cook::hash(page.pixels.data(), page.pixels.size());
+        packed.push_back(std::move(page));
+    }
+
+    // Primitives are moved into the page before the texture indices change.
+    for (Mesh& mesh : meshes) {
+        for (Primitive& primitive : mesh.primitives) {
+            if (primitive.materialIndex < 0 || primitive.materialIndex >= static_cast<int32_t>(gltfModel.materials.size())) continue;
+
+            auto& baseColor = gltfModel.materials[primitive.materialIndex].pbrData.baseColorTexture;
+            int32_t index = baseColor.has_value() ? image(baseColor->textureIndex) : -1;
+            if (index < 0 || index >= static_cast<int32_t>(images.size()) || tileOf[index] < 0) continue;
+
+            glm::vec4 transform = tiles[tileOf[index]].transform;
+            glm::vec4& texCoord = primitive.dequant.texCoord;
+            texCoord = glm::vec4(glm::vec2(transform) + glm::vec2(texCoord) * glm::vec2(transform.z, transform.w),
+                glm::vec2(texCoord.z, texCoord.w) * glm::vec2(transform.z, transform.w));
+        }
+    }
+
+    for (Texture& texture : textures) {
+        // Tiles can't repeat inside their page, only coordinates within the image were allowed in.
+        if (texture.index >= 0 && texture.index < static_cast<int32_t>(images.size()) && tileOf[texture.index] >= 0) {
+            texture.sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            texture.sampler.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        }
+
+        if (texture.index >= 0 && texture.index < static_cast<int32_t>(images.size())) {
+            texture.index = tileOf[texture.index] >= 0 ? static_cast<int32_t>(firstPage) + tiles[tileOf[texture.index]].page : remap[texture.index];
+        }
+    }
+
+#ifdef ADREN_DEBUG
+    std::cerr << "-> Atlas: " << images.size() - (packed.size() - pages.size()) << " images into " << pages.size() << " pages" << std::endl;
+#endif
+
+    images = std::move(packed);
+}
+
+const std::byte* Adren::Model::bufferData(size_t bufferIndex) {
+    const std::byte* bytes = nullptr;
+
+    std::visit(fastgltf::visitor {
+        [](auto& arg) {},
+        [&](fastgltf::sources::Array& vector) {
+            bytes = reinterpret_cast<const std::byte*>(vector.bytes.data());
+        },
+        [&](fastgltf::sources::Vector& vector) {
+            bytes = reinterpret_cast<const std::byte*>(vector.bytes.data());
+        }
+    }, gltfModel.buffers[bufferIndex].data);
+
+    return bytes;
+}
+
+// EXT_meshopt_compression views point at a fallback buffer that usually has no data of its own. Every such
+// buffer gets storage of its full length, the views are decoded into it and it replaces the fallback.
+void Adren::Model::decompressBufferViews() {
+    struct Job {
+        const uint8_t* source;
+        size_t sourceSize;
+        uint8_t* destination;
+        fastgltf::CompressedBufferView* compression;
+    };
+
+    std::unordered_map<size_t, std::vector<uint8_t>> targets;
+    std::vector<Job> jobs;
+
+    for (auto& view : gltfModel.bufferViews) {
+        if (!view.meshoptCompression) continue;
+        fastgltf::CompressedBufferView& compression = *view.meshoptCompression;
+
+        const std::byte* source = bufferData(compression.bufferIndex);
+        size_t decodedSize = compression.count * compression.byteStride;
+        fastgltf::Buffer& target = gltfModel.buffers[view.bufferIndex];
+
+        if (source == nullptr || compression.byteOffset + compression.byteLength > gltfModel.buffers[compression.bufferIndex].byteLength ||
+            decodedSize > view.byteLength || view.byteOffset + view.byteLength > target.byteLength) {
+            std::cerr << "-> Compressed buffer view is out of bounds, skipping it" << std::endl;
+            continue;
+        }
+
+        auto inserted = targets.try_emplace(view.bufferIndex);
+        if (inserted.second) {
+            // A fallback buffer that was loaded keeps its bytes, only the compressed views are overwritten.
+            inserted.first->second.resize(target.byteLength);
+            if (const std::byte* existing = bufferData(view.bufferIndex)) {
+                memcpy(inserted.first->second.data(), existing, target.byteLength);
+            }
+        }
+
+        jobs.push_back({ reinterpret_cast<const uint8_t*>(source) + compression.byteOffset, compression.byteLength,
+                         inserted.first->second.data() + view.byteOffset, &compression });
+    }
+
+    if (jobs.empty()) return;
+
+    // The views never overlap, so they are decoded on as many threads as there are.
+    std::vector<uint8_t> decoded(jobs.size(), 0);
+    Adren::Tools::parallelFor(jobs.size(), [&](size_t i) {
+        Job& job = jobs[i];
+        auto mode = static_cast<Adren::Meshopt::Mode>(job.compression->mode);
+        auto filter = static_cast<Adren::Meshopt::Filter>(job.compression->filter);
+        decoded[i] = Adren::Meshopt::decode(job.destination, job.compression->count, job.compression->byteStride,
+                                            job.source, job.sourceSize, mode, filter);
+    });
+
+    for (size_t i = 0; i < jobs.size(); i++) {
+        if (!decoded[i]) std::cerr << "-> Failed to decode a compressed buffer view" << std::endl;
+    }
+
+    for (auto& [bufferIndex, bytes] : targets) {
+        gltfModel.buffers[bufferIndex].data = fastgltf::sources::Vector{ std::move(bytes), fastgltf::MimeType::GltfBuffer };
+    }
+
+#ifdef ADREN_DEBUG
+    std::cerr << "-> Decompressed Buffer Views: " << jobs.size() << " into " << targets.size() << " buffers" << std::endl;
+#endif
+}
+
+bool Adren::Model::rawAccessor(fastgltf::Accessor& accessor, const std::byte*& data, size_t& stride) {
+    if (!accessor.bufferViewIndex.has_value() || accessor.sparse.has_value()) return false;
+
+    auto& bufferView = gltfModel.bufferViews[accessor.bufferViewIndex.value()];
+    const std::byte* bytes = bufferData(bufferView.bufferIndex);
+    if (bytes == nullptr) return false;
+
+    data = bytes + bufferView.byteOffset + accessor.byteOffset;
+    stride = bufferView.byteStride.value_or(fastgltf::getElementByteSize(accessor.type, accessor.componentType));
+    return true;
+}
+
+void Adren::Model::quantizePositions(fastgltf::Accessor& accessor, std::vector<Vertex>& vertices, Dequantization& dequant) {
+    const std::byte* data = nullptr;
+    size_t stride = 0;
+
+    // KHR_mesh_quantization positions stored as unsigned shorts already match the vertex format.
+    if (accessor.componentType == fastgltf::ComponentType::UnsignedShort && rawAccessor(accessor, data, stride)) {
+        for (size_t i = 0; i < accessor.count; i++) {
+            uint16_t position[3];
+            memcpy(position, data + i * stride, sizeof(position));
+            vertices[i].pos = glm::u16vec4(position[0], position[1], position[2], 0);
+        }
+
+        dequant.position = glm::vec4(0.0f);
+        dequant.positionScale = glm::vec4(accessor.normalized ? 1.0f : 65535.0f);
+        return;
+    }
+
+    std::vector<glm::vec3> positions(accessor.count);
+    fastgltf::iterateAccessorWithIndex<glm::vec3>(gltfModel, accessor, [&](glm::vec3 position, size_t idx) {
+        positions[idx] = position;
+    });
+
+    glm::vec3 min = glm::vec3(FLT_MAX);
+    glm::vec3 max = glm::vec3(-FLT_MAX);
+
+    for (const glm::vec3& position : positions) {
+        min = glm::min(min, position);
+        max = glm::max(max, position);
+    }
+
+    glm::vec3 extent = positions.empty() ? glm::vec3(0.0f) : max - min;
+    glm::vec3 inverse = glm::vec3(
+        extent.x > 0.0f ? 1.0f / extent.x : 0.0f,
+        extent.y > 0.0f ? 1.0f / extent.y : 0.0f,
+        extent.z > 0.0f ? 1.0f / extent.z : 0.0f
+    );
+
+    for (size_t i = 0; i < positions.size(); i++) {
+        glm::vec3 normalized = (positions[i] - min) * inverse;
+        vertices[i].pos = glm::u16vec4(Adren::Tools::quantizeUnorm16(normalized.x), Adren::Tools::quantizeUnorm16(normalized.y), 
+                                       Adren::Tools::quantizeUnorm16(normalized.z), 0);
+    }
+
+    dequant.position = glm::vec4(positions.empty() ? glm::vec3(0.0f) : min, 0.0f);
+    dequant.positionScale = glm::vec4(extent, 0.0f);
+}
+
+void Adren::Model::quantizeTexCoords(fastgltf::Accessor& accessor, std::vector<Vertex>& vertices, Dequantization& dequant) {
+    const std::byte* data = nullptr;
+    size_t stride = 0;
+
+    // Quantized texture coordinates are passed through, normalized bytes are widened without any loss.
+    if (accessor.componentType == fastgltf::ComponentType::UnsignedShort && rawAccessor(accessor, data, stride)) {
+        for (size_t i = 0; i < accessor.count; i++) {
+            uint16_t texCoord[2];
+            memcpy(texCoord, data + i * stride, sizeof(texCoord));
+            vertices[i].texCoord = glm::u16vec2(texCoord[0], texCoord[1]);
+        }
+
+        float scale = accessor.normalized ? 1.0f : 65535.0f;
+        dequant.texCoord = glm::vec4(0.0f, 0.0f, scale, scale);
+        return;
+    }
+
+    if (accessor.componentType == fastgltf::ComponentType::UnsignedByte && accessor.normalized && rawAccessor(accessor, data, stride)) {
+        for (size_t i = 0; i < accessor.count; i++) {
+            const uint8_t* texCoord = reinterpret_cast<const uint8_t*>(data + i * stride);
+            vertices[i].texCoord = glm::u16vec2(texCoord[0] * 257, texCoord[1] * 257);
+        }
+
+        dequant.texCoord = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+        return;
+    }
+
+    std::vector<glm::vec2> texCoords(accessor.count);
+    fastgltf::iterateAccessorWithIndex<glm::vec2>(gltfModel, accessor, [&](glm::vec2 texCoord, size_t idx) {
+        texCoords[idx] = texCoord;
+    });
+
+    glm::vec2 min = glm::vec2(FLT_MAX);
+    glm::vec2 max = glm::vec2(-FLT_MAX);
+
+    for (const glm::vec2& texCoord : texCoords) {
+        min = glm::min(min, texCoord);
+        max = glm::max(max, texCoord);
+    }
+
+    glm::vec2 extent = texCoords.empty() ? glm::vec2(0.0f) : max - min;
+    glm::vec2 inverse = glm::vec2(extent.x > 0.0f ? 1.0f / extent.x : 0.0f, extent.y > 0.0f ? 1.0f / extent.y : 0.0f);
+
+    for (size_t i = 0; i < texCoords.size(); i++) {
+        glm::vec2 normalized = (texCoords[i] - min) * inverse;
+        vertices[i].texCoord = glm::u16vec2(Adren::Tools::quantizeUnorm16(normalized.x), Adren::Tools::quantizeUnorm16(normalized.y));
+    }
+
+    if (texCoords.empty()) min = glm::vec2(0.0f);
+    dequant.texCoord = glm::vec4(min, extent);
+}
+
 bool Adren::Model::loadMesh(fastgltf::Mesh& mesh) {
     Mesh newMesh{};
     newMesh.primitives.resize(mesh.primitives.size());
@@ -225,15 +713,10 @@ bool Adren::Model::loadMesh(fastgltf::Mesh& mesh) {
 
         if (prim->indicesAccessor.has_value()) {
             auto& iAccessor = gltfModel.accessors[prim->indicesAccessor.value()];
-            auto& iBufferView = gltfModel.accessors[iAccessor.bufferViewIndex.value()];
-
-            primitive.firstIndex = static_cast<uint32_t>(iAccessor.byteOffset + iBufferView.byteOffset) / fastgltf::getElementByteSize(iAccessor.type, iAccessor.componentType);
 
             fastgltf::iterateAccessor<uint32_t>(gltfModel, iAccessor, [&](uint32_t index) {
                 tempIndices.push_back(index);
             });
-
-            primitive.indexCount = iAccessor.count;
         }
 
         if (pos != prim->attributes.end()) {
@@ -241,28 +724,39 @@ bool Adren::Model::loadMesh(fastgltf::Mesh& mesh) {
             if (!vAccessor.bufferViewIndex.has_value()) continue;
             
             tempVertices.resize(vAccessor.count);
-
-            fastgltf::iterateAccessorWithIndex<glm::vec3>(gltfModel, vAccessor, [&](glm::vec3 position, size_t idx) {
-                tempVertices[idx].pos = position;
-                tempVertices[idx].color = glm::vec3(1.0f);
-            });
+            quantizePositions(vAccessor, tempVertices, primitive.dequant);
 
             primitive.vertexCount = vAccessor.count;
         }
 
+        auto normal = prim->findAttribute("NORMAL");
+
+        if (normal != prim->attributes.end()) {
+            auto& nAccessor = gltfModel.accessors[normal->second];
+
+            fastgltf::iterateAccessorWithIndex<glm::vec3>(gltfModel, nAccessor, [&](glm::vec3 direction, size_t idx) {
+                tempVertices[idx].normal = Adren::Tools::octEncode(direction);
+            });
+        }
+
         auto texCoord = prim->findAttribute("TEXCOORD_0");
 
         if (texCoord != prim->attributes.end()) {
             auto& tAccessor = gltfModel.accessors[texCoord->second];
             if (!tAccessor.bufferViewIndex.has_value()) continue;
 
-            fastgltf::iterateAccessorWithIndex<glm::vec2>(gltfModel, tAccessor, [&](glm::vec2 position, size_t idx) {
-                tempVertices[idx].texCoord = position;
-            });
+            quantizeTexCoords(tAccessor, tempVertices, primitive.dequant);
+        }
 
+        if (prim->materialIndex.has_value()) {
             primitive.materialIndex = prim->materialIndex.value();
         }
 
+        // Indices stay relative to the primitive's first vertex.
+        primitive.firstIndex = static_cast<uint32_t>(indices.size());
+        primitive.indexCount = static_cast<uint32_t>(tempIndices.size());
+        primitive.firstVertex = static_cast<uint32_t>(vertices.size());
+
         indices.insert(indices.end(), tempIndices.begin(), tempIndices.end());
         vertices.insert(vertices.end(), tempVertices.begin(), tempVertices.end());
     }
@@ -271,19 +765,152 @@ bool Adren::Model::loadMesh(fastgltf::Mesh& mesh) {
     return true;
 }
 
+void Adren::Model::generateLods() {
+    std::vector<std::vector<uint32_t>> results(meshes.size());
+
+    // Every mesh is simplified on its own thread, the levels are appended to the index list afterwards.
+    Adren::Tools::parallelFor(meshes.size(), [&](size_t m) {
+        for (Primitive& primitive : meshes[m].primitives) {
+            if (primitive.indexCount == 0) continue;
+
+            std::vector<glm::vec3> positions(primitive.vertexCount);
+            for (uint32_t i = 0; i < primitive.vertexCount; i++) {
+                positions[i] = Adren::Tools::dequantizePosition(vertices[primitive.firstVertex + i], primitive.dequant);
+            }
+
+            std::vector<uint32_t> current(indices.begin() + primitive.firstIndex, indices.begin() + primitive.firstIndex + primitive.indexCount);
+            std::vector<uint32_t> simplified;
+            float error = 0.0f;
+
+            for (uint32_t level = 0; level < Adren::Simplify::maxLevels; level++) {
+                size_t target = (current.size() / 6) * 3;
+                error += Adren::Simplify::simplify(positions, current.data(), current.size(), target, simplified);
+
+                // A level that barely removes anything is not worth switching to.
+                if (simplified.empty() || simplified.size() > current.size() * 85 / 100) break;
+
+                Lod lod{};
+                lod.firstIndex = static_cast<uint32_t>(results[m].size());
+                lod.indexCount = static_cast<uint32_t>(simplified.size());
+                lod.error = error;
+                primitive.lods.push_back(lod);
+
+                results[m].insert(results[m].end(), simplified.begin(), simplified.end());
+                current.swap(simplified);
+            }
+        }
+    });
+
+    for (size_t m = 0; m < meshes.size(); m++) {
+        uint32_t base = static_cast<uint32_t>(indices.size());
+
+        for (Primitive& primitive : meshes[m].primitives) {
+            for (Lod& lod : primitive.lods) {
+                lod.firstIndex += base;
+            }
+        }
+
+        indices.insert(indices.end(), results[m].begin(), results[m].end());
+    }
+}
+
+void Adren::Model::buildMeshlets() {
+    struct MeshMeshlets {
+        std::vector<Meshlet> meshlets;
+        std::vector<uint32_t> vertices;
+        std::vector<uint32_t> triangles;
+    };
+
+    std::vector<MeshMeshlets> results(meshes.size());
+
+    // Every mesh is split on its own thread, the results are stitched together afterwards.
+    Adren::Tools::parallelFor(meshes.size(), [&](size_t m) {
+        for (Primitive& primitive : meshes[m].primitives) {
+            if (primitive.indexCount == 0) continue;
+
+            std::vector<glm::vec3> positions(primitive.vertexCount);
+            for (uint32_t i = 0; i < primitive.vertexCount; i++) {
+                positions[i] = Adren::Tools::dequantizePosition(vertices[primitive.firstVertex + i], primitive.dequant);
+            }
+
+            glm::vec3 lo = positions.empty() ? glm::vec3(0.0f) : positions[0];
+            glm::vec3 hi = lo;
+            for (const glm::vec3& position : positions) {
+                lo = glm::min(lo, position);
+                hi = glm::max(hi, position);
+            }
+
+            glm::vec3 center = (lo + hi) * 0.5f;
+            float radius = 0.0f;
+            for (const glm::vec3& position : positions) {
+                radius = glm::max(radius, glm::distance(center, position));
+            }
+            primitive.sphere = glm::vec4(center, radius);
+
+            // The ratio of texture space to surface area, how many texels of a texture land on a unit of surface.
+            double surfaceArea = 0.0, uvArea = 0.0;
+            for (uint32_t i = primitive.firstIndex; i + 2 < primitive.firstIndex + primitive.indexCount; i += 3) {
+                uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+                if (a >= primitive.vertexCount || b >= primitive.vertexCount || c >= primitive.vertexCount) continue;
+
+                surfaceArea += glm::length(glm::cross(positions[b] - positions[a], positions[c] - positions[a]));
+
+                glm::vec2 ta = Adren::Tools::dequantizeTexCoord(vertices[primitive.firstVertex + a], primitive.dequant);
+                glm::vec2 tb = Adren::Tools::dequantizeTexCoord(vertices[primitive.firstVertex + b], primitive.dequant);
+                glm::vec2 tc = Adren::Tools::dequantizeTexCoord(vertices[primitive.firstVertex + c], primitive.dequant);
+                glm::vec2 u = tb - ta, v = tc - ta;
+                uvArea += std::abs(u.x * v.y - u.y * v.x);
+            }
+            primitive.uvDensity = surfaceArea > 0.0 ? static_cast<float>(std::sqrt(uvArea / surfaceArea)) : 0.0f;
+
+            // Every LOD level is split too, so the culling pass can switch levels by switching meshlet ranges.
+            auto split = [&](uint32_t firstIndex, uint32_t indexCount, uint32_t& firstMeshlet, uint32_t& meshletCount) {
+                firstMeshlet = static_cast<uint32_t>(results[m].meshlets.size());
+                Adren::Meshlets::build(positions, indices.data() + firstIndex, indexCount,
+                                       results[m].meshlets, results[m].vertices, results[m].triangles);
+                meshletCount = static_cast<uint32_t>(results[m].meshlets.size()) - firstMeshlet;
+            };
+
+            split(primitive.firstIndex, primitive.indexCount, primitive.firstMeshlet, primitive.meshletCount);
+            for (Lod& lod : primitive.lods) {
+                split(lod.firstIndex, lod.indexCount, lod.firstMeshlet, lod.meshletCount);
+            }
+        }
+    });
+
+    for (size_t m = 0; m < meshes.size(); m++) {
+        uint32_t meshletBase = static_cast<uint32_t>(meshlets.size());
+
+        for (Meshlet meshlet : results[m].meshlets) {
+            meshlet.vertexOffset += static_cast<uint32_t>(meshletVertices.size());
+            meshlet.triangleOffset += static_cast<uint32_t>(meshletTriangles.size());
+            meshlets.push_back(meshlet);
+        }
+
+        for (Primitive& primitive : meshes[m].primitives) {
+            primitive.firstMeshlet += meshletBase;
+            for (Lod& lod : primitive.lods) {
+                lod.firstMeshlet += meshletBase;
+            }
+        }
+
+        meshletVertices.insert(meshletVertices.end(), results[m].vertices.begin(), results[m].vertices.end());
+        meshletTriangles.insert(meshletTriangles.end(), results[m].triangles.begin(), results[m].triangles.end());
+    }
+}
+
 void Adren::Model::drawMesh(size_t index, VkCommandBuffer& buffer, VkPipelineLayout& layout, VkDescriptorSet& set, Offset& offset) {
     Mesh& mesh = meshes[index];
 
     vkCmdBindDescriptorSets(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1, &set, 1, &offset.dynamic);
 
     for (auto& prim : mesh.primitives) {
-        if (prim.indexCount > 0) {
-            Texture& texture = textures[materials[prim.materialIndex].baseColorTextureIndex];
-            const int32_t index = texture.index + offset.texture;
-            vkCmdPushConstants(buffer, layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(index), &index);
-            vkCmdDrawIndexed(buffer, prim.indexCount, 1, offset.index, offset.vertex, 0);
-            offset.index += prim.indexCount;
-            offset.vertex += prim.vertexCount;
+        if (prim.indexCount > 0 && prim.indexType == offset.indexType && pipelineKey(prim) == offset.pipeline) {
+            PushConstant constants{};
+            constants.dequant = prim.dequant;
+            constants.materialIndex = materialIndex(prim);
+            vkCmdPushConstants(buffer, layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(constants), &constants);
+            vkCmdDrawIndexed(buffer, prim.indexCount, 1, prim.indexOffset, prim.vertexOffset, 0);
         }
     }
 }
@@ -295,6 +922,9 @@ void Adren::Model::drawNode(size_t index, VkCommandBuffer& buffer, VkPipelineLay
         drawMesh(node.meshIndex.value(), buffer, layout, set, offset);
     }
 
+    // Every node owns a matrix in the dynamic uniform buffer, in the order countMatrices walks them.
+    offset.dynamic += static_cast<uint32_t>(offset.align);
+
     for (auto& child : node.children) {
         drawNode(child, buffer, layout, set, offset);
     }
@@ -8,6 +8,7 @@
 #pragma once
 #include "types.h"
 #include <fastgltf/glm_element_traits.hpp>
+#include <string>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -19,32 +20,107 @@ class Model {
 public:
     Model(std::string_view modelPath);
 
+    // Small color images that are only the base color of materials with no other texture are packed into atlas pages
+    // on import. The primitives drawing them get the place of their tile folded into the texture coordinate dequantization,
+    // so only primitives whose coordinates stay inside the image can use it.
+    static inline bool packAtlases = true;
+    static inline uint32_t atlasMaxDimension = 128;
+    static inline uint32_t atlasPageSize = 1024;
+    static inline uint32_t atlasLevels = 4; // Gutters hold on this many levels, pages have no more.
+
+    // A lower detail index range of a primitive. It indexes the same vertices as the primitive itself.
+    // error is the sum of the errors of every simplification pass up to this level, in mesh space. Each pass
+    // simplifies the level before it, so the sum bounds the distance from the full mesh and only grows from level
+    // to level, which Culling::selectLods relies on.
+    struct Lod {
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+        float error = 0.0f;
+
+        uint32_t firstMeshlet = 0;
+        uint32_t meshletCount = 0;
+
+        // Filled in by Buffers like the matching members of Primitive.
+        uint32_t indexOffset = 0;
+        uint32_t meshletOffset = 0;
+    };
+
     struct Primitive {
-        uint32_t firstIndex;
-        uint32_t indexCount;
-        uint32_t vertexCount;
-        int32_t materialIndex;
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+        uint32_t firstVertex = 0;
+        uint32_t vertexCount = 0;
+        int32_t materialIndex = 0;
+        Dequantization dequant{};
+        glm::vec4 sphere = glm::vec4(0.0f); // Bounds in mesh space, xyz is the center, w the radius.
+        float uvDensity = 0.0f;             // Texture coordinate units per unit of mesh space.
+
+        uint32_t firstMeshlet = 0;
+        uint32_t meshletCount = 0;
+
+        // Coarser levels after the primitive itself, every level has about half the triangles of the last.
+        std::vector<Lod> lods;
+
+        // Where the primitive ended up in the shared buffers, filled in by Buffers::createModelBuffers.
+        VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+        uint32_t indexOffset = 0;
+        int32_t vertexOffset = 0;
+        uint32_t meshletOffset = 0;
     };
 
     struct Texture : ::Image {
         int32_t index;
+        SamplerKey sampler{};      // From the glTF sampler of the texture.
+        uint32_t samplerIndex = 0; // In the sampler cache, filled in by Samplers::assign.
     };
 
+    // What materials sample an image for, which decides how it gets block compressed. Roles are ordered by the
+    // channels they need, an image sampled for several keeps the last, e.g. packed occlusion and metallic roughness.
+    enum class ImageRole { Mask, Normal, Linear, Color };
+
     struct glTFImage {
-        unsigned char* buffer = nullptr;
-        VkDeviceSize bufferSize = 0;
+        // The encoded file and its hash, never changed once loaded. Decoding waits until the loader misses the cooked texture cache.
+        std::vector<uint8_t> source;
+        uint64_t hash = 0;
+        std::string name;
+
+        std::vector<unsigned char> pixels; // Empty until decoded, and again once cooked to disk.
 
         int height = 0;
         int width = 0;
+
+        // KTX2 images keep their own format and mip levels, everything else is decoded to RGBA8.
+        VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+        std::vector<VkDeviceSize> levels = { 0 }; // Offset of every mip level in pixels.
+        VkDeviceSize size = 0;                    // Bytes of all levels, kept when the pixels are dropped.
+        uint64_t cookedKey = 0;                   // Of the cooked file holding every level, 0 when there is none.
+        bool failed = false;                      // The pixels are a placeholder.
+
+        ImageRole role = ImageRole::Color;
+        float psnr = 0.0f;                        // Of the block compressed pixels, 0 when they weren't compressed.
     };
 
     struct Mesh {
         std::vector<Primitive> primitives;
     };
 
+    // Textures are indices into textures, -1 when the material has none.
     struct Material {
         glm::vec4 baseColorFactor = glm::vec4(1.0f);
-        uint32_t baseColorTextureIndex = 0;
+        glm::vec3 emissiveFactor = glm::vec3(0.0f);
+        float metallicFactor = 1.0f;
+        float roughnessFactor = 1.0f;
+        float normalScale = 1.0f;
+        float occlusionStrength = 1.0f;
+        int32_t baseColorTextureIndex = -1;
+        int32_t metallicRoughnessTextureIndex = -1;
+        int32_t normalTextureIndex = -1;
+        int32_t occlusionTextureIndex = -1;
+        int32_t emissiveTextureIndex = -1;
+        fastgltf::AlphaMode alphaMode = fastgltf::AlphaMode::Opaque;
+        float alphaCutoff = 0.5f;
+        bool doubleSided = false;
+        bool unlit = false;
     };
 
     std::vector<Vertex> vertices;
@@ -55,23 +131,72 @@ public:
     std::vector<Material> materials;
     std::vector<glm::vec2> texcoords;
 
+    // First slot of the images in the texture table, from Descriptor::allocateTextures, UINT32_MAX until then.
+    uint32_t textureBase = UINT32_MAX;
+
+    // First entry of materials in the material buffer, filled in by Buffers::createMaterialBuffer.
+    uint32_t materialBase = 0;
+
+    // Meshlet vertices index into the vertex range of their primitive.
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> meshletVertices;
+    std::vector<uint32_t> meshletTriangles;
+
     fastgltf::Asset gltfModel;
 
     uint32_t modelSize = 0;
     std::vector<glm::mat4> matrices;
 
     void drawNode(size_t index, VkCommandBuffer& buffer, VkPipelineLayout& layout, VkDescriptorSet& set, Offset& offset);
+
+    // The material of primitive, primitives without one use the glTF default material.
+    const Material& materialOf(const Primitive& primitive) const {
+        static const Material fallback{};
+        bool valid = primitive.materialIndex >= 0 && primitive.materialIndex < static_cast<int32_t>(materials.size());
+        return valid ? materials[primitive.materialIndex] : fallback;
+    }
+
+    // The pipeline features the material of primitive needs, lighting features are left out of unlit ones.
+    PipelineKey pipelineKey(const Primitive& primitive) const {
+        const Material& material = materialOf(primitive);
+        PipelineKey key{};
+        key.alphaMode = static_cast<uint32_t>(material.alphaMode);
+        key.doubleSided = material.doubleSided;
+        key.unlit = material.unlit;
+        key.emissive = !material.unlit && (material.emissiveTextureIndex >= 0 || glm::any(glm::greaterThan(material.emissiveFactor, glm::vec3(0.0f))));
+        key.normalMap = !material.unlit && material.normalTextureIndex >= 0;
+        return key;
+    }
+
+    // Entry of the material of primitive in the material buffer, primitives without one use the default at 0.
+    uint32_t materialIndex(const Primitive& primitive) const {
+        bool valid = primitive.materialIndex >= 0 && primitive.materialIndex < static_cast<int32_t>(materials.size());
+        return valid ? materialBase + static_cast<uint32_t>(primitive.materialIndex) : 0;
+    }
     void countMeshes(uint32_t& num, size_t index);
     void countMatrices(std::vector<glm::mat4>& matrices, size_t index, glm::mat4 matrix);
       
     // Taken from fastgltf's gl_viewer example.
     glm::mat4 getTransformMatrix(const fastgltf::Node& node, glm::mat4x4& base);
     std::vector<Texture> getTextures();
+
+    // Decodes source into the pixels of image, failures leave a single white texel.
+    // Nothing but image is touched, so images decode on the loader thread.
+    static void decodeImage(glTFImage& image, const std::vector<uint8_t>& source);
 private:
+    void decompressBufferViews();
+    const std::byte* bufferData(size_t bufferIndex);
     bool loadImages(fastgltf::Image& image);
     bool loadMaterials(fastgltf::Material& material);
     bool loadTextures(fastgltf::Texture& texture);
+    void assignImageRoles();
+    void buildAtlases();
     bool loadMesh(fastgltf::Mesh& mesh);
+    void generateLods();
+    void buildMeshlets();
+    bool rawAccessor(fastgltf::Accessor& accessor, const std::byte*& data, size_t& stride);
+    void quantizePositions(fastgltf::Accessor& accessor, std::vector<Vertex>& vertices, Dequantization& dequant);
+    void quantizeTexCoords(fastgltf::Accessor& accessor, std::vector<Vertex>& vertices, Dequantization& dequant);
     void drawMesh(size_t index, VkCommandBuffer& buffer, VkPipelineLayout& layout, VkDescriptorSet& set, Offset& offset);
 };
 }
\ No newline at end of file
@@ -6,6 +6,11 @@
 */
 #include "pipeline.h"
 #include "info.h"
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <memory>
 
 #ifdef ADREN_DEBUG
 #include "debugger.h"
@@ -14,8 +19,10 @@
 std::vector<uint32_t> Adren::Pipeline::readFile(const std::string& filename) {
     std::ifstream file(filename, std::ios::ate | std::ios::binary);
 
+    // shaders.bat deletes the modules before compiling them again, a hot reload can come by while one is missing.
     if (!file.is_open()) {
         std::cout << "Failed to open file!";
+        return {};
     }
 
     size_t fileSize = (size_t)file.tellg();
@@ -29,6 +36,15 @@ std::vector<uint32_t> Adren::Pipeline::readFile(const std::string& filename) {
     return buffer;
 }
 
+std::vector<uint32_t> Adren::Pipeline::readShader(const std::string& filename, VkShaderStageFlagBits stage, Reflection::Program& program) {
+    std::vector<uint32_t> code = readFile(filename);
+    if (!Reflection::reflect(code, stage, program)) {
+        throw std::runtime_error("Failed to load " + filename + ", build the Shaders target or run shaders.bat!");
+    }
+
+    return code;
+}
+
 VkShaderModule Adren::Pipeline::createShaderModule(const std::vector<uint32_t>& code) {
     VkShaderModuleCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
@@ -46,18 +62,73 @@ VkShaderModule Adren::Pipeline::createShaderModule(const std::vector<uint32_t>&
     return shaderModule;
 }
 
-void Adren::Pipeline::create(Swapchain& swapchain, VkDescriptorSetLayout& dLayout, VkRenderPass& renderpass) {
-    auto vertShaderCode = readFile("../engine/resources/shaders/vert.spv");
-    auto fragShaderCode = readFile("../engine/resources/shaders/frag.spv");
+void Adren::Pipeline::loadShaders() {
+    program = Reflection::Program{};
+    auto vertShaderCode = readShader("../engine/resources/shaders/vert.spv", VK_SHADER_STAGE_VERTEX_BIT, program);
+    auto fragShaderCode = readShader("../engine/resources/shaders/frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT, program);
+
+    // Without them every key would build the same pipeline, see build.
+    for (uint32_t id = 0; id < specializationCount; id++) {
+        if (!std::binary_search(program.specIds.begin(), program.specIds.end(), id)) {
+            throw std::runtime_error("frag.spv has no specialization constant " + std::to_string(id) + ", build the Shaders target!");
+        }
+    }
 
-    VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-    VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
+#ifdef ADREN_DEBUG
+    if (program.push.offset + program.push.size > sizeof(PushConstant)) {
+        std::cerr << "-> Reflection: the shaders read " << program.push.offset + program.push.size << " bytes of push constants, PushConstant has "
+            << sizeof(PushConstant) << "\n";
+    }
+#endif
 
+    // The modules stay alive for as long as pipelines can still be created from them.
+    vertModule = createShaderModule(vertShaderCode);
+    fragModule = createShaderModule(fragShaderCode);
+}
+
+void Adren::Pipeline::create(Swapchain& swapchain, const std::vector<VkDescriptorSetLayout>& layouts, VkRenderPass& renderpass, VkPipelineCache cache) {
+    this->renderpass = renderpass;
+    this->cache = cache;
+    layout = reflection.pipelineLayout(layouts, program.push);
+
+    // Attributes the vertex shader doesn't read are left out of the vertex input state.
+    attributes.clear();
+    for (const VkVertexInputAttributeDescription& attribute : Vertex::getAttributeDescriptions()) {
+        for (const Reflection::Input& input : program.inputs) {
+            if (input.location == attribute.location) attributes.push_back(attribute);
+        }
+    }
+
+#ifdef ADREN_DEBUG
+    if (attributes.size() != program.inputs.size()) {
+        std::cerr << "-> Reflection: vert.spv reads " << program.inputs.size() << " inputs, Vertex provides " << attributes.size() << " of them" << "\n";
+    }
+#endif
+
+    handle = get(PipelineKey{});
+}
+
+VkPipeline Adren::Pipeline::build(const PipelineKey& key, VkShaderModule vert, VkShaderModule frag) {
+    // Only reads state that is set in create, so keys can be built on several threads at once.
     VkPipelineShaderStageCreateInfo vertShaderStageInfo = Adren::Info::vertShaderStageInfo();
-    vertShaderStageInfo.module = vertShaderModule;
+    vertShaderStageInfo.module = vert;
 
     VkPipelineShaderStageCreateInfo fragShaderStageInfo = Adren::Info::fragShaderStageInfo();
-    fragShaderStageInfo.module = fragShaderModule;
+    fragShaderStageInfo.module = frag;
+
+    // Every feature of the key is a specialization constant of shader.frag, the driver drops the code of the ones that are off.
+    std::array<uint32_t, specializationCount> constants = { key.alphaMode, key.unlit, key.emissive, key.normalMap };
+    std::array<VkSpecializationMapEntry, specializationCount> specializationEntries{};
+    for (uint32_t i = 0; i < specializationEntries.size(); i++) {
+        specializationEntries[i] = { i, static_cast<uint32_t>(i * sizeof(uint32_t)), sizeof(uint32_t) };
+    }
+
+    VkSpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+    specializationInfo.pMapEntries = specializationEntries.data();
+    specializationInfo.dataSize = sizeof(constants);
+    specializationInfo.pData = constants.data();
+    fragShaderStageInfo.pSpecializationInfo = &specializationInfo;
 
     VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
@@ -65,18 +136,14 @@ void Adren::Pipeline::create(Swapchain& swapchain, VkDescriptorSetLayout& dLayou
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 
     auto bindingDescription = Vertex::getBindingDescription();
-    auto attributeDescriptions = Vertex::getAttributeDescriptions();
 
     vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
     vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+    vertexInputInfo.pVertexAttributeDescriptions = attributes.data();
 
     VkPipelineInputAssemblyStateCreateInfo inputAssembly = Adren::Info::inputAssembly();
 
-    VkRect2D scissor = Adren::Info::scissor();
-    scissor.extent = swapchain.extent;
-
     VkDynamicState states[2] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
 
     VkPipelineViewportStateCreateInfo viewportState = Adren::Info::viewportState();
@@ -90,36 +157,29 @@ void Adren::Pipeline::create(Swapchain& swapchain, VkDescriptorSetLayout& dLayou
     dynamicStateInfo.dynamicStateCount = 2;
     dynamicStateInfo.pDynamicStates = states;
 
+    // Opaque keys never discard so they keep early depth testing, blended ones don't write depth.
+    bool blend = key.alphaMode == 2;
+
     VkPipelineRasterizationStateCreateInfo rasterizer = Adren::Info::rasterizer();
+    rasterizer.cullMode = key.doubleSided ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT;
 
     VkPipelineMultisampleStateCreateInfo multisampling = Adren::Info::multisampling();
 
     VkPipelineDepthStencilStateCreateInfo depthStencil = Adren::Info::depthStencil();
+    depthStencil.depthWriteEnable = blend ? VK_FALSE : VK_TRUE;
 
     VkPipelineColorBlendAttachmentState colorBlendAttachment = Adren::Info::colorBlendAttachment();
+    colorBlendAttachment.blendEnable = blend ? VK_TRUE : VK_FALSE;
+    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
 
     VkPipelineColorBlendStateCreateInfo colorBlending = Adren::Info::colorBlending();
     colorBlending.pAttachments = &colorBlendAttachment;
 
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 1;
-    pipelineLayoutInfo.pSetLayouts = &dLayout;
-
-    VkPushConstantRange pushConstantRange{};
-    pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-    pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(glm::mat4);
-
-    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
-    pipelineLayoutInfo.pushConstantRangeCount = 1;
-
-#ifdef ADREN_DEBUG
-    Debugger::vibeCheck("PIPELINE LAYOUT", vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &layout));
-#else
-    vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &layout);
-#endif
-
     VkGraphicsPipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
     pipelineInfo.stageCount = 2;
@@ -137,17 +197,214 @@ void Adren::Pipeline::create(Swapchain& swapchain, VkDescriptorSetLayout& dLayou
     pipelineInfo.subpass = 0;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
+    VkPipeline pipeline = VK_NULL_HANDLE;
+
 #ifdef ADREN_DEBUG
-    Debugger::vibeCheck("PIPELINE", vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &handle));
+    Debugger::vibeCheck("PIPELINE", vkCreateGraphicsPipelines(device, cache, 1, &pipelineInfo, nullptr, &pipeline));
 #else
-    vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &handle);
+    vkCreateGraphicsPipelines(device, cache, 1, &pipelineInfo, nullptr, &pipeline);
 #endif
 
-    vkDestroyShaderModule(device, fragShaderModule, nullptr);
-    vkDestroyShaderModule(device, vertShaderModule, nullptr);
+    return pipeline;
+}
+
+VkPipeline Adren::Pipeline::get(const PipelineKey& key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = pipelines.find(key.bits());
+    if (found != pipelines.end()) return found->second;
+
+    VkPipeline pipeline = build(key, vertModule, fragModule);
+    pipelines[key.bits()] = pipeline;
+    return pipeline;
+}
+
+std::vector<VkPipeline> Adren::Pipeline::buildAll(const std::vector<PipelineKey>& keys, VkShaderModule vert, VkShaderModule frag) {
+    // Keys are handed out one at a time, the drivers compile the pipelines of separate calls in parallel.
+    std::vector<VkPipeline> built(keys.size(), VK_NULL_HANDLE);
+    std::atomic<size_t> next{ 0 };
+    size_t workerCount = std::min<size_t>(keys.size(), std::max(1u, std::thread::hardware_concurrency()));
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < workerCount; i++) {
+        workers.emplace_back([&]() {
+            for (size_t index = next++; index < keys.size(); index = next++) {
+                built[index] = build(keys[index], vert, frag);
+            }
+        });
+    }
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    return built;
+}
+
+void Adren::Pipeline::prepare(const std::vector<PipelineKey>& keys) {
+    std::vector<PipelineKey> missing;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const PipelineKey& key : keys) {
+            if (pipelines.count(key.bits()) > 0) continue;
+            if (std::find(missing.begin(), missing.end(), key) == missing.end()) missing.push_back(key);
+        }
+    }
+
+    if (missing.empty()) return;
+
+#ifdef ADREN_DEBUG
+    auto start = std::chrono::steady_clock::now();
+#endif
+
+    std::vector<VkPipeline> built = buildAll(missing, vertModule, fragModule);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < missing.size(); i++) {
+        // A key a draw created with get in the meantime keeps its pipeline.
+        auto [it, inserted] = pipelines.emplace(missing[i].bits(), built[i]);
+        if (!inserted) vkDestroyPipeline(device, built[i], nullptr);
+    }
+
+#ifdef ADREN_DEBUG
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "-> Pipelines: " << missing.size() << " created in " << ms << " ms" << "\n";
+#endif
+}
+
+void Adren::Pipeline::reload(HotReload& hotReload, DeletionQueue& deletion, uint32_t frameCount) {
+    auto rebuilt = std::make_shared<Rebuild>();
+    hotReload.run([this, rebuilt]() { rebuild(*rebuilt); }, [this, rebuilt, &deletion, frameCount]() { swap(*rebuilt, deletion, frameCount); });
+}
+
+void Adren::Pipeline::rebuild(Rebuild& rebuilt) {
+    auto vertShaderCode = readFile("../engine/resources/shaders/vert.spv");
+    auto fragShaderCode = readFile("../engine/resources/shaders/frag.spv");
+
+    Reflection::Program reloaded;
+    if (!Reflection::reflect(vertShaderCode, VK_SHADER_STAGE_VERTEX_BIT, reloaded) ||
+        !Reflection::reflect(fragShaderCode, VK_SHADER_STAGE_FRAGMENT_BIT, reloaded)) {
+        std::cerr << "-> Hot reload: vert.spv or frag.spv isn't SPIR-V, keeping the old pipelines" << std::endl;
+        return;
+    }
+
+    // The descriptor sets and vertex buffers were made for the old interface, a new one needs a restart.
+    if (!(reloaded == program)) {
+        std::cerr << "-> Hot reload: the shaders changed their bindings, push constants or inputs, restart to use them" << std::endl;
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    rebuilt.vertModule = createShaderModule(vertShaderCode);
+    rebuilt.fragModule = createShaderModule(fragShaderCode);
+
+    std::vector<PipelineKey> keys;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& [bits, pipeline] : pipelines) {
+            keys.push_back(PipelineKey::fromBits(bits));
+        }
+    }
+
+    std::vector<VkPipeline> built = buildAll(keys, rebuilt.vertModule, rebuilt.fragModule);
+    for (size_t i = 0; i < keys.size(); i++) {
+        rebuilt.pipelines[keys[i].bits()] = built[i];
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "-> Hot reload: " << keys.size() << " pipelines rebuilt in " << ms << " ms" << std::endl;
+}
+
+void Adren::Pipeline::swap(Rebuild& rebuilt, DeletionQueue& deletion, uint32_t frameCount) {
+    if (rebuilt.vertModule == VK_NULL_HANDLE) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Keys first asked for while the worker was building are built again from the new modules too.
+    for (auto& [bits, pipeline] : pipelines) {
+        if (rebuilt.pipelines.count(bits) == 0) rebuilt.pipelines[bits] = build(PipelineKey::fromBits(bits), rebuilt.vertModule, rebuilt.fragModule);
+    }
+
+    std::swap(pipelines, rebuilt.pipelines);
+    std::swap(vertModule, rebuilt.vertModule);
+    std::swap(fragModule, rebuilt.fragModule);
+    handle = pipelines[PipelineKey{}.bits()];
+
+    // The frames in flight were recorded with the old pipelines, they go once all of them have finished.
+    deletion.push(frameCount, [device = device, old = std::move(rebuilt.pipelines), vert = rebuilt.vertModule, frag = rebuilt.fragModule]() {
+        for (auto& [bits, pipeline] : old) {
+            vkDestroyPipeline(device, pipeline, nullptr);
+        }
+
+        vkDestroyShaderModule(device, frag, nullptr);
+        vkDestroyShaderModule(device, vert, nullptr);
+    });
+
+    rebuilt = Rebuild{};
+}
+
+VkPipeline Adren::Pipeline::createCompute(const std::string& path, VkPipelineLayout& computeLayout, VkDescriptorSetLayout& setLayout) {
+    Reflection::Program computeProgram;
+    auto computeShaderCode = readShader(path, VK_SHADER_STAGE_COMPUTE_BIT, computeProgram);
+
+    std::vector<VkDescriptorSetLayout> setLayouts = reflection.setLayouts(computeProgram);
+    computeLayout = reflection.pipelineLayout(setLayouts, computeProgram.push);
+    setLayout = setLayouts.empty() ? VK_NULL_HANDLE : setLayouts[0];
+
+    return buildCompute(computeShaderCode, computeLayout);
+}
+
+VkPipeline Adren::Pipeline::rebuildCompute(const std::string& path, VkPipelineLayout computeLayout) {
+    auto computeShaderCode = readFile(path);
+
+    Reflection::Program computeProgram;
+    if (!Reflection::reflect(computeShaderCode, VK_SHADER_STAGE_COMPUTE_BIT, computeProgram)) {
+        std::cerr << "-> Hot reload: " << path << " isn't SPIR-V, keeping the old pipeline" << std::endl;
+        return VK_NULL_HANDLE;
+    }
+
+    // The cache hands back the same layout for the same interface, any other layout wouldn't fit the descriptor sets.
+    if (reflection.pipelineLayout(reflection.setLayouts(computeProgram), computeProgram.push) != computeLayout) {
+        std::cerr << "-> Hot reload: " << path << " changed its bindings or push constants, restart to use it" << std::endl;
+        return VK_NULL_HANDLE;
+    }
+
+    return buildCompute(computeShaderCode, computeLayout);
+}
+
+VkPipeline Adren::Pipeline::buildCompute(const std::vector<uint32_t>& code, VkPipelineLayout computeLayout) {
+    VkShaderModule computeShaderModule = createShaderModule(code);
+
+    VkPipelineShaderStageCreateInfo computeShaderStageInfo{};
+    computeShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    computeShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    computeShaderStageInfo.module = computeShaderModule;
+    computeShaderStageInfo.pName = "main";
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage = computeShaderStageInfo;
+    pipelineInfo.layout = computeLayout;
+
+    VkPipeline computePipeline = VK_NULL_HANDLE;
+
+#ifdef ADREN_DEBUG
+    Debugger::vibeCheck("COMPUTE PIPELINE", vkCreateComputePipelines(device, cache, 1, &pipelineInfo, nullptr, &computePipeline));
+#else
+    vkCreateComputePipelines(device, cache, 1, &pipelineInfo, nullptr, &computePipeline);
+#endif
+
+    vkDestroyShaderModule(device, computeShaderModule, nullptr);
+    return computePipeline;
 }
 
 void Adren::Pipeline::cleanup() {
-    vkDestroyPipelineLayout(device, layout, nullptr);
-    vkDestroyPipeline(device, handle, nullptr);
+    for (auto& [bits, pipeline] : pipelines) {
+        vkDestroyPipeline(device, pipeline, nullptr);
+    }
+
+    pipelines.clear();
+    handle = VK_NULL_HANDLE;
+
+    vkDestroyShaderModule(device, fragModule, nullptr);
+    vkDestroyShaderModule(device, vertModule, nullptr);
 }
@@ -7,19 +7,74 @@
 #pragma once
 #include "devices.h"
 #include "swapchain.h"
+#include "reflection.h"
+#include "deletion.h"
+#include "hotreload.h"
+#include <unordered_map>
+#include <mutex>
 
 namespace Adren {
 class Pipeline {
 public:
-	Pipeline(Devices* devices) : device(devices->getDevice()) {}
-	void create(Swapchain& swapchain, VkDescriptorSetLayout& layout, VkRenderPass& renderpass);
-	VkPipeline handle = VK_NULL_HANDLE;
-	VkPipelineLayout layout = VK_NULL_HANDLE;
+	Pipeline(Devices* devices, Reflection& reflection) : device(devices->getDevice()), reflection(reflection) {}
+
+	// Reads vert.spv and frag.spv and reflects them into program, the descriptor layouts are built from it.
+	void loadShaders();
+	// Every pipeline, compute ones included, is created through cache, see PipelineCache.
+	void create(Swapchain& swapchain, const std::vector<VkDescriptorSetLayout>& layouts, VkRenderPass& renderpass, VkPipelineCache cache);
+	// The layouts of the compute shader come from reflection, setLayout is the one of set 0.
+	VkPipeline createCompute(const std::string& path, VkPipelineLayout& computeLayout, VkDescriptorSetLayout& setLayout);
+
+	// The pipeline specialized for key, created on first use and cached from then on.
+	VkPipeline get(const PipelineKey& key);
+
+	// Creates the pipelines of keys that aren't cached yet on worker threads and returns once all of them exist,
+	// so a scene doesn't stall its first frames on pipeline creation.
+	void prepare(const std::vector<PipelineKey>& keys);
+	size_t cached() const { return pipelines.size(); }
+
+	// Rebuilds every cached key from vert.spv and frag.spv on the worker of hotReload and swaps them in at the next
+	// frame boundary. Shaders whose interface changed are refused, the layouts and sets were made for the old one.
+	void reload(HotReload& hotReload, DeletionQueue& deletion, uint32_t frameCount);
+
+	// A compute pipeline from the module at path, VK_NULL_HANDLE unless it still fits computeLayout. Safe on any thread.
+	VkPipeline rebuildCompute(const std::string& path, VkPipelineLayout computeLayout);
+
+	VkPipeline handle = VK_NULL_HANDLE; // The default key, opaque and back face culled.
+	VkPipelineLayout layout = VK_NULL_HANDLE; // Owned by the layout cache of Reflection.
+	Reflection::Program program;
 	void cleanup();
+
+	// shader.frag has a specialization constant for each feature of PipelineKey, constant_id 0 to 3.
+	static const uint32_t specializationCount = 4;
 private:
 	static std::vector<uint32_t> readFile(const std::string& filename);
+
+	// Reads and reflects a module the engine can't run without, throws when it is missing or isn't SPIR-V.
+	static std::vector<uint32_t> readShader(const std::string& filename, VkShaderStageFlagBits stage, Reflection::Program& program);
 	VkShaderModule createShaderModule(const std::vector<uint32_t>& code);
+	VkPipeline build(const PipelineKey& key, VkShaderModule vert, VkShaderModule frag);
+	std::vector<VkPipeline> buildAll(const std::vector<PipelineKey>& keys, VkShaderModule vert, VkShaderModule frag);
+	VkPipeline buildCompute(const std::vector<uint32_t>& code, VkPipelineLayout computeLayout);
+
+	struct Rebuild {
+		VkShaderModule vertModule = VK_NULL_HANDLE; // Stays null when the shaders were refused.
+		VkShaderModule fragModule = VK_NULL_HANDLE;
+		std::unordered_map<uint32_t, VkPipeline> pipelines;
+	};
+
+	void rebuild(Rebuild& rebuilt);
+	void swap(Rebuild& rebuilt, DeletionQueue& deletion, uint32_t frameCount);
+
+	std::unordered_map<uint32_t, VkPipeline> pipelines; // PipelineKey::bits to pipeline.
+	std::mutex mutex;
 
+	VkShaderModule vertModule = VK_NULL_HANDLE;
+	VkShaderModule fragModule = VK_NULL_HANDLE;
+	VkRenderPass renderpass = VK_NULL_HANDLE;
+	VkPipelineCache cache = VK_NULL_HANDLE;
+	std::vector<VkVertexInputAttributeDescription> attributes;
 	VkDevice& device;
+	Reflection& reflection;
 };
 }
\ No newline at end of file
@@ -0,0 +1,125 @@
+/*
+    pipelinecache.cpp
+    Adrenaline Engine
+
+    Definitions for the persistent pipeline cache.
+*/
+
+#include "pipelinecache.h"
+#include "cook.h"
+#include <fstream>
+#include <cstring>
+
+#ifdef ADREN_DEBUG
+#include "debugger.h"
+#endif
+
+Adren::PipelineCache::Header Adren::PipelineCache::expectedHeader() {
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(gpu, &properties);
+
+    Header header{};
+    header.magic = magic;
+    header.version = version;
+    header.vendorID = properties.vendorID;
+    header.deviceID = properties.deviceID;
+    header.driverVersion = properties.driverVersion;
+    memcpy(header.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+    return header;
+}
+
+bool Adren::PipelineCache::read(std::vector<uint8_t>& data) {
+    std::ifstream stream(path, std::ios::binary | std::ios::ate);
+    if (!stream.is_open()) return false;
+
+    size_t fileSize = static_cast<size_t>(stream.tellg());
+    if (fileSize < sizeof(Header)) return false;
+    stream.seekg(0);
+
+    Header header;
+    stream.read(reinterpret_cast<char*>(&header), sizeof(Header));
+
+    // Any other GPU, driver or cache layout would reject the data or, worse, misread it.
+    Header expected = expectedHeader();
+    if (header.magic != expected.magic || header.version != expected.version || header.vendorID != expected.vendorID ||
+        header.deviceID != expected.deviceID || header.driverVersion != expected.driverVersion ||
+        memcmp(header.uuid, expected.uuid, VK_UUID_SIZE) != 0) return false;
+
+    if (header.dataSize == 0 || header.dataSize != fileSize - sizeof(Header)) return false;
+
+    data.resize(static_cast<size_t>(header.dataSize));
+    stream.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    if (!stream.good() || Cook::hash(data.data(), data.size()) != header.dataHash) {
+        data.clear();
+        return false;
+    }
+
+    return true;
+}
+
+void Adren::PipelineCache::create() {
+    std::vector<uint8_t> data;
+    warm = read(data);
+    loadedBytes = data.size();
+
+    VkPipelineCacheCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    createInfo.initialDataSize = data.size();
+    createInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+#ifdef ADREN_DEBUG
+    Adren::Debugger::vibeCheck("PIPELINE CACHE", vkCreatePipelineCache(device, &createInfo, nullptr, &handle));
+    if (warm) {
+        std::cerr << "-> Pipeline cache: loaded " << loadedBytes << " bytes from " << path.string() << "\n";
+    } else {
+        std::cerr << "-> Pipeline cache: no usable file at " << path.string() << ", starting cold" << "\n";
+    }
+#else
+    vkCreatePipelineCache(device, &createInfo, nullptr, &handle);
+#endif
+}
+
+void Adren::PipelineCache::save() {
+    if (handle == VK_NULL_HANDLE) return;
+
+    size_t dataSize = 0;
+    if (vkGetPipelineCacheData(device, handle, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) return;
+
+    std::vector<uint8_t> data(dataSize);
+    if (vkGetPipelineCacheData(device, handle, &dataSize, data.data()) != VK_SUCCESS) return;
+    data.resize(dataSize);
+
+    Header header = expectedHeader();
+    header.dataSize = data.size();
+    header.dataHash = Cook::hash(data.data(), data.size());
+
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+
+    std::filesystem::path temporary = path;
+    temporary += ".tmp";
+
+    {
+        std::ofstream stream(temporary, std::ios::binary | std::ios::trunc);
+        if (!stream.is_open()) return;
+
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        stream.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+        if (!stream.good()) return;
+    }
+
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+        return;
+    }
+
+#ifdef ADREN_DEBUG
+    std::cerr << "-> Pipeline cache: saved " << data.size() << " bytes to " << path.string() << "\n";
+#endif
+}
+
+void Adren::PipelineCache::cleanup() {
+    vkDestroyPipelineCache(device, handle, nullptr);
+    handle = VK_NULL_HANDLE;
+}
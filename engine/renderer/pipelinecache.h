@@ -0,0 +1,52 @@
+/*
+	pipelinecache.h
+	Adrenaline Engine
+
+	This keeps the driver's pipeline cache on disk between runs, so pipelines built in an earlier run are loaded
+	instead of compiled. A file is only used on the GPU and driver that wrote it.
+*/
+
+#pragma once
+#include "devices.h"
+#include <filesystem>
+
+namespace Adren {
+class PipelineCache {
+public:
+	PipelineCache(Devices* devices) : device(devices->getDevice()), gpu(devices->getGPU()) {}
+
+	// Starts from path when it was written for this device, otherwise from an empty cache.
+	void create();
+
+	// Writes the cache back through a temporary file, done once every pipeline of the run has been created.
+	void save();
+	void cleanup();
+
+	std::filesystem::path path = "cache/pipelines.bin";
+
+	VkPipelineCache handle = VK_NULL_HANDLE;
+	bool warm = false;          // True when create loaded the file.
+	size_t loadedBytes = 0;
+private:
+	// Precedes the driver's data in the file. The driver checks its own header too, but not the driver version.
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint32_t driverVersion;
+		uint8_t uuid[VK_UUID_SIZE];
+		uint64_t dataSize;
+		uint64_t dataHash;
+	};
+
+	static const uint32_t magic = 0x43504441; // "ADPC"
+	static const uint32_t version = 1;
+
+	Header expectedHeader();
+	bool read(std::vector<uint8_t>& data);
+
+	VkDevice& device;
+	VkPhysicalDevice& gpu;
+};
+}
@@ -0,0 +1,398 @@
+/*
+    reflection.cpp
+    Adrenaline Engine
+
+    Definitions for SPIR-V reflection and the layout cache.
+*/
+
+#include "reflection.h"
+#include "cook.h"
+#include <algorithm>
+
+#ifdef ADREN_DEBUG
+#include "debugger.h"
+#endif
+
+namespace {
+    // The few parts of the SPIR-V specification reflection needs.
+    const uint32_t spirvMagic = 0x07230203;
+
+    enum Op : uint32_t {
+        OpTypeBool = 20, OpTypeInt = 21, OpTypeFloat = 22, OpTypeVector = 23, OpTypeMatrix = 24,
+        OpTypeImage = 25, OpTypeSampler = 26, OpTypeSampledImage = 27, OpTypeArray = 28, OpTypeRuntimeArray = 29,
+        OpTypeStruct = 30, OpTypePointer = 32, OpConstant = 43, OpSpecConstant = 50, OpVariable = 59,
+        OpDecorate = 71, OpMemberDecorate = 72
+    };
+
+    enum Decoration : uint32_t {
+        DecorationSpecId = 1, DecorationBlock = 2, DecorationBufferBlock = 3, DecorationArrayStride = 6, DecorationBuiltIn = 11, DecorationLocation = 30,
+        DecorationBinding = 33, DecorationDescriptorSet = 34, DecorationOffset = 35
+    };
+
+    enum StorageClass : uint32_t {
+        StorageClassUniformConstant = 0, StorageClassInput = 1, StorageClassUniform = 2, StorageClassPushConstant = 9, StorageClassStorageBuffer = 12
+    };
+
+    struct Id {
+        uint32_t opcode = 0;
+        uint32_t type = 0;     // Element, component, column or pointee type, or the type of a variable.
+        uint32_t value = 0;    // Components, columns, bit width, constant value, array length id or storage class.
+        uint32_t sampled = 0;  // Of images, 1 when sampled and 2 when used as storage.
+        uint32_t set = 0;
+        uint32_t binding = UINT32_MAX;
+        uint32_t location = UINT32_MAX;
+        uint32_t arrayStride = 0;
+        uint32_t specId = UINT32_MAX;
+        bool block = false;
+        bool bufferBlock = false;
+        bool builtIn = false;
+        std::vector<uint32_t> members;
+        std::vector<uint32_t> offsets;
+    };
+
+    // Sizes follow the explicit layout the offsets were decorated with, matrix columns are padded to vec4 like std140 and std430 do.
+    uint32_t typeSize(const std::vector<Id>& ids, uint32_t id) {
+        const Id& type = ids[id];
+        switch (type.opcode) {
+            case OpTypeBool: return 4;
+            case OpTypeInt:
+            case OpTypeFloat: return type.value / 8;
+            case OpTypeVector: return type.value * typeSize(ids, type.type);
+            case OpTypeMatrix: return type.value * std::max(typeSize(ids, type.type), 16u);
+            case OpTypeArray: {
+                uint32_t length = ids[type.value].value;
+                return length * (type.arrayStride > 0 ? type.arrayStride : typeSize(ids, type.type));
+            }
+            case OpTypeStruct: {
+                uint32_t size = 0;
+                for (size_t m = 0; m < type.members.size(); m++) {
+                    size = std::max(size, type.offsets[m] + typeSize(ids, type.members[m]));
+                }
+                return size;
+            }
+            default: return 0;
+        }
+    }
+
+    uint32_t componentCount(const std::vector<Id>& ids, uint32_t id) {
+        const Id& type = ids[id];
+        if (type.opcode == OpTypeVector) return type.value;
+        if (type.opcode == OpTypeMatrix) return type.value * componentCount(ids, type.type);
+        return 1;
+    }
+}
+
+uint32_t Adren::Reflection::Program::setCount() const {
+    return bindings.empty() ? 0 : bindings.back().set + 1;
+}
+
+bool Adren::Reflection::Program::operator==(const Program& other) const {
+    if (bindings.size() != other.bindings.size() || inputs.size() != other.inputs.size() || specIds != other.specIds) return false;
+    if (push.stageFlags != other.push.stageFlags || push.offset != other.push.offset || push.size != other.push.size) return false;
+
+    for (size_t i = 0; i < bindings.size(); i++) {
+        const Binding& a = bindings[i];
+        const Binding& b = other.bindings[i];
+        if (a.set != b.set || a.layout.binding != b.layout.binding || a.layout.descriptorType != b.layout.descriptorType ||
+            a.layout.descriptorCount != b.layout.descriptorCount || a.layout.stageFlags != b.layout.stageFlags) return false;
+    }
+
+    for (size_t i = 0; i < inputs.size(); i++) {
+        if (inputs[i].location != other.inputs[i].location || inputs[i].components != other.inputs[i].components) return false;
+    }
+
+    return true;
+}
+
+std::vector<VkDescriptorSetLayoutBinding> Adren::Reflection::Program::setBindings(uint32_t set) const {
+    std::vector<VkDescriptorSetLayoutBinding> result;
+    for (const Binding& binding : bindings) {
+        if (binding.set == set) result.push_back(binding.layout);
+    }
+
+    return result;
+}
+
+bool Adren::Reflection::reflect(const std::vector<uint32_t>& code, VkShaderStageFlagBits stage, Program& program) {
+    if (code.size() < 5 || code[0] != spirvMagic) return false;
+
+    std::vector<Id> ids(code[3]);
+    std::vector<uint32_t> variables;
+
+    for (size_t i = 5; i < code.size();) {
+        uint32_t wordCount = code[i] >> 16;
+        uint32_t opcode = code[i] & 0xFFFF;
+        if (wordCount == 0 || i + wordCount > code.size()) return false;
+
+        const uint32_t* words = &code[i];
+        auto at = [&](uint32_t id) -> Id& { return ids[id < ids.size() ? id : 0]; };
+
+        switch (opcode) {
+            case OpDecorate: {
+                Id& target = at(words[1]);
+                switch (words[2]) {
+                    case DecorationSpecId: target.specId = words[3]; break;
+                    case DecorationBlock: target.block = true; break;
+                    case DecorationBufferBlock: target.bufferBlock = true; break;
+                    case DecorationArrayStride: target.arrayStride = words[3]; break;
+                    case DecorationBuiltIn: target.builtIn = true; break;
+                    case DecorationLocation: target.location = words[3]; break;
+                    case DecorationBinding: target.binding = words[3]; break;
+                    case DecorationDescriptorSet: target.set = words[3]; break;
+                }
+                break;
+            }
+            case OpMemberDecorate: {
+                Id& target = at(words[1]);
+                if (words[3] == DecorationBuiltIn) target.builtIn = true;
+                if (words[3] == DecorationOffset) {
+                    if (target.offsets.size() <= words[2]) target.offsets.resize(words[2] + 1, 0);
+                    target.offsets[words[2]] = words[4];
+                }
+                break;
+            }
+            case OpTypeBool:
+            case OpTypeSampler:
+                at(words[1]).opcode = opcode;
+                break;
+            case OpTypeInt:
+            case OpTypeFloat:
+                at(words[1]).opcode = opcode;
+                at(words[1]).value = words[2];
+                break;
+            case OpTypeVector:
+            case OpTypeMatrix:
+            case OpTypeArray:
+                at(words[1]).opcode = opcode;
+                at(words[1]).type = words[2];
+                at(words[1]).value = words[3];
+                break;
+            case OpTypeImage:
+                at(words[1]).opcode = opcode;
+                at(words[1]).sampled = words[7];
+                break;
+            case OpTypeSampledImage:
+            case OpTypeRuntimeArray:
+                at(words[1]).opcode = opcode;
+                at(words[1]).type = words[2];
+                break;
+            case OpTypeStruct: {
+                Id& type = at(words[1]);
+                type.opcode = opcode;
+                type.members.assign(words + 2, words + wordCount);
+                type.offsets.resize(type.members.size(), 0);
+                break;
+            }
+            case OpTypePointer:
+                at(words[1]).opcode = opcode;
+                at(words[1]).value = words[2];
+                at(words[1]).type = words[3];
+                break;
+            case OpConstant:
+            case OpSpecConstant:
+                at(words[2]).opcode = opcode;
+                at(words[2]).type = words[1];
+                at(words[2]).value = words[3];
+                break;
+            case OpVariable:
+                at(words[2]).opcode = opcode;
+                at(words[2]).type = words[1];
+                at(words[2]).value = words[3];
+                variables.push_back(words[2]);
+                break;
+        }
+
+        i += wordCount;
+    }
+
+    for (const Id& id : ids) {
+        if (id.specId != UINT32_MAX) program.specIds.push_back(id.specId);
+    }
+
+    for (uint32_t id : variables) {
+        const Id& variable = ids[id];
+        uint32_t typeId = ids[variable.type].type;
+
+        if (variable.value == StorageClassInput) {
+            if (stage == VK_SHADER_STAGE_VERTEX_BIT && !variable.builtIn && !ids[typeId].builtIn && variable.location != UINT32_MAX) {
+                program.inputs.push_back({ variable.location, componentCount(ids, typeId) });
+            }
+            continue;
+        }
+
+        if (variable.value == StorageClassPushConstant) {
+            const Id& block = ids[typeId];
+            uint32_t begin = block.offsets.empty() ? 0 : *std::min_element(block.offsets.begin(), block.offsets.end());
+            uint32_t end = typeSize(ids, typeId);
+
+            // One range for every stage, so a single vkCmdPushConstants covers the blocks of all of them.
+            if (program.push.size == 0) {
+                program.push.offset = begin;
+                program.push.size = end - begin;
+            } else {
+                uint32_t first = std::min(program.push.offset, begin);
+                program.push.size = std::max(program.push.offset + program.push.size, end) - first;
+                program.push.offset = first;
+            }
+
+            program.push.stageFlags |= stage;
+            continue;
+        }
+
+        if (variable.value != StorageClassUniformConstant && variable.value != StorageClassUniform && variable.value != StorageClassStorageBuffer) continue;
+
+        // Arrays of resources are unwrapped down to the resource, runtime arrays have no count of their own.
+        uint32_t count = 1;
+        while (ids[typeId].opcode == OpTypeArray || ids[typeId].opcode == OpTypeRuntimeArray) {
+            count = ids[typeId].opcode == OpTypeArray ? count * ids[ids[typeId].value].value : 0;
+            typeId = ids[typeId].type;
+        }
+
+        const Id& type = ids[typeId];
+        VkDescriptorType descriptorType;
+        if (type.opcode == OpTypeSampler) {
+            descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+        } else if (type.opcode == OpTypeSampledImage) {
+            descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        } else if (type.opcode == OpTypeImage) {
+            descriptorType = type.sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        } else if (variable.value == StorageClassStorageBuffer || type.bufferBlock) {
+            descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        } else if (type.block) {
+            descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        } else {
+            continue;
+        }
+
+        Binding binding{};
+        binding.set = variable.set;
+        binding.layout.binding = variable.binding == UINT32_MAX ? 0 : variable.binding;
+        binding.layout.descriptorType = descriptorType;
+        binding.layout.descriptorCount = count;
+        binding.layout.stageFlags = stage;
+
+        auto found = std::find_if(program.bindings.begin(), program.bindings.end(), [&](const Binding& other) {
+            return other.set == binding.set && other.layout.binding == binding.layout.binding;
+        });
+
+        if (found != program.bindings.end()) {
+#ifdef ADREN_DEBUG
+            if (found->layout.descriptorType != descriptorType || found->layout.descriptorCount != count) {
+                std::cerr << "-> Reflection: set " << binding.set << " binding " << binding.layout.binding << " differs between stages" << "\n";
+            }
+#endif
+            found->layout.stageFlags |= stage;
+            continue;
+        }
+
+        program.bindings.push_back(binding);
+    }
+
+    std::sort(program.bindings.begin(), program.bindings.end(), [](const Binding& a, const Binding& b) {
+        return a.set != b.set ? a.set < b.set : a.layout.binding < b.layout.binding;
+    });
+
+    std::sort(program.inputs.begin(), program.inputs.end(), [](const Input& a, const Input& b) { return a.location < b.location; });
+    std::sort(program.specIds.begin(), program.specIds.end());
+    program.specIds.erase(std::unique(program.specIds.begin(), program.specIds.end()), program.specIds.end());
+    return true;
+}
+
+VkDescriptorSetLayout Adren::Reflection::setLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+    const std::vector<VkDescriptorBindingFlags>& flags, VkDescriptorSetLayoutCreateFlags createFlags) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<uint32_t> key = { createFlags };
+    for (size_t i = 0; i < bindings.size(); i++) {
+        const VkDescriptorSetLayoutBinding& binding = bindings[i];
+        key.insert(key.end(), { binding.binding, static_cast<uint32_t>(binding.descriptorType), binding.descriptorCount,
+            binding.stageFlags, i < flags.size() ? flags[i] : 0u });
+    }
+
+    uint64_t hash = Cook::hash(key.data(), key.size() * sizeof(uint32_t));
+    std::vector<Entry<VkDescriptorSetLayout>>& bucket = setLayoutCache[hash];
+    for (Entry<VkDescriptorSetLayout>& entry : bucket) {
+        if (entry.key == key) return entry.handle;
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlags{};
+    bindingFlags.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlags.bindingCount = static_cast<uint32_t>(flags.size());
+    bindingFlags.pBindingFlags = flags.data();
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.flags = createFlags;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+    layoutInfo.pNext = flags.empty() ? nullptr : &bindingFlags;
+
+    VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+
+#ifdef ADREN_DEBUG
+    Adren::Debugger::vibeCheck("DESCRIPTOR SET LAYOUT", vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &layout));
+#else
+    vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &layout);
+#endif
+
+    bucket.push_back({ key, layout });
+    return layout;
+}
+
+VkPipelineLayout Adren::Reflection::pipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts, const VkPushConstantRange& push) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<uint32_t> key = { push.stageFlags, push.offset, push.size };
+    for (VkDescriptorSetLayout setLayout : setLayouts) {
+        uint64_t handle = (uint64_t)setLayout;
+        key.insert(key.end(), { static_cast<uint32_t>(handle), static_cast<uint32_t>(handle >> 32) });
+    }
+
+    uint64_t hash = Cook::hash(key.data(), key.size() * sizeof(uint32_t));
+    std::vector<Entry<VkPipelineLayout>>& bucket = pipelineLayoutCache[hash];
+    for (Entry<VkPipelineLayout>& entry : bucket) {
+        if (entry.key == key) return entry.handle;
+    }
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = push.size > 0 ? 1 : 0;
+    pipelineLayoutInfo.pPushConstantRanges = push.size > 0 ? &push : nullptr;
+
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+
+#ifdef ADREN_DEBUG
+    Adren::Debugger::vibeCheck("PIPELINE LAYOUT", vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &layout));
+#else
+    vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &layout);
+#endif
+
+    bucket.push_back({ key, layout });
+    return layout;
+}
+
+std::vector<VkDescriptorSetLayout> Adren::Reflection::setLayouts(const Program& program) {
+    std::vector<VkDescriptorSetLayout> layouts;
+    for (uint32_t set = 0; set < program.setCount(); set++) {
+        layouts.push_back(setLayout(program.setBindings(set)));
+    }
+
+    return layouts;
+}
+
+void Adren::Reflection::cleanup() {
+    for (auto& [hash, bucket] : pipelineLayoutCache) {
+        for (Entry<VkPipelineLayout>& entry : bucket) {
+            vkDestroyPipelineLayout(device, entry.handle, nullptr);
+        }
+    }
+
+    for (auto& [hash, bucket] : setLayoutCache) {
+        for (Entry<VkDescriptorSetLayout>& entry : bucket) {
+            vkDestroyDescriptorSetLayout(device, entry.handle, nullptr);
+        }
+    }
+
+    pipelineLayoutCache.clear();
+    setLayoutCache.clear();
+}
@@ -0,0 +1,68 @@
+/*
+	reflection.h
+	Adrenaline Engine
+
+	This reads what the SPIR-V modules declare, their descriptor bindings, push constants and vertex inputs, so the
+	layouts follow the shaders instead of being written out by hand. Layouts are created through a cache keyed by
+	their contents, pipelines with the same bindings share one and keep their sets bound across pipeline switches.
+*/
+
+#pragma once
+#include "devices.h"
+#include <unordered_map>
+#include <mutex>
+
+namespace Adren {
+class Reflection {
+public:
+	Reflection(Devices* devices) : device(devices->getDevice()) {}
+
+	struct Binding {
+		uint32_t set;
+		VkDescriptorSetLayoutBinding layout; // A descriptorCount of 0 is a runtime array.
+	};
+
+	struct Input {
+		uint32_t location;
+		uint32_t components;
+	};
+
+	// Everything the stages of one pipeline read, the stage flags of a binding are those of every stage using it.
+	struct Program {
+		std::vector<Binding> bindings; // Sorted by set, then binding.
+		std::vector<Input> inputs;     // Of the vertex stage.
+		VkPushConstantRange push{};    // Covers the blocks of every stage, 0 sized without push constants.
+		std::vector<uint32_t> specIds; // The constant_id of every specialization constant, sorted.
+
+		uint32_t setCount() const;
+		bool operator==(const Program& other) const;
+		std::vector<VkDescriptorSetLayoutBinding> setBindings(uint32_t set) const;
+	};
+
+	// Adds the module in code to program, false when code isn't SPIR-V.
+	static bool reflect(const std::vector<uint32_t>& code, VkShaderStageFlagBits stage, Program& program);
+
+	// Layouts are only created the first time their contents are asked for, the cache destroys them in cleanup.
+	VkDescriptorSetLayout setLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+		const std::vector<VkDescriptorBindingFlags>& flags = {}, VkDescriptorSetLayoutCreateFlags createFlags = 0);
+	VkPipelineLayout pipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts, const VkPushConstantRange& push);
+
+	// A set layout for every set of program, sets it doesn't use are empty.
+	std::vector<VkDescriptorSetLayout> setLayouts(const Program& program);
+
+	void cleanup();
+private:
+	template<typename T>
+	struct Entry {
+		std::vector<uint32_t> key;
+		T handle;
+	};
+
+	// Hash of the key to the layouts with it.
+	std::unordered_map<uint64_t, std::vector<Entry<VkDescriptorSetLayout>>> setLayoutCache;
+	std::unordered_map<uint64_t, std::vector<Entry<VkPipelineLayout>>> pipelineLayoutCache;
+
+	std::mutex mutex; // Hot reload checks layouts from its worker.
+	VkDevice& device;
+};
+}
@@ -161,18 +161,30 @@ void Adren::Renderer::initVulkan(GLFWwindow* window, Camera& camera) {
     swapchain.createImageViews(images); Adren::Debugger::log("Image views created..");
     images.createDepthResources(swapchain.extent); Adren::Debugger::log("Depth resources created..");
     renderpass.create(images.depth, swapchain.imgFormat, instance); Adren::Debugger::log("Main render pass created..");
-    descriptor.createLayout(models); Adren::Debugger::log("Descriptor set layout created..");
-    pipeline.create(swapchain, descriptor.layout, renderpass.handle); Adren::Debugger::log("Graphics pipeline created..");
+    pipeline.loadShaders(); Adren::Debugger::log("Shaders reflected..");
+    descriptor.createLayout(reflection, pipeline.program); Adren::Debugger::log("Descriptor set layout created..");
+    pipelineCache.create(); Adren::Debugger::log("Pipeline cache created..");
+    pipeline.create(swapchain, { descriptor.layout, descriptor.tableLayout }, renderpass.handle, pipelineCache.handle); Adren::Debugger::log("Graphics pipeline created..");
     createCommands(); Adren::Debugger::log("Command pool and buffers created..");
     createSyncObjects(); Adren::Debugger::log("Sync objects created..");
     swapchain.createFramebuffers(images.depth, renderpass.handle); Adren::Debugger::log("Main framebuffers created..");
-    images.loadTextures(instance, models, textures, commandPool); Adren::Debugger::log("Model textures created..");
+    images.createPlaceholder("../engine/resources/textures/white.png", commandPool); Adren::Debugger::log("Placeholder texture created..");
+    addTextures(models); Adren::Debugger::log("Model textures queued..");
     buffers.createModelBuffers(models, commandPool); Adren::Debugger::log("Index buffers created..");
+    buffers.createMeshletBuffers(models, commandPool); Adren::Debugger::log("Meshlet buffers created..");
     camera.create(window, buffers, devices->getAllocator()); Adren::Debugger::log("Camera created..");
     buffers.createUniformBuffers(swapchain.images, models); Adren::Debugger::log("Dynamic uniform buffer created..");
     buffers.updateDynamicUniformBuffer(models);
-    descriptor.createPool(swapchain.images); Adren::Debugger::log("Descriptor pool created..");
-    descriptor.createSets(textures, swapchain.images, camera.cam); Adren::Debugger::log("Descriptor sets created..");
+    culling.create(pipeline, maxFramesInFlight); Adren::Debugger::log("Culling pass created..");
+    descriptor.samplers.assign(models); Adren::Debugger::log("Samplers assigned..");
+    buffers.createMaterialBuffer(models, commandPool); Adren::Debugger::log("Material buffer created..");
+    culling.build(models, commandPool, buffers.dynamicUniform.align); Adren::Debugger::log("Culling draws created..");
+    preparePipelines(models); Adren::Debugger::log("Scene pipelines created..");
+    descriptor.createPool(maxFramesInFlight); Adren::Debugger::log("Descriptor pool created..");
+    descriptor.createSets(maxFramesInFlight, camera.cam); Adren::Debugger::log("Descriptor sets created..");
+    descriptor.updateTable(textures); Adren::Debugger::log("Texture table written..");
+    streaming.build(models, textures); Adren::Debugger::log("Texture streaming built..");
+    hotReload.start("../engine/resources/shaders"); Adren::Debugger::log("Watching shaders..");
 
 #ifdef ADREN_DEBUG
         Adren::Debugger::label(instance, devices->getDevice(), VK_OBJECT_TYPE_COMMAND_POOL, (uint64_t)commandPool, "PRIMARY COMMAND POOL");
@@ -245,9 +257,14 @@ void Adren::Renderer::render(Camera& camera) {
     vkWaitForFences(devices->getDevice(), 1, &frames[currentFrame].fence, VK_TRUE, UINT64_MAX);
 
     vkResetFences(devices->getDevice(), 1, &frames[currentFrame].fence);
+    culling.readStats(currentFrame);
 
-    uint32_t imageIndex;
-    vkAcquireNextImageKHR(devices->getDevice(), swapchain.handle, UINT64_MAX, frames[currentFrame].iSemaphore, VK_NULL_HANDLE, &imageIndex);
+    // Nothing the GPU still reads is freed before this point, and the descriptor set of this frame is free to write.
+    deletion.next();
+    descriptor.beginFrame(static_cast<uint32_t>(currentFrame), textures);
+    reloadShaders();
+
+    // Recording starts here so texture uploads and streaming copies run in frame order, ahead of the passes that sample them.
     auto commandBuffer = frames[currentFrame].commandBuffer;
 
     VkCommandBufferBeginInfo beginInfo{};
@@ -258,25 +275,72 @@ void Adren::Renderer::render(Camera& camera) {
     vkResetCommandPool(devices->getDevice(), frames[currentFrame].commandPool, 0);
     vkBeginCommandBuffer(commandBuffer, &beginInfo);
 
-    gui.beginRenderpass(camera, commandBuffer, pipeline.handle, buffers.vertex, buffers.index);
-    
+    for (uint32_t index : loader.update(instance, textures, commandBuffer)) {
+        descriptor.replaceTexture(index, textures);
+        streaming.track(index);
+    }
+
+    streaming.update(camera, textures, commandBuffer);
+
+    // The depth pyramid follows the size of the viewport depth.
+    VkExtent2D viewportExtent = { static_cast<uint32_t>(camera.getWidth()), static_cast<uint32_t>(camera.getHeight()) };
+    std::vector<VkImageView> depthViews = gui.depthViews();
+    if (culling.depthViews != depthViews || culling.depthExtent.width != viewportExtent.width || 
+        culling.depthExtent.height != viewportExtent.height) {
+        culling.resize(depthViews, viewportExtent, commandPool, maxFramesInFlight);
+    }
+
+    uint32_t imageIndex;
+    vkAcquireNextImageKHR(devices->getDevice(), swapchain.handle, UINT64_MAX, frames[currentFrame].iSemaphore, VK_NULL_HANDLE, &imageIndex);
+
+    if (culling.enabled) {
+        culling.dispatch(commandBuffer, currentFrame, camera);
+    }
+
+    gui.beginRenderpass(camera, commandBuffer, pipeline.handle, buffers.vertex);
+
+    // The texture table stays bound for the whole pass, set 0 is rebound per draw with its dynamic offset.
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout, 1, 1, &descriptor.tableSets[currentFrame], 0, nullptr);
     
-    if (models.size() >= 1) {
-        Offset offset{ 0, 0, 0, 0, 0, buffers.dynamicUniform.align };
-        for (Model* model : models) {
-            for (auto& scene : model->gltfModel.scenes) {
-                for (auto& node : scene.nodeIndices) {
-                    model->drawNode(node, commandBuffer, pipeline.layout, descriptor.sets[imageIndex], offset);
+    if (culling.enabled) {
+        culling.draw(commandBuffer, currentFrame, pipeline, descriptor.sets[currentFrame], camera);
+    } else if (models.size() >= 1) {
+        // Primitives are drawn in one group per index type so the index buffer is only rebound once.
+        std::array<std::pair<VkIndexType, size_t>, 2> groups = {{ 
+            { VK_INDEX_TYPE_UINT32, buffers.index32Count }, 
+            { VK_INDEX_TYPE_UINT16, buffers.index16Count } 
+        }};
+
+        // Keys go opaque, masked and blended. Only the culling pass sorts blended draws, here they keep scene order.
+        for (const PipelineKey& key : sceneKeys) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.get(key));
+
+            for (auto& [indexType, count] : groups) {
+                if (count == 0) continue;
+
+                VkDeviceSize regionOffset = indexType == VK_INDEX_TYPE_UINT16 ? buffers.index16Offset : 0;
+                vkCmdBindIndexBuffer(commandBuffer, buffers.index.buffer, regionOffset, indexType);
+
+                Offset offset{ 0, 0, 0, 0, buffers.dynamicUniform.align };
+                offset.indexType = indexType;
+                offset.pipeline = key;
+                for (Model* model : models) {
+                    for (auto& scene : model->gltfModel.scenes) {
+                        for (auto& node : scene.nodeIndices) {
+                            model->drawNode(node, commandBuffer, pipeline.layout, descriptor.sets[currentFrame], offset);
+                        }
+                    }
                 }
-                offset.texture += model->textures.size();
-                offset.dynamic *= static_cast<uint32_t>(offset.align);
             }
-            
         }
     }
     
     vkCmdEndRenderPass(commandBuffer);
 
+    if (culling.enabled) {
+        culling.buildPyramid(commandBuffer, currentFrame, camera);
+    }
+
     renderpass.begin(commandBuffer, imageIndex, swapchain.framebuffers, swapchain.extent);
 
     gui.draw(commandBuffer);
@@ -318,21 +382,45 @@ void Adren::Renderer::render(Camera& camera) {
     presentInfo.pImageIndices = &imageIndex;
 
     vkQueuePresentKHR(devices->getPresentQ(), &presentInfo);
+
+    // The GUI of the next frame shows the target that frame renders into.
+    gui.frame = static_cast<uint32_t>((currentFrame + 1) % maxFramesInFlight);
 }
 
 void Adren::Renderer::init(GLFWwindow* window, Camera& camera) { 
+    auto start = std::chrono::steady_clock::now();
+
     initVulkan(window, camera);
     window = window;
-    gui.init(camera, window, surface); 
+    gui.init(camera, window, surface, pipelineCache.handle, maxFramesInFlight); 
+    gui.frame = static_cast<uint32_t>((currentFrame + 1) % maxFramesInFlight);
+
+    // Compare runs with and without cache/pipelines.bin to see what the cache saves.
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "-> Startup took " << ms << " ms with a " << (pipelineCache.warm ? "warm" : "cold") << " pipeline cache, "
+        << pipeline.cached() << " pipelines" << std::endl;
+}
+
+void Adren::Renderer::wait() {
+    // Every submission signals the fence of its frame, so waiting on all of them covers all the work in flight.
+    std::array<VkFence, maxFramesInFlight> fences;
+    for (size_t i = 0; i < frames.size(); i++) {
+        fences[i] = frames[i].fence;
+    }
+
+    vkWaitForFences(devices->getDevice(), static_cast<uint32_t>(fences.size()), fences.data(), VK_TRUE, UINT64_MAX);
+
+    // Presentation has no fence, its semaphores are only free once the present queue is done.
+    vkQueueWaitIdle(devices->getPresentQ());
 }
 
 void Adren::Renderer::cleanup(Camera& camera) {
 #ifdef ADREN_DEBUG
     Adren::Debugger::log("Cleaning up Renderer!");
 #endif
-    vkDeviceWaitIdle(devices->getDevice());
-
-    vkDestroyCommandPool(devices->getDevice(), commandPool, nullptr);
+    loader.cleanup();
+    hotReload.cleanup();
+    wait();
 
     for (Frame& frame : frames) {
         vkDestroyCommandPool(devices->getDevice(), frame.commandPool, nullptr);
@@ -343,11 +431,22 @@ void Adren::Renderer::cleanup(Camera& camera) {
 
     Adren::Debugger::log("Rendering objects cleaned up!");
     camera.destroy(devices->getAllocator()); Adren::Debugger::log("Camera cleaned up!");
+    culling.cleanup(); Adren::Debugger::log("Culling cleaned up!");
+
+    // Slots still waiting on the loader share the placeholder, Images destroys it. Shared textures go with their last slot.
+    for (Model* m : models) removeTextures(m);
+    Adren::Debugger::log("Textures released!");
+
+    deletion.flush(); Adren::Debugger::log("Retired resources cleaned up!");
+
+    // Single time commands are freed by the deletion queue, so their pool goes after it.
+    vkDestroyCommandPool(devices->getDevice(), commandPool, nullptr);
     buffers.cleanup(); Adren::Debugger::log("Buffers cleaned up!");
     renderpass.cleanup(); Adren::Debugger::log("Render pass cleaned up!");
     swapchain.cleanup(); Adren::Debugger::log("Swapchain cleaned up!");
     pipeline.cleanup(); Adren::Debugger::log("Pipeline cleaned up!");
     descriptor.cleanup(); Adren::Debugger::log("Descriptor cleaned up!");
+    reflection.cleanup(); Adren::Debugger::log("Layouts cleaned up!");
     images.cleanup(); Adren::Debugger::log("Images cleaned up!");
     
     for (Model* m : models) {
@@ -357,16 +456,10 @@ void Adren::Renderer::cleanup(Camera& camera) {
         }
         delete m;
     }
-    
-    for (Image& t : textures) {
-        vkDestroyImageView(devices->getDevice(), t.view, nullptr);
-        vmaDestroyImage(devices->getAllocator(), t.image, t.memory);
-    }
-
-    Adren::Debugger::log("Textures cleaned up!");
 
     vkDestroySurfaceKHR(instance, surface, nullptr); Adren::Debugger::log("Surface cleaned up!");
     gui.cleanup(); Adren::Debugger::log("GUI cleaned up!");
+    pipelineCache.save(); pipelineCache.cleanup(); Adren::Debugger::log("Pipeline cache saved!");
     devices->cleanup(); Adren::Debugger::log("Devices cleaned up!");
 
 #ifdef ADREN_DEBUG 
@@ -383,49 +476,108 @@ void Adren::Renderer::reloadScene(std::vector<Model*>& models, Camera& camera) {
         What this does is re-render the entire screen when new elements are in. 
     */
     
-    vkDeviceWaitIdle(devices->getDevice());
-
     Adren::Debugger::log("Reloading the scene..");
 
-    vmaDestroyBuffer(devices->getAllocator(), buffers.index.buffer, buffers.index.memory);
-    Adren::Debugger::log("Index buffer destroyed..");
-    vmaDestroyBuffer(devices->getAllocator(), buffers.vertex.buffer, buffers.vertex.memory);
-    Adren::Debugger::log("Vertex buffer destroyed..");
-    vmaUnmapMemory(devices->getAllocator(), buffers.dynamicUniform.memory);
-    Adren::Debugger::log("Dynamic uniform buffer destroyed..");
-
-    for (const Model::Texture& texture : textures) {
-        vkDestroyImageView(devices->getDevice(), texture.view, nullptr);
-        vmaDestroyImage(devices->getAllocator(), texture.image, texture.memory);
-    }
-
-    textures.clear(); Adren::Debugger::log("Textures destroyed..");
-
-    vkDestroyDescriptorSetLayout(devices->getDevice(), descriptor.layout, nullptr);
-    Adren::Debugger::log("Descriptor set layout destroyed..");
+    // Nothing waits on the GPU here, the frames in flight keep drawing the old scene until their fences signal.
+    buffers.retireSceneBuffers(maxFramesInFlight);
+    Adren::Debugger::log("Scene buffers retired..");
+    culling.retireDraws(maxFramesInFlight);
+    Adren::Debugger::log("Culling draws retired..");
 
-    vkDestroyDescriptorPool(devices->getDevice(), descriptor.pool, nullptr);
-    Adren::Debugger::log("Descriptor pool destroyed..");
-
-    images.loadTextures(instance, models, textures, commandPool);
-    Adren::Debugger::log("Model textures reloaded..");
+    // Textures of models already in the scene stay in their slots, only the new models get slots and loads.
+    addTextures(models);
+    Adren::Debugger::log("Model textures queued..");
 
     buffers.createModelBuffers(models, commandPool);
+    buffers.createMeshletBuffers(models, commandPool);
     Adren::Debugger::log("Model buffers reloaded..");
 
     buffers.createUniformBuffers(swapchain.images, models);
     buffers.updateDynamicUniformBuffer(models);
     Adren::Debugger::log("Dynamic uniform buffers reloaded..");
 
+    descriptor.samplers.assign(models);
+    Adren::Debugger::log("Samplers assigned..");
+
+    buffers.createMaterialBuffer(models, commandPool);
+    Adren::Debugger::log("Material buffer reloaded..");
+
+    culling.build(models, commandPool, buffers.dynamicUniform.align);
+    Adren::Debugger::log("Culling draws reloaded..");
+
+    preparePipelines(models);
+    Adren::Debugger::log("Scene pipelines created..");
+
+    descriptor.writeBuffers(camera.cam);
+    Adren::Debugger::log("Descriptor sets rewritten..");
+
+    descriptor.updateTable(textures);
+    Adren::Debugger::log("Texture table updated..");
+
+    streaming.build(models, textures);
+    Adren::Debugger::log("Texture streaming rebuilt..");
+}
+
+void Adren::Renderer::addTextures(std::vector<Model*>& models) {
+    std::vector<Model*> added;
+    for (Model* model : models) {
+        if (model->textureBase != UINT32_MAX) continue;
+        model->textureBase = descriptor.allocateTextures(static_cast<uint32_t>(model->images.size()));
+        added.push_back(model);
+    }
+
+    textures.resize(descriptor.slotCount(), images.placeholder);
+    loader.load(added, textures);
+}
+
+void Adren::Renderer::removeTextures(Model* model) {
+    if (model->textureBase == UINT32_MAX) return;
+
+    uint32_t count = static_cast<uint32_t>(model->images.size());
+    for (uint32_t slot = model->textureBase; slot < model->textureBase + count && slot < textures.size(); slot++) {
+        Image t = textures[slot];
+        textures[slot] = images.placeholder;
+        if (!loader.release(slot) || t.image == images.placeholder.image) continue;
+
+        deletion.push(maxFramesInFlight, [device = devices->getDevice(), allocator = devices->getAllocator(), t]() {
+            vkDestroyImageView(device, t.view, nullptr);
+            vmaDestroyImage(allocator, t.image, t.memory);
+        });
+    }
+
+    descriptor.freeTextures(model->textureBase, count);
+    model->textureBase = UINT32_MAX;
+}
+
+void Adren::Renderer::preparePipelines(std::vector<Model*>& models) {
+    sceneKeys.clear();
+    for (Model* model : models) {
+        for (Model::Mesh& mesh : model->meshes) {
+            for (Model::Primitive& primitive : mesh.primitives) {
+                PipelineKey key = model->pipelineKey(primitive);
+                if (std::find(sceneKeys.begin(), sceneKeys.end(), key) == sceneKeys.end()) sceneKeys.push_back(key);
+            }
+        }
+    }
+
+    std::sort(sceneKeys.begin(), sceneKeys.end());
+    pipeline.prepare(sceneKeys);
+}
 
-    descriptor.createLayout(models);
-    Adren::Debugger::log("Descriptor set layout reloaded..");
+void Adren::Renderer::reloadShaders() {
+    hotReload.update();
 
-    descriptor.createPool(swapchain.images);
-    Adren::Debugger::log("Descriptor pool reloaded..");
+    bool graphics = false;
+    for (const std::string& name : hotReload.changed()) {
+        if (name == "vert.spv" || name == "frag.spv") {
+            graphics = true;
+        } else {
+            culling.reload(name, pipeline, hotReload, deletion, maxFramesInFlight);
+        }
+    }
 
-    descriptor.createSets(textures, swapchain.images, camera.cam);
-    Adren::Debugger::log("Descriptor sets reloaded..");
+    // Both graphics modules go into every pipeline, one rebuild covers a change to either of them.
+    if (graphics) pipeline.reload(hotReload, deletion, maxFramesInFlight);
 }
 
 void Adren::Renderer::processInput(GLFWwindow* window, Camera& camera) {
@@ -20,6 +20,11 @@
 
 #include "gui.h"
 #include "descriptor.h"
+#include "culling.h"
+#include "deletion.h"
+#include "streaming.h"
+#include "loader.h"
+#include "pipelinecache.h"
 
 namespace Adren {
 class Renderer {
@@ -28,21 +33,37 @@ public:
     void cleanup(Camera& camera);
     void render(Camera& camera);
     void reloadScene(std::vector<Model*>& models, Camera& camera);
-    void wait() { vkDeviceWaitIdle(devices->getDevice()); }
+
+    // Blocks until every submitted frame has finished and been presented, the GPU is idle afterwards.
+    void wait();
     void addModel(char* path);
     void processInput(GLFWwindow* window, Camera& camera);
     Model* cubes = new Model("../engine/resources/models/deccer/cubes.gltf");
     std::vector<Model*> models = { cubes };
 
     Devices* devices = new Devices{instance, surface};
-    GUI gui{devices, buffers, images, swapchain, instance};
+    GUI gui{devices, buffers, images, swapchain, instance, deletion};
 
     void createInstance();
     void initVulkan(GLFWwindow* window, Camera& camera);
     void createCommands();
     void createSyncObjects();
+
+    // Gives every model without slots a run of the texture table and queues its images.
+    void addTextures(std::vector<Model*>& models);
+
+    // Gives the slots of model back to the table. Textures no other slot uses go once the frames in flight are done.
+    void removeTextures(Model* model);
+
+    // Applies finished shader rebuilds and starts new ones for the .spv files that changed, once per frame.
+    void reloadShaders();
+    HotReload hotReload;
     std::vector<Model::Texture> textures;
 
+    // Collects the pipeline key of every primitive into sceneKeys and creates the missing pipelines up front.
+    void preparePipelines(std::vector<Model*>& models);
+    std::vector<PipelineKey> sceneKeys; // In draw order, opaque keys first.
+
     static const int maxFramesInFlight = 3;
 
     std::array<Frame, maxFramesInFlight> frames;
@@ -84,11 +105,17 @@ public:
     void setupDebugger();
 #endif
 
-    Buffers buffers{instance, devices};
+    Buffers buffers{instance, devices, deletion};
     Swapchain swapchain{devices};
-    Images images{devices, buffers};
+    Images images{devices, buffers, deletion, maxFramesInFlight};
     Renderpass renderpass{devices};
-    Descriptor descriptor{devices, buffers};
-    Pipeline pipeline{devices};
+    Reflection reflection{devices};
+    Descriptor descriptor{devices, buffers, deletion};
+    PipelineCache pipelineCache{devices};
+    Pipeline pipeline{devices, reflection};
+    Culling culling{instance, devices, buffers, deletion};
+    DeletionQueue deletion;
+    Loader loader{images};
+    Streaming streaming{devices, images, descriptor, deletion, loader};
 };
 }
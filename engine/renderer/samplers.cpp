@@ -0,0 +1,107 @@
+/*
+    samplers.cpp
+    Adrenaline Engine
+
+    Definitions for the sampler cache.
+*/
+
+#include "samplers.h"
+#include "info.h"
+#include <algorithm>
+
+#ifdef ADREN_DEBUG
+#include "debugger.h"
+#endif
+
+namespace {
+uint64_t hashKey(const SamplerKey& key) {
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&](uint64_t value) {
+        hash ^= value;
+        hash *= 1099511628211ull;
+    };
+
+    mix(key.magFilter);
+    mix(key.minFilter);
+    mix(key.mipmapMode);
+    mix(key.addressModeU);
+    mix(key.addressModeV);
+    mix(key.mipmaps);
+    mix(static_cast<uint64_t>(key.maxAnisotropy * 16.0f));
+    return hash;
+}
+}
+
+uint32_t Adren::Samplers::get(SamplerKey key) {
+    if (deviceAnisotropy == 0.0f) {
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(gpu, &properties);
+        deviceAnisotropy = properties.limits.maxSamplerAnisotropy;
+    }
+
+    // Anisotropy picks between mip levels, a sampler that only reads the first one gains nothing from it.
+    if (key.maxAnisotropy == 0.0f && key.mipmaps && key.minFilter == VK_FILTER_LINEAR) {
+        key.maxAnisotropy = std::min(maxAnisotropy, deviceAnisotropy);
+    }
+
+    if (key.maxAnisotropy <= 1.0f) key.maxAnisotropy = 0.0f;
+
+    uint64_t hash = hashKey(key);
+    auto& bucket = buckets[hash];
+    for (uint32_t index : bucket) {
+        if (keys[index] == key) return index;
+    }
+
+    if (samplers.size() >= capacity) {
+#ifdef ADREN_DEBUG
+        std::cerr << "-> Sampler cache is full, using the first sampler" << std::endl;
+#endif
+        return 0;
+    }
+
+    VkSamplerCreateInfo info = Adren::Info::samplerInfo();
+    info.magFilter = key.magFilter;
+    info.minFilter = key.minFilter;
+    info.mipmapMode = key.mipmapMode;
+    info.addressModeU = key.addressModeU;
+    info.addressModeV = key.addressModeV;
+    info.anisotropyEnable = key.maxAnisotropy > 0.0f ? VK_TRUE : VK_FALSE;
+    info.maxAnisotropy = std::max(key.maxAnisotropy, 1.0f);
+
+    // The usual way to sample without mipmaps, level 0 stays the only one that gets read.
+    if (!key.mipmaps) info.maxLod = 0.25f;
+
+    VkSampler sampler = VK_NULL_HANDLE;
+#ifdef ADREN_DEBUG
+    Adren::Debugger::vibeCheck("CREATE SAMPLER", vkCreateSampler(device, &info, nullptr, &sampler));
+#else
+    vkCreateSampler(device, &info, nullptr, &sampler);
+#endif
+
+    uint32_t index = static_cast<uint32_t>(samplers.size());
+    samplers.push_back(sampler);
+    keys.push_back(key);
+    bucket.push_back(index);
+    return index;
+}
+
+void Adren::Samplers::assign(std::vector<Model*>& models) {
+    // The first sampler is the default one, Descriptor::updateTable writes it into the unused elements of the sampler array.
+    if (samplers.empty()) get(SamplerKey{});
+
+    for (Model* model : models) {
+        for (Model::Texture& texture : model->textures) {
+            texture.samplerIndex = get(texture.sampler);
+        }
+    }
+}
+
+void Adren::Samplers::cleanup() {
+    for (VkSampler sampler : samplers) {
+        vkDestroySampler(device, sampler, nullptr);
+    }
+
+    samplers.clear();
+    keys.clear();
+    buckets.clear();
+}
@@ -0,0 +1,40 @@
+/*
+	samplers.h
+	Adrenaline Engine
+
+	This caches every sampler the textures of the scene need, one per distinct filter, mip mode, address modes
+	and anisotropy. The cache lives as long as the device, so reloads find the samplers they need already made.
+*/
+
+#pragma once
+#include "devices.h"
+#include "model.h"
+
+namespace Adren {
+class Samplers {
+public:
+	Samplers(Devices* devices) : device(devices->getDevice()), gpu(devices->getGPU()) {}
+
+	// Index of the sampler for key, creating it on first use. Falls back to the first sampler once the cache is full.
+	uint32_t get(SamplerKey key);
+
+	// Points every texture of models at the sampler its glTF sampler asks for.
+	void assign(std::vector<Model*>& models);
+
+	void cleanup();
+
+	// Size of the sampler array in the descriptor set layout.
+	static constexpr uint32_t capacity = 32;
+
+	float maxAnisotropy = 16.0f; // Clamped to what the device supports.
+
+	std::vector<VkSampler> samplers;
+private:
+	std::vector<SamplerKey> keys;
+	std::unordered_map<uint64_t, std::vector<uint32_t>> buckets; // Hash of the key to the samplers with it.
+	float deviceAnisotropy = 0.0f;
+
+	VkDevice& device;
+	VkPhysicalDevice& gpu;
+};
+}
@@ -0,0 +1,257 @@
+/*
+    simplify.cpp
+    Adrenaline Engine
+
+    Definitions for mesh simplification.
+    Based on Surface Simplification Using Quadric Error Metrics. Michael Garland, Paul Heckbert. 1997
+*/
+
+#include "simplify.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// A symmetric 4x4 matrix of squared plane distances, weighted by triangle area.
+struct Quadric {
+    double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+    double b0 = 0, b1 = 0, b2 = 0, c = 0, w = 0;
+
+    void addPlane(const glm::dvec3& n, double d, double weight) {
+        a00 += weight * n.x * n.x; a01 += weight * n.x * n.y; a02 += weight * n.x * n.z;
+        a11 += weight * n.y * n.y; a12 += weight * n.y * n.z; a22 += weight * n.z * n.z;
+        b0 += weight * n.x * d; b1 += weight * n.y * d; b2 += weight * n.z * d;
+        c += weight * d * d;
+        w += weight;
+    }
+
+    void add(const Quadric& q) {
+        a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+        b0 += q.b0; b1 += q.b1; b2 += q.b2; c += q.c; w += q.w;
+    }
+
+    // Mean squared distance of p to the planes.
+    double error(const glm::dvec3& p) const {
+        double r = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z
+            + 2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z)
+            + 2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+        return w > 0.0 ? std::max(r, 0.0) / w : 0.0;
+    }
+};
+
+struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    double cost;
+};
+
+inline uint64_t edgeKey(uint32_t a, uint32_t b) {
+    return (uint64_t(a) << 32) | b;
+}
+
+void removeDegenerates(std::vector<uint32_t>& indices) {
+    size_t write = 0;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+        if (a == b || b == c || a == c) continue;
+
+        indices[write++] = a;
+        indices[write++] = b;
+        indices[write++] = c;
+    }
+
+    indices.resize(write);
+}
+}
+
+float Adren::Simplify::simplify(const std::vector<glm::vec3>& positions, const uint32_t* indices, size_t indexCount,
+    size_t targetIndexCount, std::vector<uint32_t>& destination) {
+    size_t vertexCount = positions.size();
+    destination.assign(indices, indices + (indexCount / 3) * 3);
+    removeDegenerates(destination);
+
+    // Vertices sharing a position differ in other attributes, moving any of them would tear the seam.
+    std::unordered_map<glm::vec3, uint32_t> welded;
+    std::vector<uint32_t> weld(vertexCount);
+    std::vector<uint32_t> weldCount(vertexCount, 0);
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        weld[v] = welded.emplace(positions[v], v).first->second;
+        weldCount[weld[v]]++;
+    }
+
+    std::vector<uint8_t> locked(vertexCount, 0);
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        if (weldCount[weld[v]] > 1) locked[v] = 1;
+    }
+
+    // An edge without a twin is on a border, an edge used twice in one direction is non-manifold.
+    std::unordered_map<uint64_t, uint32_t> edges;
+    for (size_t i = 0; i < destination.size(); i += 3) {
+        for (int e = 0; e < 3; e++) {
+            edges[edgeKey(weld[destination[i + e]], weld[destination[i + (e + 1) % 3]])]++;
+        }
+    }
+
+    for (size_t i = 0; i < destination.size(); i += 3) {
+        for (int e = 0; e < 3; e++) {
+            uint32_t a = destination[i + e], b = destination[i + (e + 1) % 3];
+            auto twin = edges.find(edgeKey(weld[b], weld[a]));
+            if (twin == edges.end() || edges[edgeKey(weld[a], weld[b])] > 1 || twin->second > 1) {
+                locked[a] = 1;
+                locked[b] = 1;
+            }
+        }
+    }
+
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < destination.size(); i += 3) {
+        glm::dvec3 p0 = positions[destination[i]], p1 = positions[destination[i + 1]], p2 = positions[destination[i + 2]];
+        glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+        double length = glm::length(normal);
+        if (length == 0.0) continue;
+
+        normal /= length;
+        for (int k = 0; k < 3; k++) {
+            quadrics[destination[i + k]].addPlane(normal, -glm::dot(normal, p0), length * 0.5);
+        }
+    }
+
+    double resultError = 0.0;
+    std::vector<uint32_t> offsets(vertexCount + 1);
+    std::vector<uint32_t> adjacency;
+    std::vector<uint32_t> remap(vertexCount);
+    std::vector<uint8_t> touched(vertexCount);
+    std::vector<Collapse> collapses;
+
+    auto triangles = [&](uint32_t v) {
+        return std::make_pair(adjacency.begin() + offsets[v], adjacency.begin() + offsets[v + 1]);
+    };
+
+    auto contains = [&](uint32_t triangle, uint32_t v) {
+        return destination[triangle * 3] == v || destination[triangle * 3 + 1] == v || destination[triangle * 3 + 2] == v;
+    };
+
+    // A collapse is rejected when it flips a triangle or when the two vertices share more neighbours than
+    // the triangles on their edge, which would fold the surface onto itself.
+    auto allowed = [&](uint32_t from, uint32_t to, uint32_t& removed) {
+        removed = 0;
+        std::vector<uint32_t> fromRing, toRing;
+
+        auto [begin, end] = triangles(from);
+        for (auto t = begin; t != end; ++t) {
+            if (contains(*t, to)) {
+                removed++;
+                continue;
+            }
+
+            glm::dvec3 p[3], q[3];
+            for (int k = 0; k < 3; k++) {
+                uint32_t v = destination[*t * 3 + k];
+                p[k] = positions[v];
+                q[k] = v == from ? glm::dvec3(positions[to]) : p[k];
+                if (v != from) fromRing.push_back(v);
+            }
+
+            glm::dvec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+            glm::dvec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+            if (glm::dot(before, after) <= 0.0) return false;
+        }
+
+        if (removed == 0) return false;
+
+        auto [toBegin, toEnd] = triangles(to);
+        for (auto t = toBegin; t != toEnd; ++t) {
+            for (int k = 0; k < 3; k++) {
+                uint32_t v = destination[*t * 3 + k];
+                if (v != to) toRing.push_back(v);
+            }
+        }
+
+        for (auto t = begin; t != end; ++t) {
+            if (!contains(*t, to)) continue;
+            for (int k = 0; k < 3; k++) {
+                uint32_t v = destination[*t * 3 + k];
+                if (v != from && v != to) fromRing.push_back(v);
+            }
+        }
+
+        std::sort(fromRing.begin(), fromRing.end());
+        fromRing.erase(std::unique(fromRing.begin(), fromRing.end()), fromRing.end());
+        std::sort(toRing.begin(), toRing.end());
+        toRing.erase(std::unique(toRing.begin(), toRing.end()), toRing.end());
+
+        size_t shared = 0;
+        for (uint32_t v : fromRing) {
+            if (v != to && std::binary_search(toRing.begin(), toRing.end(), v)) shared++;
+        }
+
+        return shared == removed;
+    };
+
+    // Every pass collapses the cheapest edges that do not touch each other, then rebuilds the adjacency.
+    while (destination.size() > targetIndexCount) {
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for (uint32_t v : destination) offsets[v + 1]++;
+        for (size_t v = 0; v < vertexCount; v++) offsets[v + 1] += offsets[v];
+
+        adjacency.resize(destination.size());
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < destination.size(); i++) {
+            adjacency[fill[destination[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        collapses.clear();
+        for (size_t i = 0; i < destination.size(); i += 3) {
+            for (int e = 0; e < 3; e++) {
+                uint32_t a = destination[i + e], b = destination[i + (e + 1) % 3];
+                for (int direction = 0; direction < 2; direction++) {
+                    uint32_t from = direction == 0 ? a : b;
+                    uint32_t to = direction == 0 ? b : a;
+                    if (locked[from]) continue;
+
+                    Quadric q = quadrics[from];
+                    q.add(quadrics[to]);
+                    collapses.push_back({ from, to, q.error(positions[to]) });
+                }
+            }
+        }
+
+        if (collapses.empty()) break;
+
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& l, const Collapse& r) { return l.cost < r.cost; });
+
+        for (uint32_t v = 0; v < vertexCount; v++) remap[v] = v;
+        std::fill(touched.begin(), touched.end(), 0);
+
+        size_t needed = (destination.size() - targetIndexCount + 2) / 3;
+        size_t removedTotal = 0;
+        size_t performed = 0;
+
+        for (const Collapse& collapse : collapses) {
+            if (removedTotal >= needed) break;
+            if (touched[collapse.from] || touched[collapse.to]) continue;
+
+            uint32_t removed = 0;
+            if (!allowed(collapse.from, collapse.to, removed)) continue;
+
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to].add(quadrics[collapse.from]);
+            resultError = std::max(resultError, collapse.cost);
+
+            // The whole one-ring of the moved vertex is frozen so the checks above stay valid for this pass.
+            auto [begin, end] = triangles(collapse.from);
+            for (auto t = begin; t != end; ++t) {
+                for (int k = 0; k < 3; k++) touched[destination[*t * 3 + k]] = 1;
+            }
+
+            removedTotal += removed;
+            performed++;
+        }
+
+        if (performed == 0) break;
+
+        for (uint32_t& index : destination) index = remap[index];
+        removeDegenerates(destination);
+    }
+
+    return static_cast<float>(std::sqrt(resultError));
+}
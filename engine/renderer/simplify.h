@@ -0,0 +1,22 @@
+/*
+	simplify.h
+	Adrenaline Engine
+
+	This generates lower detail versions of index buffers with quadric error edge collapses.
+*/
+
+#pragma once
+#include "types.h"
+#include <vector>
+
+namespace Adren::Simplify {
+	// Every primitive gets at most this many levels on top of its full detail indices.
+	static const uint32_t maxLevels = 4;
+
+	// Collapses edges of an indexed triangle list until it has at most targetIndexCount indices or no
+	// collapse is left. Collapses only ever move a vertex onto a neighbour, so the result indexes the same
+	// vertices. Vertices on borders and attribute seams (vertices sharing a position) never move.
+	// Returns the error of the result as a distance in the units of positions.
+	float simplify(const std::vector<glm::vec3>& positions, const uint32_t* indices, size_t indexCount,
+		size_t targetIndexCount, std::vector<uint32_t>& destination);
+}
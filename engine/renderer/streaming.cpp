@@ -0,0 +1,223 @@
+/*
+    streaming.cpp
+    Adrenaline Engine
+
+    Definitions for texture streaming.
+*/
+
+#include "streaming.h"
+#include <functional>
+#include <algorithm>
+
+void Adren::Streaming::build(std::vector<Model*>& models, std::vector<Model::Texture>& textures) {
+    // Slots keep their entry across rebuilds, textures already streamed stay tracked.
+    demands.clear();
+    entries.resize(textures.size());
+
+    for (Model* model : models) {
+        if (model->textureBase == UINT32_MAX) continue;
+
+        uint32_t imageBase = model->textureBase;
+        for (uint32_t i = 0; i < model->images.size() && imageBase + i < entries.size(); i++) {
+            Entry& entry = entries[imageBase + i];
+            if (entry.model == model && entry.image == i) continue;
+
+            if (entry.levelCount > 0) {
+                stats.residentBytes -= residentSize(entry, entry.resident);
+                stats.textures--;
+            }
+
+            entry = Entry{};
+            entry.model = model;
+            entry.image = i;
+        }
+
+        // Nodes are walked in the same order as Model::countMatrices, every primitive asks for all the textures of its material.
+        uint32_t local = 0;
+        std::function<void(size_t)> walk = [&](size_t nodeIndex) {
+            auto& node = model->gltfModel.nodes[nodeIndex];
+            glm::mat4 matrix = model->matrices[local++];
+
+            if (node.meshIndex.has_value() && node.meshIndex.value() < model->meshes.size()) {
+                glm::vec3 axes = glm::vec3(glm::length(glm::vec3(matrix[0])), glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2])));
+                float scale = glm::max(axes.x, glm::max(axes.y, axes.z));
+
+                for (Model::Primitive& primitive : model->meshes[node.meshIndex.value()].primitives) {
+                    if (primitive.uvDensity <= 0.0f || scale <= 0.0f || primitive.materialIndex >= static_cast<int32_t>(model->gltfModel.materials.size())) continue;
+
+                    auto& material = model->gltfModel.materials[primitive.materialIndex];
+                    auto demand = [&](size_t textureIndex) {
+                        if (textureIndex >= model->textures.size()) return;
+
+                        int32_t image = model->textures[textureIndex].index;
+                        if (image < 0 || imageBase + image >= entries.size()) return;
+
+                        Demand request{};
+                        request.center = glm::vec3(matrix * glm::vec4(glm::vec3(primitive.sphere), 1.0f));
+                        request.radius = primitive.sphere.w * scale;
+                        request.texelsPerUnit = primitive.uvDensity / scale;
+                        request.texture = loader.owner(imageBase + static_cast<uint32_t>(image));
+                        demands.push_back(request);
+                    };
+
+                    if (material.pbrData.baseColorTexture.has_value()) demand(material.pbrData.baseColorTexture->textureIndex);
+                    if (material.pbrData.metallicRoughnessTexture.has_value()) demand(material.pbrData.metallicRoughnessTexture->textureIndex);
+                    if (material.normalTexture.has_value()) demand(material.normalTexture->textureIndex);
+                    if (material.occlusionTexture.has_value()) demand(material.occlusionTexture->textureIndex);
+                    if (material.emissiveTexture.has_value()) demand(material.emissiveTexture->textureIndex);
+                }
+            }
+
+            for (auto& child : node.children) {
+                walk(child);
+            }
+        };
+
+        for (auto& scene : model->gltfModel.scenes) {
+            for (auto& node : scene.nodeIndices) {
+                walk(node);
+            }
+        }
+    }
+}
+
+void Adren::Streaming::track(uint32_t index) {
+    if (index >= entries.size() || entries[index].model == nullptr || entries[index].levelCount > 0 || loader.owner(index) != index) return;
+
+    Entry& entry = entries[index];
+    Model::glTFImage& image = entry.model->images[entry.image];
+    if (image.failed || image.levels.size() < 2) return;
+
+    entry.levelCount = static_cast<uint32_t>(image.levels.size());
+    entry.resident = images.firstResidentLevel(image);
+    entry.floor = entry.resident;
+    entry.wanted = entry.resident;
+    stats.residentBytes += residentSize(entry, entry.resident);
+    stats.textures++;
+}
+
+void Adren::Streaming::clear() {
+    entries.clear();
+    demands.clear();
+    stats = Stats{};
+}
+
+VkDeviceSize Adren::Streaming::residentSize(const Entry& entry, uint32_t level) {
+    const Model::glTFImage& image = entry.model->images[entry.image];
+    return image.size - image.levels[level];
+}
+
+bool Adren::Streaming::swap(uint32_t index, uint32_t level, std::vector<Model::Texture>& textures, VkCommandBuffer commandBuffer) {
+    Entry& entry = entries[index];
+    Model::Texture texture{};
+    if (!images.changeResidency(entry.model->images[entry.image], textures[index], entry.resident, level, texture, commandBuffer)) {
+        stats.failed++;
+        return false;
+    }
+
+    stats.residentBytes -= residentSize(entry, entry.resident);
+    stats.residentBytes += residentSize(entry, level);
+    entry.resident = level;
+
+    // Frames still in flight were recorded with the old view, it goes once all of them have finished.
+    Model::Texture old = textures[index];
+    deletion.push(static_cast<uint32_t>(descriptor.sets.size()), [device = device, allocator = allocator, old]() {
+        vkDestroyImageView(device, old.view, nullptr);
+        vmaDestroyImage(allocator, old.image, old.memory);
+    });
+
+    for (uint32_t slot : loader.users(index)) {
+        textures[slot] = texture;
+        descriptor.replaceTexture(slot, textures);
+    }
+
+    return true;
+}
+
+bool Adren::Streaming::makeRoom(VkDeviceSize bytes, uint32_t keep, std::vector<Model::Texture>& textures, VkCommandBuffer commandBuffer) {
+    std::vector<bool> tried(entries.size(), false);
+
+    while (stats.residentBytes + bytes > budget) {
+        // The victim is the texture needed longest ago that holds levels above what it was loaded with.
+        // Textures drawn this frame only give back levels finer than they want.
+        uint32_t victim = UINT32_MAX;
+        for (uint32_t i = 0; i < entries.size(); i++) {
+            Entry& entry = entries[i];
+            if (i == keep || tried[i] || entry.levelCount == 0 || entry.resident >= entry.floor) continue;
+            if (entry.lastUsed == frameNumber && entry.resident >= entry.wanted) continue;
+            if (victim == UINT32_MAX || entry.lastUsed < entries[victim].lastUsed) victim = i;
+        }
+
+        if (victim == UINT32_MAX) return false;
+
+        Entry& entry = entries[victim];
+        tried[victim] = true;
+        if (swap(victim, std::clamp(entry.wanted, entry.resident + 1, entry.floor), textures, commandBuffer)) stats.evicted++;
+    }
+
+    return true;
+}
+
+void Adren::Streaming::update(Camera& camera, std::vector<Model::Texture>& textures, VkCommandBuffer commandBuffer) {
+    frameNumber++;
+    if (entries.size() != textures.size()) return;
+
+    float height = static_cast<float>(camera.getHeight());
+    if (!enabled || height <= 0.0f) return;
+
+    // Pixels covered by one world unit at a distance of one, the same scale Culling::selectLods uses.
+    float pixelScale = height / (2.0f * glm::tan(glm::radians(static_cast<float>(camera.fov)) * 0.5f));
+
+    for (Entry& entry : entries) entry.wanted = entry.levelCount == 0 ? 0 : entry.floor;
+
+    // A texel per pixel at the nearest point of the bounds, a camera inside them wants the full level.
+    for (Demand& demand : demands) {
+        Entry& entry = entries[demand.texture];
+        if (entry.levelCount == 0) continue;
+
+        const Model::glTFImage& image = entry.model->images[entry.image];
+        float texels = demand.texelsPerUnit * static_cast<float>(std::max(image.width, image.height));
+        float distance = glm::distance(camera.pos, demand.center) - demand.radius;
+
+        uint32_t level = 0;
+        if (distance > 0.0f && texels > 0.0f) {
+            float wanted = glm::floor(glm::log2(texels * distance / pixelScale) + mipBias);
+            level = static_cast<uint32_t>(glm::clamp(wanted, 0.0f, static_cast<float>(entry.levelCount - 1)));
+        }
+
+        entry.wanted = std::min(entry.wanted, level);
+    }
+
+    std::vector<uint32_t> pending;
+    stats.pending = 0;
+    stats.wantedBytes = 0;
+    for (uint32_t i = 0; i < entries.size(); i++) {
+        Entry& entry = entries[i];
+        if (entry.levelCount == 0) continue;
+
+        stats.wantedBytes += residentSize(entry, entry.wanted);
+        if (entry.wanted < entry.floor) entry.lastUsed = frameNumber;
+        if (entry.wanted < entry.resident) pending.push_back(i);
+    }
+
+    stats.pending = static_cast<uint32_t>(pending.size());
+
+    // Textures missing the most levels go first.
+    std::sort(pending.begin(), pending.end(), [&](uint32_t a, uint32_t b) {
+        return entries[a].resident - entries[a].wanted > entries[b].resident - entries[b].wanted;
+    });
+
+    uint32_t uploads = 0;
+    for (uint32_t index : pending) {
+        if (uploads >= uploadsPerFrame) break;
+
+        Entry& entry = entries[index];
+        VkDeviceSize growth = residentSize(entry, entry.wanted) - residentSize(entry, entry.resident);
+        if (!makeRoom(growth, index, textures, commandBuffer)) continue;
+
+        if (swap(index, entry.wanted, textures, commandBuffer)) {
+            stats.streamedIn++;
+            uploads++;
+        }
+    }
+}
@@ -0,0 +1,85 @@
+/*
+	streaming.h
+	Adrenaline Engine
+
+	This streams the mip levels of textures in and out as the camera moves.
+	Every draw asks its textures for the level it covers about one texel per pixel with, textures are recreated
+	with their wanted levels and the least recently needed ones give levels back once the budget is full.
+*/
+
+#pragma once
+#include "images.h"
+#include "descriptor.h"
+#include "deletion.h"
+#include "camera.h"
+#include "loader.h"
+
+namespace Adren {
+class Streaming {
+public:
+	Streaming(Devices* devices, Images& images, Descriptor& descriptor, DeletionQueue& deletion, Loader& loader) : device(devices->getDevice()),
+		allocator(devices->getAllocator()), images(images), descriptor(descriptor), deletion(deletion), loader(loader) {}
+
+	// Collects what every draw of models asks for. Slots whose image didn't change keep their residency.
+	void build(std::vector<Model*>& models, std::vector<Model::Texture>& textures);
+
+	// Textures are only streamed once the loader has uploaded their image. Shared textures are streamed through
+	// their owner and swapped in every slot that uses them.
+	void track(uint32_t index);
+
+	// Called once per frame after the fence wait, so the descriptor set of the frame is free to write. The copies
+	// are recorded into commandBuffer, the frame command buffer, before any of its passes.
+	void update(Camera& camera, std::vector<Model::Texture>& textures, VkCommandBuffer commandBuffer);
+	void clear();
+
+	bool enabled = true;
+	VkDeviceSize budget = 256ull << 20; // Bytes the streamed textures may hold on the GPU together.
+	float mipBias = 0.0f;               // Added to the wanted level, positive values keep coarser levels.
+	uint32_t uploadsPerFrame = 2;        // Textures recreated with finer levels per frame.
+
+	struct Stats {
+		VkDeviceSize residentBytes = 0;
+		VkDeviceSize wantedBytes = 0;
+		uint32_t textures = 0;   // Streamed textures, the ones with more than one level.
+		uint32_t pending = 0;    // Textures that want finer levels than they hold.
+		uint32_t streamedIn = 0; // Totals since the scene was built.
+		uint32_t evicted = 0;
+		uint32_t failed = 0;
+	};
+
+	Stats stats{};
+private:
+	struct Entry {
+		Model* model = nullptr;
+		uint32_t image = 0;
+		uint32_t levelCount = 0; // 0 for textures that aren't streamed.
+		uint32_t resident = 0;   // Largest level on the GPU.
+		uint32_t floor = 0;      // Coarsest largest level, the one loaded with the scene.
+		uint32_t wanted = 0;
+		uint64_t lastUsed = 0;   // Last frame the texture was drawn with every level it wanted.
+	};
+
+	// One per texture a draw samples.
+	struct Demand {
+		glm::vec3 center;
+		float radius;
+		float texelsPerUnit; // Texture coordinate units per world unit, times the size of the texture is texels.
+		uint32_t texture;
+	};
+
+	VkDeviceSize residentSize(const Entry& entry, uint32_t level);
+	bool makeRoom(VkDeviceSize bytes, uint32_t keep, std::vector<Model::Texture>& textures, VkCommandBuffer commandBuffer);
+	bool swap(uint32_t index, uint32_t level, std::vector<Model::Texture>& textures, VkCommandBuffer commandBuffer);
+
+	std::vector<Entry> entries;
+	std::vector<Demand> demands;
+	uint64_t frameNumber = 0;
+
+	VkDevice& device;
+	VmaAllocator& allocator;
+	Images& images;
+	Descriptor& descriptor;
+	DeletionQueue& deletion;
+	Loader& loader;
+};
+}
@@ -14,8 +14,12 @@
 #include <fstream>
 #include <set>
 #include "types.h"
+#include "deletion.h"
 #include "vk_mem_alloc.h"
 #include <regex>
+#include <thread>
+#include <atomic>
+#include <functional>
 
 namespace Adren::Tools {
 
@@ -94,18 +98,29 @@ inline VkCommandBuffer beginSingleTimeCommands(VkDevice device, VkCommandPool& c
     return commandBuffer;
 }
 
-inline void endSingleTimeCommands(VkCommandBuffer commandBuffer, VkDevice& device, 
-    VkQueue& graphicsQueue, VkCommandPool& commandPool) {
+// Submits without waiting. The command buffer is freed once its fence signals, together with whatever retire
+// releases, like the staging buffers the commands read from. Later submits on the queue run after this one.
+inline void endSingleTimeCommands(VkCommandBuffer commandBuffer, VkDevice& device, VkQueue& graphicsQueue, 
+    VkCommandPool& commandPool, DeletionQueue& deletion, std::function<void()>&& retire = nullptr) {
     vkEndCommandBuffer(commandBuffer);
     
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffer;
-    
-    vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphicsQueue);
-    vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    VkFence fence;
+    vkCreateFence(device, &fenceInfo, nullptr, &fence);
+    vkQueueSubmit(graphicsQueue, 1, &submitInfo, fence);
+
+    deletion.push(device, fence, [device = device, commandPool = commandPool, commandBuffer, fence, retire = std::move(retire)]() {
+        if (retire) retire();
+        vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+        vkDestroyFence(device, fence, nullptr);
+    });
 }
 
 inline uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, VkPhysicalDevice& gpu) {
@@ -141,6 +156,58 @@ inline void alignedFree(void* data) {
 #endif
 }
 
+// Runs func(i) for every i in [0, count) spread across the hardware threads.
+template<typename Func>
+inline void parallelFor(size_t count, Func&& func) {
+    size_t threadCount = std::min<size_t>(count, std::max(1u, std::thread::hardware_concurrency()));
+
+    if (threadCount <= 1) {
+        for (size_t i = 0; i < count; i++) func(i);
+        return;
+    }
+
+    std::atomic<size_t> next = 0;
+    std::vector<std::thread> threads;
+
+    for (size_t t = 0; t < threadCount; t++) {
+        threads.emplace_back([&]() {
+            for (size_t i = next++; i < count; i = next++) func(i);
+        });
+    }
+
+    for (std::thread& thread : threads) thread.join();
+}
+
+// Maps a float in the 0 to 1 range onto the full range of an unsigned 16-bit integer.
+inline uint16_t quantizeUnorm16(float value) {
+    return static_cast<uint16_t>(glm::clamp(value, 0.0f, 1.0f) * 65535.0f + 0.5f);
+}
+
+// Packs a direction into two snorm16 values by projecting it onto an octahedron.
+// A zero vector ends up as (0, 0) which decodes to +Z.
+inline glm::i16vec2 octEncode(glm::vec3 n) {
+    float length = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    if (length <= 0.0f) return glm::i16vec2(0);
+
+    n /= length;
+    glm::vec2 encoded = glm::vec2(n.x, n.y);
+
+    if (n.z < 0.0f) {
+        glm::vec2 sign = glm::vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+        encoded = (1.0f - glm::abs(glm::vec2(n.y, n.x))) * sign;
+    }
+
+    return glm::i16vec2(glm::round(glm::clamp(encoded, -1.0f, 1.0f) * 32767.0f));
+}
+
+inline glm::vec3 dequantizePosition(const Vertex& vertex, const Dequantization& dequant) {
+    return glm::vec3(dequant.position) + glm::vec3(vertex.pos) / 65535.0f * glm::vec3(dequant.positionScale);
+}
+
+inline glm::vec2 dequantizeTexCoord(const Vertex& vertex, const Dequantization& dequant) {
+    return glm::vec2(dequant.texCoord) + glm::vec2(vertex.texCoord) / 65535.0f * glm::vec2(dequant.texCoord.z, dequant.texCoord.w);
+}
+
 inline std::string formatPath(std::string& path) {
     std::string newPath = std::regex_replace(path, std::regex("\\"), "/");
 
@@ -13,6 +13,7 @@
 #define GLM_FORCE_QUAT_DATA_XYZW
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_precision.hpp>
 #include <glm/gtx/string_cast.hpp>
 #include <glm/gtx/hash.hpp>
 
@@ -22,10 +23,13 @@
 #include <array>
 #include "vk_mem_alloc.h"
 
+// Vertices are stored quantized to 16 bytes. Positions and texture coordinates are unorm16
+// relative to the bounds of their primitive (see Dequantization) and normals are octahedral
+// encoded, shader.vert expands all of them back.
 struct Vertex {
-    glm::vec3 pos;
-    glm::vec3 color;
-    glm::vec2 texCoord;
+    glm::u16vec4 pos;
+    glm::i16vec2 normal;
+    glm::u16vec2 texCoord;
 
     static VkVertexInputBindingDescription getBindingDescription() {
         VkVertexInputBindingDescription bindingDescription{};
@@ -40,36 +44,110 @@ struct Vertex {
         std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
         attributeDescriptions[0].binding = 0;
         attributeDescriptions[0].location = 0;
-        attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+        attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
         attributeDescriptions[0].offset = offsetof(Vertex, pos);
         
         attributeDescriptions[1].binding = 0;
         attributeDescriptions[1].location = 1;
-        attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attributeDescriptions[1].offset = offsetof(Vertex, color);
+        attributeDescriptions[1].format = VK_FORMAT_R16G16_SNORM;
+        attributeDescriptions[1].offset = offsetof(Vertex, normal);
         
         attributeDescriptions[2].binding = 0;
         attributeDescriptions[2].location = 2;
-        attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
+        attributeDescriptions[2].format = VK_FORMAT_R16G16_UNORM;
         attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
 
         return attributeDescriptions;
     }
 
     bool operator==(const Vertex& other) const {
-        return pos == other.pos && color == other.color && texCoord == other.texCoord;
+        return pos == other.pos && normal == other.normal && texCoord == other.texCoord;
     }
 };
 
+static_assert(sizeof(Vertex) == 16, "Vertex is expected to stay 16 bytes.");
+
 namespace std {
     template<> struct hash<Vertex> {
         size_t operator()(Vertex const& vertex) const {
-            return ((hash<glm::vec3>()(vertex.pos) ^ (hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
-            (hash<glm::vec2>()(vertex.texCoord) << 1);
+            return ((hash<glm::u16vec4>()(vertex.pos) ^ (hash<glm::i16vec2>()(vertex.normal) << 1)) >> 1) ^
+            (hash<glm::u16vec2>()(vertex.texCoord) << 1);
         }
     };
 }
 
+// This turns the quantized attributes of a primitive back into mesh space.
+struct Dequantization {
+    glm::vec4 position = glm::vec4(0.0f);      // xyz holds the offset.
+    glm::vec4 positionScale = glm::vec4(1.0f); // xyz holds the scale.
+    glm::vec4 texCoord = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f); // xy is the offset, zw the scale.
+};
+
+// A cluster of at most 64 vertices and 124 triangles, laid out to match a storage buffer.
+// The bounds are in mesh space, the space the node matrices transform from.
+struct Meshlet {
+    glm::vec4 sphere;        // xyz is the center, w the radius.
+    glm::vec4 cone;          // xyz is the axis, w the cutoff. A cutoff of 1 means the cone is unusable.
+    glm::vec4 apex;          // xyz is the apex of the normal cone.
+    uint32_t vertexOffset;   // First entry in the meshlet vertex list.
+    uint32_t triangleOffset; // First entry in the meshlet triangle list.
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+};
+
+// Every parameter of a material, laid out to match the material storage buffer shader.frag indexes per draw.
+// Textures are slots of the texture table and samplers indices into the sampler cache, -1 means no texture.
+struct MaterialData {
+    glm::vec4 baseColorFactor = glm::vec4(1.0f);
+    glm::vec4 emissiveFactor = glm::vec4(0.0f); // w is unused.
+    float metallicFactor = 1.0f;
+    float roughnessFactor = 1.0f;
+    float normalScale = 1.0f;
+    float occlusionStrength = 1.0f;
+    glm::ivec4 textures = glm::ivec4(-1);  // Base color, metallic roughness, normal and occlusion.
+    glm::ivec4 samplers = glm::ivec4(0);
+    int32_t emissiveTexture = -1;
+    int32_t emissiveSampler = 0;
+    uint32_t alphaMode = 0;   // 0 is opaque, 1 mask and 2 blend, as in glTF.
+    float alphaCutoff = 0.5f;
+};
+
+// A primitive drawn through the cluster culling pass, mirrors Draw in cull.comp.
+// The meshlet range of a draw comes from the LOD it uses this frame, see CullLod.
+struct CullDraw {
+    glm::mat4 model;
+    uint32_t coneCulling; // Cone culling is skipped for mirrored and non-uniformly scaled nodes.
+    float scale;          // The largest axis scale of the model matrix, used on the bounding spheres.
+    uint32_t halfIndices; // 1 for primitives with 16-bit indices, their compacted indices are 16-bit too.
+    uint32_t indexBase;   // The uint of the index buffer the firstIndex of the command counts from.
+};
+
+// The meshlets a draw uses this frame, written on the CPU after the LOD is picked. A count of 0 skips the draw.
+struct CullLod {
+    uint32_t meshletOffset;
+    uint32_t meshletCount;
+};
+
+// Per frame parameters of the cluster culling pass, mirrors CullData in cull.comp.
+struct CullData {
+    glm::mat4 view;
+    glm::mat4 prevView;
+    glm::vec4 frustum;
+    glm::vec4 projection;
+    glm::vec4 prevProjection;
+    glm::vec2 pyramidSize;
+    uint32_t jobCount;
+    uint32_t flags;
+};
+
+struct CullStats {
+    uint32_t visible = 0;
+    uint32_t frustum = 0;
+    uint32_t occlusion = 0;
+    uint32_t cone = 0;
+    uint32_t triangles = 0;
+};
+
 struct CameraObject {
     alignas(16) glm::mat4 view;
     alignas(16) glm::mat4 proj;
@@ -102,13 +180,45 @@ struct Frame {
     VkSemaphore rSemaphore;
 };
 
+// The features a graphics pipeline is specialized for, see Pipeline::get. Each one is a specialization constant
+// of shader.frag, so a pipeline only runs the code of the features in its key.
+struct PipelineKey {
+    uint32_t alphaMode = 0;   // 0 is opaque, 1 mask and 2 blend, as in glTF. Only mask discards.
+    bool doubleSided = false; // Turns off back face culling.
+    bool unlit = false;       // KHR_materials_unlit, the base color is written as it is.
+    bool emissive = false;
+    bool normalMap = false;
+
+    uint32_t bits() const {
+        return alphaMode | uint32_t(doubleSided) << 2 | uint32_t(unlit) << 3 | uint32_t(emissive) << 4 | uint32_t(normalMap) << 5;
+    }
+
+    static PipelineKey fromBits(uint32_t bits) {
+        PipelineKey key{};
+        key.alphaMode = bits & 3;
+        key.doubleSided = bits & 4;
+        key.unlit = bits & 8;
+        key.emissive = bits & 16;
+        key.normalMap = bits & 32;
+        return key;
+    }
+
+    bool operator==(const PipelineKey& other) const { return bits() == other.bits(); }
+
+    // Opaque keys come first and blended ones last, the order they have to be drawn in.
+    bool operator<(const PipelineKey& other) const {
+        return alphaMode != other.alphaMode ? alphaMode < other.alphaMode : bits() < other.bits();
+    }
+};
+
 struct Offset {
     int32_t index = 0;
     uint32_t vertex = 0;
-    uint32_t texture = 0;
     uint32_t dynamic = 0;
     uint32_t model = 0;
     VkDeviceSize align = 0;
+    VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+    PipelineKey pipeline{}; // Only primitives drawn with this pipeline are drawn.
 };
 
 struct Buffer {
@@ -126,7 +236,25 @@ struct Image {
     VkFormat format;
 };
 
+// How a texture is sampled, what the sampler cache is keyed by. Keys built from glTF samplers leave
+// maxAnisotropy at 0, the cache fills it in for filters that use mip levels.
+struct SamplerKey {
+    VkFilter magFilter = VK_FILTER_LINEAR;
+    VkFilter minFilter = VK_FILTER_LINEAR;
+    VkSamplerMipmapMode mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    VkSamplerAddressMode addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    VkSamplerAddressMode addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    bool mipmaps = true;       // False for glTF filters without mipmaps, the sampler only reads level 0.
+    float maxAnisotropy = 0.0f; // 0 leaves anisotropic filtering off.
+
+    bool operator==(const SamplerKey& other) const {
+        return magFilter == other.magFilter && minFilter == other.minFilter && mipmapMode == other.mipmapMode &&
+            addressModeU == other.addressModeU && addressModeV == other.addressModeV && mipmaps == other.mipmaps &&
+            maxAnisotropy == other.maxAnisotropy;
+    }
+};
+
 struct PushConstant {
-    uint32_t textureIndex;
-    glm::mat4 transform;
+    Dequantization dequant;
+    uint32_t materialIndex; // In the material storage buffer, see MaterialData.
 };
\ No newline at end of file
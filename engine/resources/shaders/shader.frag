@@ -2,23 +2,144 @@
 #extension GL_ARB_separate_shader_objects : enable
 #extension GL_EXT_nonuniform_qualifier : enable
 
-layout(binding = 2) uniform sampler texSampler; 
-layout(binding = 3) uniform texture2D textures[];
+// Mirrors MaterialData in types.h.
+struct Material {
+	vec4 baseColorFactor;
+	vec4 emissiveFactor;
+	float metallicFactor;
+	float roughnessFactor;
+	float normalScale;
+	float occlusionStrength;
+	ivec4 textures; // Base color, metallic roughness, normal and occlusion, -1 for none.
+	ivec4 samplers;
+	int emissiveTexture;
+	int emissiveSampler;
+	uint alphaMode; // The pipeline already follows it, see ALPHA_MODE.
+	float alphaCutoff;
+};
+
+// Set per pipeline from its PipelineKey, see Pipeline::get. Features that are off compile to nothing,
+// opaque and blended pipelines have no discard and unlit ones no lighting.
+layout(constant_id = 0) const uint ALPHA_MODE = 0; // 0 is opaque, 1 mask and 2 blend.
+layout(constant_id = 1) const bool UNLIT = false;
+layout(constant_id = 2) const bool EMISSIVE = true;
+layout(constant_id = 3) const bool NORMAL_MAP = true;
+
+layout(set = 0, binding = 2) readonly buffer Materials { Material materials[]; };
+layout(set = 1, binding = 0) uniform sampler samplers[32]; // Samplers::capacity
+layout(set = 1, binding = 1) uniform texture2D textures[];
 
 layout(push_constant) uniform PER_OBJECT {
-	int imageIndex;
+	layout(offset = 48) uint materialIndex;
 } pushConstant;
 
-layout(location = 0) in vec3 fragColor;
+layout(location = 0) in vec3 fragNormal;
 layout(location = 1) in vec2 fragTexCoord;
-layout(location = 2) in flat uint fragImageIndex;
+layout(location = 2) in vec3 fragPosition;
+layout(location = 3) in flat vec3 fragCamera;
 
 layout(location = 0) out vec4 outColor;
 
+const float PI = 3.14159265359;
+
+// The scene has no lights of its own yet, everything is lit by one sun and a flat sky.
+const vec3 sunDirection = normalize(vec3(0.4, 1.0, 0.3));
+const vec3 sunColor = vec3(PI);
+const vec3 skyColor = vec3(0.25);
+
+vec4 sampleTexture(int slot, int samplerIndex, vec4 fallback) {
+	if (slot < 0) return fallback;
+	return texture(sampler2D(textures[nonuniformEXT(slot)], samplers[samplerIndex]), fragTexCoord);
+}
+
+// There are no tangents in the vertices, the frame comes from the screen space derivatives of position and
+// texture coordinates. glTF normal maps point green up, against the direction v grows in.
+mat3 cotangentFrame(vec3 normal, vec3 position, vec2 uv) {
+	vec3 dp1 = dFdx(position);
+	vec3 dp2 = dFdy(position);
+	vec2 duv1 = dFdx(uv);
+	vec2 duv2 = dFdy(uv);
+
+	vec3 dp2perp = cross(dp2, normal);
+	vec3 dp1perp = cross(normal, dp1);
+	vec3 tangent = dp2perp * duv1.x + dp1perp * duv2.x;
+	vec3 bitangent = dp2perp * duv1.y + dp1perp * duv2.y;
+
+	float scale = inversesqrt(max(max(dot(tangent, tangent), dot(bitangent, bitangent)), 1e-20));
+	return mat3(tangent * scale, -bitangent * scale, normal);
+}
+
+float distributionGGX(float NdotH, float alpha) {
+	float alpha2 = alpha * alpha;
+	float d = NdotH * NdotH * (alpha2 - 1.0) + 1.0;
+	return alpha2 / (PI * d * d);
+}
+
+// Height correlated Smith visibility, the 4 NdotL NdotV of the specular term is already folded in.
+float visibilitySmithGGX(float NdotV, float NdotL, float alpha) {
+	float alpha2 = alpha * alpha;
+	float ggxV = NdotL * sqrt(NdotV * NdotV * (1.0 - alpha2) + alpha2);
+	float ggxL = NdotV * sqrt(NdotL * NdotL * (1.0 - alpha2) + alpha2);
+	return 0.5 / max(ggxV + ggxL, 1e-5);
+}
+
+vec3 fresnelSchlick(float VdotH, vec3 f0) {
+	return f0 + (1.0 - f0) * pow(1.0 - VdotH, 5.0);
+}
+
 void main() {
-    outColor = texture(sampler2D(textures[nonuniformEXT(pushConstant.imageIndex)], texSampler), fragTexCoord);
-	
-	if (outColor.w < 0.5) {
+	Material material = materials[pushConstant.materialIndex];
+
+	vec4 baseColor = material.baseColorFactor * sampleTexture(material.textures.x, material.samplers.x, vec4(1.0));
+	if (ALPHA_MODE == 1 && baseColor.a < material.alphaCutoff) {
 		discard;
 	}
+
+	// KHR_materials_unlit, the base color is the final color.
+	if (UNLIT) {
+		outColor = vec4(baseColor.rgb, ALPHA_MODE == 2 ? baseColor.a : 1.0);
+		return;
+	}
+
+	// Green holds roughness and blue metalness, occlusion is red of its own texture even when it is packed with them.
+	vec4 metallicRoughness = sampleTexture(material.textures.y, material.samplers.y, vec4(1.0));
+	float metallic = clamp(material.metallicFactor * metallicRoughness.b, 0.0, 1.0);
+	float roughness = clamp(material.roughnessFactor * metallicRoughness.g, 0.04, 1.0);
+	float occlusion = 1.0 + material.occlusionStrength * (sampleTexture(material.textures.w, material.samplers.w, vec4(1.0)).r - 1.0);
+	vec3 emissive = vec3(0.0);
+	if (EMISSIVE) {
+		emissive = material.emissiveFactor.rgb * sampleTexture(material.emissiveTexture, material.emissiveSampler, vec4(1.0)).rgb;
+	}
+
+	vec3 normal = normalize(fragNormal);
+	if (!gl_FrontFacing) normal = -normal;
+
+	// Two channel normal maps (BC5) leave z out, it is rebuilt for every map since it is unit length anyway.
+	if (NORMAL_MAP && material.textures.z >= 0) {
+		vec2 xy = sampleTexture(material.textures.z, material.samplers.z, vec4(0.5, 0.5, 1.0, 1.0)).rg * 2.0 - 1.0;
+		vec3 mapped = vec3(xy, sqrt(clamp(1.0 - dot(xy, xy), 0.0, 1.0)));
+		mapped.xy *= material.normalScale;
+		normal = normalize(cotangentFrame(normal, fragPosition, fragTexCoord) * mapped);
+	}
+
+	vec3 view = normalize(fragCamera - fragPosition);
+	vec3 halfway = normalize(view + sunDirection);
+	float NdotL = clamp(dot(normal, sunDirection), 0.0, 1.0);
+	float NdotV = clamp(abs(dot(normal, view)), 1e-4, 1.0);
+	float NdotH = clamp(dot(normal, halfway), 0.0, 1.0);
+	float VdotH = clamp(dot(view, halfway), 0.0, 1.0);
+
+	vec3 f0 = mix(vec3(0.04), baseColor.rgb, metallic);
+	vec3 diffuseColor = baseColor.rgb * (1.0 - metallic);
+	float alpha = roughness * roughness;
+
+	vec3 fresnel = fresnelSchlick(VdotH, f0);
+	vec3 specular = fresnel * distributionGGX(NdotH, alpha) * visibilitySmithGGX(NdotV, NdotL, alpha);
+	vec3 diffuse = (1.0 - fresnel) * diffuseColor / PI;
+
+	vec3 color = (diffuse + specular) * sunColor * NdotL;
+	color += (diffuseColor + f0 * (1.0 - roughness)) * skyColor * occlusion;
+	color += emissive;
+
+	outColor = vec4(color, ALPHA_MODE == 2 ? baseColor.a : 1.0);
 }
@@ -10,17 +10,38 @@ layout(binding = 1) uniform UboInstance {
 	mat4 model;
 } uboInstance;
 
-layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inColor;
-layout(location = 2) in vec2 inTexCoord;
+// Per primitive dequantization, see Dequantization in types.h.
+layout(push_constant) uniform PER_OBJECT {
+    vec4 position;
+    vec4 positionScale;
+    vec4 texCoord;
+    uint materialIndex;
+} pushConstant;
 
-layout(location = 0) out vec3 fragColor;
+layout(location = 0) in vec4 inPosition; // unorm16 relative to the primitive bounds
+layout(location = 1) in vec2 inNormal;   // snorm16 octahedral
+layout(location = 2) in vec2 inTexCoord; // unorm16 relative to the primitive UV bounds
+
+layout(location = 0) out vec3 fragNormal;
 layout(location = 1) out vec2 fragTexCoord;
-layout(location = 2) out flat uint fragImageIndex;
+layout(location = 2) out vec3 fragPosition;    // World space, like fragNormal.
+layout(location = 3) out flat vec3 fragCamera;
+
+vec3 octDecode(vec2 e) {
+    vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
 
 void main() {
+    vec3 position = pushConstant.position.xyz + inPosition.xyz * pushConstant.positionScale.xyz;
+
     mat4 modelView = ubo.view * uboInstance.model;
-    gl_Position = ubo.proj * modelView * vec4(inPosition, 1.0);
-    fragColor = inColor;
-    fragTexCoord = inTexCoord;
+    gl_Position = ubo.proj * modelView * vec4(position, 1.0);
+    fragPosition = vec3(uboInstance.model * vec4(position, 1.0));
+    fragCamera = -transpose(mat3(ubo.view)) * ubo.view[3].xyz;
+    fragNormal = mat3(uboInstance.model) * octDecode(inNormal);
+    fragTexCoord = pushConstant.texCoord.xy + inTexCoord * pushConstant.texCoord.zw;
 }
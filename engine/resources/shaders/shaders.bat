@@ -1,6 +1,10 @@
 del /f vert.spv
 del /f frag.spv
+del /f cull.spv
+del /f hzb.spv
 C:\VulkanSDK\1.3.261.1\Bin\glslc.exe shader.vert -o vert.spv
 C:\VulkanSDK\1.3.261.1\Bin\glslc.exe shader.frag -o frag.spv
+C:\VulkanSDK\1.3.261.1\Bin\glslc.exe cull.comp -o cull.spv
+C:\VulkanSDK\1.3.261.1\Bin\glslc.exe hzb.comp -o hzb.spv
 echo Successfully Recompiled Shaders
 pause
\ No newline at end of file